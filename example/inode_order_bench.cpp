@@ -0,0 +1,59 @@
+//  inode_order_bench program  ---------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//  Times a recursive walk that stats every entry, visiting each directory's entries
+//  either as the operating system returns them or in inode order. Only a cold cache
+//  shows the difference, so run each order once per cold start, e.g. on Linux:
+//
+//    sync; echo 3 > /proc/sys/vm/drop_caches; inode_order_bench native /archive
+//    sync; echo 3 > /proc/sys/vm/drop_caches; inode_order_bench inode /archive
+
+#include <filesystem8/operations.hpp>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace fs = filesystem8;
+
+int main(int argc, char* argv[])
+{
+  if (argc != 3
+    || (std::strcmp(argv[1], "native") != 0 && std::strcmp(argv[1], "inode") != 0))
+  {
+    std::cout << "Usage: inode_order_bench native|inode path\n";
+    return 1;
+  }
+
+  fs::recursion_options options;
+  options.order = std::strcmp(argv[1], "inode") == 0
+    ? fs::directory_order::inode : fs::directory_order::native;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::uintmax_t entries = 0, directories = 0, errors = 0;
+  std::error_code ec;
+  for (fs::recursive_directory_iterator it(argv[2], options, ec), end;
+    it != end; it.increment(ec))
+  {
+    if (ec)
+    {
+      ++errors;
+      continue;
+    }
+    ++entries;
+    fs::file_status st = fs::symlink_status(it->path(), ec);  // always an lstat()
+    if (ec)
+      ++errors;
+    else if (fs::is_directory(st))
+      ++directories;
+  }
+  if (ec)
+    ++errors;
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << argv[1] << ": " << entries << " entries, " << directories << " directories, "
+    << errors << " errors in " << elapsed.count() << " s\n";
+  return 0;
+}
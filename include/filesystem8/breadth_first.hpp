@@ -0,0 +1,124 @@
+//  filesystem8/breadth_first.hpp  -----------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_BREADTH_FIRST_HPP
+#define FILESYSTEM8_BREADTH_FIRST_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <system_error>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                        breadth_first_directory_iterator                              //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  Visits the same entries as recursive_directory_iterator, but a directory is queued
+//  when it is visited and read only once the directories queued before it are done: all
+//  entries at depth 0 come first, then those at depth 1, and so on. With
+//  frontier_options::before set, the queued directory read next is instead the one that
+//  comes first by it, for a best-first traversal.
+//
+//  The queue holds a path and a depth per directory. Once it holds max_frontier of them,
+//  a directory found is read right away instead, with everything below it, depth first
+//  as recursive_directory_iterator would read it. So memory stays bounded, at the cost
+//  of strict breadth-first order.
+//
+//  The recursion_options are applied as by recursive_directory_iterator, order within
+//  each directory; open_limit is ignored.
+
+  struct queued_directory
+  {
+    path  dir;
+    int   depth;  // of the entries of dir
+  };
+
+  struct frontier_options : recursion_options
+  {
+    std::size_t  max_frontier;  // directories queued at most; 0 means no limit
+
+    //  If set, returns true if lhs is to be read before rhs. For example, shallowest
+    //  first with the paths in alphabetical order:
+    //    [](const queued_directory& lhs, const queued_directory& rhs)
+    //      { return lhs.depth != rhs.depth ? lhs.depth < rhs.depth : lhs.dir < rhs.dir; }
+    std::function<bool(const queued_directory&, const queued_directory&)>  before;
+
+    frontier_options() : max_frontier(0) {}
+  };
+
+  class FILESYSTEM8_EXPORT breadth_first_directory_iterator
+    : public iterator_facade<
+        breadth_first_directory_iterator,
+        directory_entry,
+        std::input_iterator_tag >
+  {
+  public:
+    breadth_first_directory_iterator() FILESYSTEM8_NOEXCEPT {}  // creates the "end" iterator
+
+    explicit breadth_first_directory_iterator(const path& dir_path,
+      const frontier_options& options = frontier_options())  // throws if !exists()
+                                       { m_construct(dir_path, options, 0); }
+    breadth_first_directory_iterator(const path& dir_path, std::error_code& ec)
+                                       { m_construct(dir_path, frontier_options(), &ec); }
+    breadth_first_directory_iterator(const path& dir_path,
+      const frontier_options& options, std::error_code& ec)
+                                       { m_construct(dir_path, options, &ec); }
+
+    //  An error reading a directory is reported, and iteration goes on without the
+    //  entries it kept from being read
+    breadth_first_directory_iterator& increment(std::error_code& ec)
+                                       { m_increment(&ec); return *this; }
+
+    int          depth() const FILESYSTEM8_NOEXCEPT;
+
+    //  Directories queued, not counting those read depth first
+    std::size_t  frontier_size() const FILESYSTEM8_NOEXCEPT;
+
+    bool         recursion_pending() const FILESYSTEM8_NOEXCEPT;
+    void         disable_recursion_pending(bool value=true) FILESYSTEM8_NOEXCEPT;
+
+  private:
+    friend class iterator_facade<
+        breadth_first_directory_iterator,
+        directory_entry,
+        std::input_iterator_tag >;
+
+    struct imp;
+
+    // shared_ptr provides shallow-copy semantics required for InputIterators.
+    // m_imp.get()==0 indicates the end iterator.
+    std::shared_ptr<imp>  m_imp;
+
+    void       m_construct(const path& dir_path, const frontier_options& options,
+                 std::error_code* ec);
+    void       m_increment(std::error_code* ec);
+
+    reference  dereference() const;
+    void       increment()             { m_increment(0); }
+    bool       equal(const breadth_first_directory_iterator& rhs) const
+                                       { return m_imp == rhs.m_imp; }
+  };
+
+  inline
+  const breadth_first_directory_iterator&
+    begin(const breadth_first_directory_iterator& iter) FILESYSTEM8_NOEXCEPT
+                                                  {return iter;}
+  inline
+  breadth_first_directory_iterator
+    end(const breadth_first_directory_iterator&) FILESYSTEM8_NOEXCEPT
+                                                  {return breadth_first_directory_iterator();}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_BREADTH_FIRST_HPP
@@ -38,6 +38,11 @@
 
 #define FILESYSTEM8_THROW(EX) throw EX
 
+//  C++20 coroutines, required by <filesystem8/generator.hpp>
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define FILESYSTEM8_HAS_COROUTINES
+#endif
+
 // #define BOOST_NO_CXX11_RVALUE_REFERENCES
 
 namespace filesystem8 {}
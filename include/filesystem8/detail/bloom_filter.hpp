@@ -0,0 +1,90 @@
+//  filesystem8/detail/bloom_filter.hpp  -----------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+//  Implementation detail; not part of the documented interface.
+//
+//  A Bloom filter over 64-bit hashes: may_contain() is false only for a hash never
+//  inserted, and true for one not inserted with a probability set by the size and the
+//  number of hashes in it. The probes are derived from the one hash by double hashing,
+//  so the caller hashes each key once, with hash_mix() for example.
+
+#ifndef FILESYSTEM8_DETAIL_BLOOM_FILTER_HPP
+#define FILESYSTEM8_DETAIL_BLOOM_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace filesystem8
+{
+namespace detail
+{
+  //  Returns: x with its bits well mixed, for keys such as inode numbers whose low bits
+  //  alone hash badly (the splitmix64 finalizer)
+  inline
+  std::uint64_t hash_mix(std::uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  class bloom_filter
+  {
+  public:
+    bloom_filter() : m_mask(0), m_probes(0) {}
+
+    //  bits is rounded up to a power of two, of at least 64; 0 makes an empty filter,
+    //  for which may_contain() is always true
+    explicit bloom_filter(std::size_t bits, unsigned probes = 4)
+      : m_mask(0), m_probes(bits == 0 ? 0 : probes)
+    {
+      if (bits == 0)
+        return;
+      std::size_t n = 64;
+      while (n < bits)
+        n <<= 1;
+      m_words.resize(n / 64);
+      m_mask = n - 1;
+    }
+
+    std::size_t bits() const { return m_words.size() * 64; }
+
+    void insert(std::uint64_t hash)
+    {
+      std::uint64_t h1 = hash, h2 = probe_step(hash);
+      for (unsigned i = 0; i != m_probes; ++i, h1 += h2)
+        m_words[(h1 & m_mask) >> 6] |= std::uint64_t(1) << (h1 & 63);
+    }
+
+    bool may_contain(std::uint64_t hash) const
+    {
+      std::uint64_t h1 = hash, h2 = probe_step(hash);
+      for (unsigned i = 0; i != m_probes; ++i, h1 += h2)
+        if ((m_words[(h1 & m_mask) >> 6] & (std::uint64_t(1) << (h1 & 63))) == 0)
+          return false;
+      return true;
+    }
+
+    void clear() { m_words.assign(m_words.size(), 0); }
+
+  private:
+    std::vector<std::uint64_t>  m_words;
+    std::size_t                 m_mask;    // bits() - 1
+    unsigned                    m_probes;
+
+    //  Odd, so that the probes visit distinct bits
+    static std::uint64_t probe_step(std::uint64_t hash)
+      { return ((hash >> 32) | (hash << 32)) | 1; }
+  };
+
+}  // namespace detail
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_DETAIL_BLOOM_FILTER_HPP
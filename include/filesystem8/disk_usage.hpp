@@ -0,0 +1,99 @@
+//  filesystem8/disk_usage.hpp  --------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_DISK_USAGE_HPP
+#define FILESYSTEM8_DISK_USAGE_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/parallel_walk.hpp>
+#include <cstdint>
+#include <map>
+#include <system_error>
+#include <vector>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                    disk_usage                                        //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  Adds up the space used below root, like du, on a parallel_walk of the tree.
+//
+//  Each entry is lstat'ed once, and a symlink that options.symlinks has followed is
+//  stat'ed as well, to be counted as its target. An entry with several hard links is
+//  counted once, at whichever of its paths is visited first; so is a file or directory
+//  reached more than once through followed symlinks, and such a directory is descended
+//  into only the first time, so a symlink back to a directory above it does not make
+//  the walk go around forever. The totals of a directory include the directory itself
+//  and everything below it. Entries whose type options.types excludes are not counted,
+//  but are still descended into, as parallel_walk does.
+
+  struct usage_totals
+  {
+    std::uintmax_t  files;          // entries other than directories
+    std::uintmax_t  directories;
+    std::uintmax_t  apparent_size;  // sum of st_size
+    std::uintmax_t  allocated;      // sum of st_blocks * 512; apparent_size on Windows
+
+    usage_totals() : files(0), directories(0), apparent_size(0), allocated(0) {}
+
+    usage_totals& operator+=(const usage_totals& rhs)
+    {
+      files += rhs.files;
+      directories += rhs.directories;
+      apparent_size += rhs.apparent_size;
+      allocated += rhs.allocated;
+      return *this;
+    }
+  };
+
+  struct disk_usage_options : walk_options
+  {
+    bool  per_directory;  // fill in disk_usage_info::directories
+
+    disk_usage_options() : per_directory(true) {}
+  };
+
+  struct disk_usage_info
+  {
+    usage_totals                   total;        // of root
+
+    //  The totals of root and of every directory below it
+    std::map<path, usage_totals>   directories;
+
+    //  Regular files by size: element 0 holds empty files, element k those of at least
+    //  2^(k-1) and less than 2^k bytes. Trailing empty size classes are left out.
+    std::vector<usage_totals>      size_classes;
+
+    //  Files other than directories by extension(), "" for none
+    std::map<path, usage_totals>   extensions;
+  };
+
+  namespace detail
+  {
+    FILESYSTEM8_EXPORT
+    disk_usage_info disk_usage(const path& root, const disk_usage_options& options,
+      std::error_code* ec=0);
+  }
+
+  inline
+  disk_usage_info disk_usage(const path& root,
+    const disk_usage_options& options = disk_usage_options())
+                                       {return detail::disk_usage(root, options);}
+  inline
+  disk_usage_info disk_usage(const path& root, std::error_code& ec)
+                                       {return detail::disk_usage(root, disk_usage_options(), &ec);}
+  inline
+  disk_usage_info disk_usage(const path& root, const disk_usage_options& options,
+    std::error_code& ec)               {return detail::disk_usage(root, options, &ec);}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_DISK_USAGE_HPP
@@ -0,0 +1,100 @@
+//  filesystem8/existence_filter.hpp  --------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_EXISTENCE_FILTER_HPP
+#define FILESYSTEM8_EXISTENCE_FILTER_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <filesystem8/tree_index.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <system_error>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                  existence_filter                                    //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  Answers "definitely does not exist" for paths below a known tree without a system
+//  call, for probes that mostly miss, such as looking for a header along an include
+//  path. It is built from a walk of the tree, or from a tree_index, and holds a Bloom
+//  filter of the relative paths found there, sized for false_positive_rate, along with
+//  the last write time of each directory.
+//
+//  may_exist(p) is false only if p was not in the tree and the directory that would
+//  have to change for it to be there since has not: the nearest directory above p that
+//  was in the tree. That directory's last write time is compared with the one recorded
+//  at most once per recheck interval, so an entry created less than recheck ago may be
+//  missed; a directory found changed is not trusted again, and may_exist() is true for
+//  everything below it, until the filter is rebuilt. stale() tells whether that has
+//  happened. may_exist() is also true for a path outside the tree, for one with a ".."
+//  element, which it does not try to resolve, and for one through an entry of the tree
+//  that is not a directory, such as a directory symlink, which the walk does not follow.
+//
+//  exists(p) is false if may_exist(p) is, and otherwise falls through to status().
+//
+//  Paths are compared with the root element by element, as given, without resolving
+//  symlinks; a path must name the tree through the same prefix as root to be covered.
+//  may_exist() and exists() may be called concurrently. A filter whose walk failed
+//  covers nothing: may_exist() is true for every path.
+
+  struct existence_filter_options
+  {
+    double       false_positive_rate;  // of may_exist() for paths not in the tree
+    std::chrono::steady_clock::duration  recheck;  // how long a directory is trusted
+                                                   // between looks at its write time
+
+    existence_filter_options()
+      : false_positive_rate(0.01), recheck(std::chrono::seconds(1)) {}
+  };
+
+  class FILESYSTEM8_EXPORT existence_filter
+  {
+  public:
+    //  Walks root with recursive_directory_iterator, not following directory symlinks
+    explicit existence_filter(const path& root,
+      const existence_filter_options& options = existence_filter_options());
+    existence_filter(const path& root, const existence_filter_options& options,
+      std::error_code& ec);
+
+    //  From an index already written; the write times compared are those it records,
+    //  and a directory written to shortly before its walk_start() is not trusted
+    explicit existence_filter(const tree_index& index,
+      const existence_filter_options& options = existence_filter_options());
+
+    ~existence_filter();
+
+    existence_filter(const existence_filter&) = delete;
+    existence_filter& operator=(const existence_filter&) = delete;
+
+    const path&  root() const FILESYSTEM8_NOEXCEPT;
+    std::size_t  size() const FILESYSTEM8_NOEXCEPT;  // entries in the tree, root included
+
+    bool  may_exist(const path& p) const;
+    bool  exists(const path& p) const;
+    bool  exists(const path& p, std::error_code& ec) const FILESYSTEM8_NOEXCEPT;
+
+    //  Returns: true if a directory has been found changed since the filter was built
+    bool  stale() const FILESYSTEM8_NOEXCEPT;
+
+  private:
+    struct imp;
+    std::unique_ptr<imp>  m_imp;
+
+    void m_build(const path& root, const existence_filter_options& options,
+      std::error_code* ec);
+  };
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_EXISTENCE_FILTER_HPP
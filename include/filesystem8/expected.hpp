@@ -0,0 +1,283 @@
+//  filesystem8/expected.hpp  ----------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_EXPECTED_HPP
+#define FILESYSTEM8_EXPECTED_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <filesystem8/file_info.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <system_error>
+#include <type_traits>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                               fs_error, expected<T>                                  //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  The try_ functions below answer as status(), exists(), file_size() and the others of
+//  the same name do, but never throw and never allocate: an error is returned in an
+//  expected<T> as an fs_error, which holds only the errno, or GetLastError() value on
+//  Windows, and which function failed. Its path is not kept; the caller has it, and
+//  passes it to exception() or raise() if a filesystem_error is wanted after all, which
+//  is when the path is copied and the message formed. Probing for paths that mostly do
+//  not exist thus costs one system call each and nothing more.
+//
+//  The functions are built from the basic_ templates, which take a policy for what to
+//  do on error: nothrow_policy returns expected<T>, and throw_policy returns T and
+//  throws filesystem_error, with the path. Generic code written against a policy is
+//  compiled without the branch on a null std::error_code* of the detail functions, and
+//  the code that throws is kept out of line.
+//
+//  As for status(), a path that does not exist is not an error for try_status(),
+//  try_symlink_status(), try_exists(), try_is_directory() and try_is_regular_file().
+
+  enum class fs_op : std::uint8_t
+  {
+    none,
+    status,
+    symlink_status,
+    exists,
+    is_directory,
+    is_regular_file,
+    file_size,
+    last_write_time,
+    hard_link_count,
+    file_id_of
+  };
+
+  //  Returns: the name of op as a filesystem_error's what() gives it, such as
+  //  "filesystem8::file_size"
+  FILESYSTEM8_EXPORT const char* op_name(fs_op op) FILESYSTEM8_NOEXCEPT;
+
+  class FILESYSTEM8_EXPORT fs_error
+  {
+  public:
+    fs_error() FILESYSTEM8_NOEXCEPT : m_value(0), m_op(fs_op::none) {}
+    fs_error(int value, fs_op op) FILESYSTEM8_NOEXCEPT : m_value(value), m_op(op) {}
+
+    int    value() const FILESYSTEM8_NOEXCEPT                 { return m_value; }
+    fs_op  op() const FILESYSTEM8_NOEXCEPT                    { return m_op; }
+    std::error_code  code() const FILESYSTEM8_NOEXCEPT
+      { return std::error_code(m_value, std::system_category()); }
+
+    explicit operator bool() const FILESYSTEM8_NOEXCEPT       { return m_value != 0; }
+
+    //  The filesystem_error that the throwing function of op would have thrown for p
+    filesystem_error  exception(const path& p) const;
+    [[noreturn]] void  raise(const path& p) const;
+
+    bool operator==(const fs_error& rhs) const FILESYSTEM8_NOEXCEPT
+      { return m_value == rhs.m_value && m_op == rhs.m_op; }
+    bool operator!=(const fs_error& rhs) const FILESYSTEM8_NOEXCEPT
+      { return !(*this == rhs); }
+
+  private:
+    int    m_value;
+    fs_op  m_op;
+  };
+
+  //  Either a T or the fs_error that prevented it, for T a small default-constructible
+  //  value like those the try_ functions return. value() of an error throws
+  //  filesystem_error without a path, which the expected<T> does not have.
+  template <class T>
+  class expected
+  {
+  public:
+    expected(const T& v) FILESYSTEM8_NOEXCEPT : m_value(v) {}
+    expected(fs_error e) FILESYSTEM8_NOEXCEPT : m_value(), m_error(e) {}
+
+    bool  has_value() const FILESYSTEM8_NOEXCEPT              { return !m_error; }
+    explicit operator bool() const FILESYSTEM8_NOEXCEPT       { return !m_error; }
+
+    const T&  operator*() const FILESYSTEM8_NOEXCEPT          { return m_value; }
+    const T*  operator->() const FILESYSTEM8_NOEXCEPT         { return &m_value; }
+
+    const T&  value() const
+    {
+      if (m_error)
+        FILESYSTEM8_THROW(filesystem_error(op_name(m_error.op()), m_error.code()));
+      return m_value;
+    }
+    T  value_or(const T& v) const FILESYSTEM8_NOEXCEPT    { return m_error ? v : m_value; }
+    fs_error  error() const FILESYSTEM8_NOEXCEPT              { return m_error; }
+
+  private:
+    T         m_value;
+    fs_error  m_error;
+  };
+
+  //  error policies  ------------------------------------------------------------------//
+
+  struct nothrow_policy
+  {
+    template <class T> struct result { typedef expected<T> type; };
+
+    template <class T>
+    static expected<T> done(const T& v, fs_error e, const path&) FILESYSTEM8_NOEXCEPT
+      { return e ? expected<T>(e) : expected<T>(v); }
+  };
+
+  struct throw_policy
+  {
+    template <class T> struct result { typedef T type; };
+
+    template <class T>
+    static T done(const T& v, fs_error e, const path& p)
+    {
+      if (e)
+        e.raise(p);
+      return v;
+    }
+  };
+
+  namespace detail
+  {
+#   ifdef FILESYSTEM8_WINDOWS_API
+    const int not_regular_errnum = 50;  // ERROR_NOT_SUPPORTED, as file_size() reports
+#   else
+    const int not_regular_errnum = EPERM;
+#   endif
+
+    //  The status of p, and the error of finding it out, not found not being one
+    inline
+    file_status status_of(const path& p, query_option options, int& errnum)
+      FILESYSTEM8_NOEXCEPT
+    {
+      file_info info;
+      errnum = query_errno(p, file_info_fields::type | file_info_fields::perms, options,
+        info);
+      if (info.type == file_type::not_found)
+        errnum = 0;
+      return errnum != 0 ? file_status(file_type::none) : info.status();
+    }
+  }
+
+  //  basic_ functions  ----------------------------------------------------------------//
+
+  template <class Policy>
+  typename Policy::template result<file_status>::type basic_status(const path& p)
+  {
+    int errnum;
+    file_status st(detail::status_of(p, query_option::none, errnum));
+    return Policy::done(st, fs_error(errnum, fs_op::status), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<file_status>::type basic_symlink_status(const path& p)
+  {
+    int errnum;
+    file_status st(detail::status_of(p, query_option::no_follow, errnum));
+    return Policy::done(st, fs_error(errnum, fs_op::symlink_status), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<bool>::type basic_exists(const path& p)
+  {
+    int errnum;
+    bool result = exists(detail::status_of(p, query_option::none, errnum));
+    return Policy::done(result, fs_error(errnum, fs_op::exists), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<bool>::type basic_is_directory(const path& p)
+  {
+    int errnum;
+    bool result = is_directory(detail::status_of(p, query_option::none, errnum));
+    return Policy::done(result, fs_error(errnum, fs_op::is_directory), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<bool>::type basic_is_regular_file(const path& p)
+  {
+    int errnum;
+    bool result = is_regular_file(detail::status_of(p, query_option::none, errnum));
+    return Policy::done(result, fs_error(errnum, fs_op::is_regular_file), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<std::uintmax_t>::type basic_file_size(const path& p)
+  {
+    file_info info;
+    int errnum = detail::query_errno(p, file_info_fields::type | file_info_fields::size,
+      query_option::none, info);
+    if (errnum == 0 && info.type != file_type::regular)
+      errnum = detail::not_regular_errnum;
+    return Policy::done(errnum != 0 ? static_cast<std::uintmax_t>(-1) : info.size,
+      fs_error(errnum, fs_op::file_size), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<file_time_type>::type
+  basic_last_write_time(const path& p)
+  {
+    file_info info;
+    int errnum = detail::query_errno(p, file_info_fields::mtime, query_option::none, info);
+    return Policy::done(errnum != 0 ? file_time_type::min()
+        : file_time_type(std::chrono::nanoseconds(info.mtime_ns)),
+      fs_error(errnum, fs_op::last_write_time), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<std::uintmax_t>::type
+  basic_hard_link_count(const path& p)
+  {
+    file_info info;
+    int errnum = detail::query_errno(p, file_info_fields::nlink, query_option::none, info);
+    return Policy::done(errnum != 0 ? std::uintmax_t(0) : info.nlink,
+      fs_error(errnum, fs_op::hard_link_count), p);
+  }
+
+  template <class Policy>
+  typename Policy::template result<file_id>::type basic_file_id_of(const path& p)
+  {
+    file_info info;
+    int errnum = detail::query_errno(p, file_info_fields::id, query_option::none, info);
+    return Policy::done(errnum != 0 ? file_id() : info.id(),
+      fs_error(errnum, fs_op::file_id_of), p);
+  }
+
+  //  try_ functions  ------------------------------------------------------------------//
+
+  inline
+  expected<file_status> try_status(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_status<nothrow_policy>(p);}
+  inline
+  expected<file_status> try_symlink_status(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_symlink_status<nothrow_policy>(p);}
+  inline
+  expected<bool> try_exists(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_exists<nothrow_policy>(p);}
+  inline
+  expected<bool> try_is_directory(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_is_directory<nothrow_policy>(p);}
+  inline
+  expected<bool> try_is_regular_file(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_is_regular_file<nothrow_policy>(p);}
+  inline
+  expected<std::uintmax_t> try_file_size(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_file_size<nothrow_policy>(p);}
+  inline
+  expected<file_time_type> try_last_write_time(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_last_write_time<nothrow_policy>(p);}
+  inline
+  expected<std::uintmax_t> try_hard_link_count(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_hard_link_count<nothrow_policy>(p);}
+  inline
+  expected<file_id> try_file_id_of(const path& p) FILESYSTEM8_NOEXCEPT
+                                       {return basic_file_id_of<nothrow_policy>(p);}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_EXPECTED_HPP
@@ -0,0 +1,234 @@
+//  filesystem8/file_info.hpp  ---------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_FILE_INFO_HPP
+#define FILESYSTEM8_FILE_INFO_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                  query, file_info                                    //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  query(p, fields) returns whichever of the metadata of p are asked for from a single
+//  system call, where exists(), is_regular_file(), file_size() and last_write_time()
+//  each make their own. On Linux that call is statx(), told which fields are wanted so
+//  that a filesystem may skip the work of the others, btime among them; elsewhere, and
+//  on kernels without statx(), it is stat(), or on Windows GetFileInformationByHandle().
+//
+//  file_info::fields tells which of the members were filled in: those asked for that
+//  the filesystem supplied. btime in particular is not kept by every filesystem.
+//
+//  Like status(), query() of a path that does not exist is not an error for the
+//  throwing overloads: the result has type file_type::not_found and fields type.
+
+  enum class file_info_fields
+  {
+    none = 0,
+    type = 1,           // file_info::type
+    perms = 2,          // file_info::permissions
+    size = 4,
+    blocks = 8,
+    nlink = 0x10,
+    owner = 0x20,       // uid and gid
+    id = 0x40,          // dev and ino
+    atime = 0x80,
+    mtime = 0x100,
+    ctime = 0x200,
+    btime = 0x400,      // creation time
+    all = 0x7FF
+  };
+
+  FILESYSTEM8_BITMASK(file_info_fields)
+
+  enum class query_option
+  {
+    none = 0,
+    no_follow = 1,      // a symlink itself, as symlink_status() reports it
+    dont_sync = 2       // on a network filesystem, what is cached locally rather than
+                        // asking the server, which may be stale (AT_STATX_DONT_SYNC);
+                        // ignored where statx() is not used
+  };
+
+  FILESYSTEM8_BITMASK(query_option)
+
+  struct file_info
+  {
+    file_info_fields  fields;       // the members below that are valid
+    file_type         type;
+    perms             permissions;
+    std::uintmax_t    size;         // in bytes
+    std::uintmax_t    blocks;       // allocated, in 512-byte units
+    std::uintmax_t    nlink;
+    std::uint32_t     uid;
+    std::uint32_t     gid;
+    std::uint64_t     dev;
+    std::uint64_t     ino;
+    std::int64_t      atime_ns;     // nanoseconds since the epoch
+    std::int64_t      mtime_ns;
+    std::int64_t      ctime_ns;     // of the last status change; not creation
+    std::int64_t      btime_ns;
+
+    file_info()
+      : fields(file_info_fields::none), type(file_type::none), permissions(perms::unknown),
+        size(0), blocks(0), nlink(0), uid(0), gid(0), dev(0), ino(0),
+        atime_ns(0), mtime_ns(0), ctime_ns(0), btime_ns(0) {}
+
+    //  Returns: true if all of f are valid
+    bool has(file_info_fields f) const
+      { return (fields & f) == f; }
+
+    //  Returns: as status() would, so perms::none if type is not_found
+    file_status status() const
+    {
+      return file_status(type, has(file_info_fields::perms) || type == file_type::not_found
+        ? permissions : perms::unknown);
+    }
+
+    file_id id() const
+      { return file_id(dev, ino); }
+  };
+
+  namespace detail
+  {
+    FILESYSTEM8_EXPORT
+    file_info query(const path& p, file_info_fields fields, query_option options,
+      std::error_code* ec=0);
+
+    //  Returns: the errno, or GetLastError() value, of query(p, fields, options), with
+    //  info set as query() would set it, not found included; reports nothing else
+    FILESYSTEM8_EXPORT
+    int query_errno(const path& p, file_info_fields fields, query_option options,
+      file_info& info) FILESYSTEM8_NOEXCEPT;
+  }
+
+  inline
+  file_info query(const path& p, file_info_fields fields = file_info_fields::all,
+    query_option options = query_option::none)
+                                       {return detail::query(p, fields, options);}
+  inline
+  file_info query(const path& p, file_info_fields fields,
+    std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return detail::query(p, fields, query_option::none, &ec);}
+  inline
+  file_info query(const path& p, file_info_fields fields, query_option options,
+    std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return detail::query(p, fields, options, &ec);}
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                query_many, status_many, symlink_status_many, touch_many              //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  query_many(paths, count, results, fields) sets each results[i] to query(paths[i],
+//  fields), for a batch such as the dependencies of a build, where each query is the
+//  latency of one system call and little else. The batch is sorted by parent directory
+//  and split into slices, which the threads of a work-stealing pool take in turn; each
+//  directory in a slice is opened once, and its paths queried relative to it, so the
+//  kernel resolves the directory's path once rather than once per path. On Windows the
+//  slices are queried path by path. A batch too small to be worth the threads is
+//  queried on the calling thread.
+//
+//  status_many() and symlink_status_many() do the same for status() and
+//  symlink_status(), with only the type and permissions asked for.
+//
+//  With batch_options::order directory_order::inode, the paths of each directory in a
+//  slice are queried in the order of their inode numbers, as directory_iterator visits
+//  entries with it, and for the same reason; the inode numbers are found by reading the
+//  directory, up to the last of the slice's names, which is only worth it for a batch
+//  with many paths in each directory. Ignored on Windows.
+//
+//  A path that does not exist is not an error, as for query() and status(). Any other
+//  error leaves that result as a default-constructed file_info, or status_error, without
+//  stopping the others; once all are done, the error of the first such path in the batch
+//  is thrown or reported via ec. Failing to allocate the batch, or to start the pool's
+//  threads, is thrown even with ec, as std::bad_alloc or std::system_error.
+
+  struct batch_options
+  {
+    unsigned         threads;  // 0 means std::thread::hardware_concurrency(); 1 means
+                               // the calling thread only
+    directory_order  order;    // of the paths of each directory
+
+    batch_options() : threads(0), order(directory_order::native) {}
+  };
+
+  namespace detail
+  {
+    FILESYSTEM8_EXPORT
+    void query_many(const path* paths, std::size_t count, file_info* results,
+      file_info_fields fields, query_option options, const batch_options& batch,
+      std::error_code* ec=0);
+    FILESYSTEM8_EXPORT
+    void status_many(const path* paths, std::size_t count, file_status* results,
+      query_option options, const batch_options& batch, std::error_code* ec=0);
+  }
+
+  inline
+  void query_many(const path* paths, std::size_t count, file_info* results,
+    file_info_fields fields, query_option options = query_option::none,
+    const batch_options& batch = batch_options())
+    {detail::query_many(paths, count, results, fields, options, batch);}
+  inline
+  void query_many(const path* paths, std::size_t count, file_info* results,
+    file_info_fields fields, query_option options, const batch_options& batch,
+    std::error_code& ec)
+    {detail::query_many(paths, count, results, fields, options, batch, &ec);}
+
+  inline
+  void status_many(const path* paths, std::size_t count, file_status* results,
+    const batch_options& batch = batch_options())
+    {detail::status_many(paths, count, results, query_option::none, batch);}
+  inline
+  void status_many(const path* paths, std::size_t count, file_status* results,
+    const batch_options& batch, std::error_code& ec)
+    {detail::status_many(paths, count, results, query_option::none, batch, &ec);}
+
+  inline
+  void symlink_status_many(const path* paths, std::size_t count, file_status* results,
+    const batch_options& batch = batch_options())
+    {detail::status_many(paths, count, results, query_option::no_follow, batch);}
+  inline
+  void symlink_status_many(const path* paths, std::size_t count, file_status* results,
+    const batch_options& batch, std::error_code& ec)
+    {detail::status_many(paths, count, results, query_option::no_follow, batch, &ec);}
+
+//  touch_many(paths, count, new_time) sets the last write time of each of paths to
+//  new_time, as last_write_time(p, new_time) does, for the outputs of a build step;
+//  the batch is split up as for query_many(), and each time set with one utimensat()
+//  relative to the directory. A path that does not exist is not created; it is an error,
+//  reported as other errors are above.
+
+  namespace detail
+  {
+    FILESYSTEM8_EXPORT
+    void touch_many(const path* paths, std::size_t count, file_time_type new_time,
+      const batch_options& batch, std::error_code* ec=0);
+  }
+
+  inline
+  void touch_many(const path* paths, std::size_t count, file_time_type new_time,
+    const batch_options& batch = batch_options())
+    {detail::touch_many(paths, count, new_time, batch);}
+  inline
+  void touch_many(const path* paths, std::size_t count, file_time_type new_time,
+    const batch_options& batch, std::error_code& ec)
+    {detail::touch_many(paths, count, new_time, batch, &ec);}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_FILE_INFO_HPP
@@ -15,6 +15,18 @@
 #  include <filesystem8/config.hpp>
 #  include <filesystem8/path.hpp>
 #  include <filesystem8/operations.hpp>
+#  include <filesystem8/parallel_walk.hpp>
+#  include <filesystem8/generator.hpp>
+#  include <filesystem8/breadth_first.hpp>
+#  include <filesystem8/tree_cache.hpp>
+#  include <filesystem8/rescan.hpp>
+#  include <filesystem8/tree_index.hpp>
+#  include <filesystem8/disk_usage.hpp>
+#  include <filesystem8/sorted_listing.hpp>
+#  include <filesystem8/file_info.hpp>
+#  include <filesystem8/metadata_cache.hpp>
+#  include <filesystem8/existence_filter.hpp>
+#  include <filesystem8/expected.hpp>
 #  include <filesystem8/string_file.hpp>
 
 #endif  // FILESYSTEM8_FILESYSTEM_HPP 
@@ -0,0 +1,325 @@
+//  filesystem8/generator.hpp  ---------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+//  Coroutine counterparts of directory_iterator and recursive_directory_iterator.
+//  Requires C++20 coroutines; this header is empty otherwise.
+//
+//  The traversal state - one detail::dir_itr_imp per open directory - lives in the
+//  coroutine frame rather than behind a shared_ptr, and the generator suspends after
+//  each entry, so a consumer can interleave a long walk with other work on a single
+//  thread. async_walk() does exactly that by reposting itself on an executor.
+
+#ifndef FILESYSTEM8_GENERATOR_HPP
+#define FILESYSTEM8_GENERATOR_HPP
+
+#include <filesystem8/config.hpp>
+
+#ifdef FILESYSTEM8_HAS_COROUTINES
+
+#include <filesystem8/operations.hpp>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                    generator                                         //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  A move-only, single pass range of const T& produced by a coroutine. A yielded
+//  reference is valid until the generator is resumed again.
+
+  template <class T>
+  class generator
+  {
+  public:
+    struct promise_type
+    {
+      const T*            value;
+      std::exception_ptr  exception;
+
+      generator get_return_object()
+        { return generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      std::suspend_always final_suspend() const noexcept   { return {}; }
+      std::suspend_always yield_value(const T& v) noexcept
+        { value = std::addressof(v); return {}; }
+      void return_void() const noexcept {}
+      void unhandled_exception() { exception = std::current_exception(); }
+
+      // the traversal never awaits anything but its own yields
+      template <class U> std::suspend_never await_transform(U&&) = delete;
+    };
+
+    class iterator
+    {
+    public:
+      typedef std::input_iterator_tag  iterator_category;
+      typedef T                        value_type;
+      typedef std::ptrdiff_t           difference_type;
+      typedef const T*                 pointer;
+      typedef const T&                 reference;
+
+      iterator() noexcept {}
+
+      reference operator*() const  { return *m_coro.promise().value; }
+      pointer   operator->() const { return m_coro.promise().value; }
+
+      iterator& operator++()
+      {
+        m_coro.resume();
+        rethrow_if_failed();
+        return *this;
+      }
+      void operator++(int) { ++*this; }
+
+      friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept
+        { return !it.m_coro || it.m_coro.done(); }
+
+    private:
+      friend class generator;
+      explicit iterator(std::coroutine_handle<promise_type> coro) : m_coro(coro) {}
+
+      void rethrow_if_failed()
+      {
+        if (m_coro.done() && m_coro.promise().exception)
+          std::rethrow_exception(std::exchange(m_coro.promise().exception, nullptr));
+      }
+
+      std::coroutine_handle<promise_type> m_coro;
+    };
+
+    generator(generator&& rhs) noexcept : m_coro(std::exchange(rhs.m_coro, nullptr)) {}
+    generator& operator=(generator&& rhs) noexcept
+    {
+      if (this != &rhs)
+      {
+        if (m_coro)
+          m_coro.destroy();
+        m_coro = std::exchange(rhs.m_coro, nullptr);
+      }
+      return *this;
+    }
+    ~generator() { if (m_coro) m_coro.destroy(); }
+
+    //  Starts the coroutine; call at most once.
+    iterator begin()
+    {
+      iterator it(m_coro);
+      ++it;
+      return it;
+    }
+    std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+  private:
+    explicit generator(std::coroutine_handle<promise_type> coro) : m_coro(coro) {}
+
+    std::coroutine_handle<promise_type> m_coro;
+  };
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                            directory entry generators                                //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  Same entries, in the same order, as directory_iterator(p). Errors are thrown from the
+//  iterator increment that encounters them, or with the ec overloads end the sequence
+//  and are reported via ec, which must outlive the generator.
+
+  inline
+  generator<directory_entry> directory_entries(path p, std::error_code* ec)
+  {
+    if (ec != 0)
+      ec->clear();
+
+    detail::dir_itr_imp imp;
+    std::error_code result = detail::dir_itr_imp_open(imp, p);
+
+    while (!result && !imp.at_end())
+    {
+      co_yield imp.dir_entry;
+      result = detail::dir_itr_imp_increment(imp);
+    }
+
+    if (result)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error("filesystem8::directory_entries", p, result));
+      *ec = result;
+    }
+  }
+
+  inline
+  generator<directory_entry> directory_entries(path p)
+                                       {return directory_entries(std::move(p), 0);}
+  inline
+  generator<directory_entry> directory_entries(path p, std::error_code& ec)
+                                       {return directory_entries(std::move(p), &ec);}
+
+//  Same entries, in the same order, as recursive_directory_iterator(p, opt).
+
+  inline
+  generator<directory_entry> recursive_directory_entries(path p, symlink_option opt,
+    std::error_code* ec)
+  {
+    if (ec != 0)
+      ec->clear();
+
+    // deque, because a dir_itr_imp owns an open handle and must never be relocated
+    std::deque<detail::dir_itr_imp> stack(1);
+    path error_path(p);
+    std::error_code result = detail::dir_itr_imp_open(stack.back(), p);
+
+    // symlink_option::skip_visited: the directories opened, as recursive_directory_iterator
+    // keeps them
+    std::unique_ptr<detail::visited_directories> visited;
+    if ((opt & (symlink_option::recurse | symlink_option::skip_visited))
+      == (symlink_option::recurse | symlink_option::skip_visited))
+    {
+      visited.reset(new detail::visited_directories);
+      file_id key;
+      if (!result && !detail::directory_iterator_key(stack.back(), p, key))
+        visited->insert(key);
+    }
+
+    while (!result)
+    {
+      // drop finished directories, moving each parent past the directory just finished
+      while (!stack.empty() && stack.back().at_end())
+      {
+        stack.pop_back();
+        if (!stack.empty()
+          && (result = detail::dir_itr_imp_increment(stack.back())))
+        {
+          error_path = stack.back().dir_entry.path().parent_path();
+          break;
+        }
+      }
+      if (result || stack.empty())
+        break;
+
+      co_yield stack.back().dir_entry;
+
+      if (detail::is_recursable_directory(stack.back().dir_entry, opt, result))
+      {
+        error_path = stack.back().dir_entry.path();
+        stack.emplace_back();
+        result = detail::dir_itr_imp_open(stack.back(), error_path);
+        file_id key;
+        if (!result && visited && !stack.back().at_end()
+          && !(result = detail::directory_iterator_key(stack.back(), error_path, key))
+          && !visited->insert(key))
+        {
+          // seen before: step over it, as over a directory already finished
+          stack.pop_back();
+          if ((result = detail::dir_itr_imp_increment(stack.back())))
+            error_path = stack.back().dir_entry.path().parent_path();
+        }
+      }
+      else if (result)
+        error_path = stack.back().dir_entry.path();
+      else if ((result = detail::dir_itr_imp_increment(stack.back())))
+        error_path = stack.back().dir_entry.path().parent_path();
+    }
+
+    if (result)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error("filesystem8::recursive_directory_entries",
+          error_path, result));
+      *ec = result;
+    }
+  }
+
+  inline
+  generator<directory_entry> recursive_directory_entries(path p,
+    symlink_option opt = symlink_option::none)
+                                       {return recursive_directory_entries(std::move(p), opt, 0);}
+  inline
+  generator<directory_entry> recursive_directory_entries(path p, symlink_option opt,
+    std::error_code& ec)
+                                       {return recursive_directory_entries(std::move(p), opt, &ec);}
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                    async_walk                                        //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  Drives gen from executor ex: any copyable callable that takes a nullary function
+//  object and arranges for it to be called later, typically by posting it to an event
+//  loop. Each call hands at most batch entries to visitor(const directory_entry&) and
+//  then reposts itself, so the loop regains control between batches. Finally
+//  done(std::exception_ptr) is called, with a null pointer if the walk completed.
+
+  template <class Executor, class Visitor, class Done>
+  void async_walk(Executor ex, generator<directory_entry> gen, Visitor visitor, Done done,
+    std::size_t batch = 64)
+  {
+    struct state
+    {
+      generator<directory_entry>            gen;
+      generator<directory_entry>::iterator  it;
+      bool                                  started;
+      Visitor                               visitor;
+      Done                                  done;
+
+      state(generator<directory_entry>&& g, Visitor&& v, Done&& d)
+        : gen(std::move(g)), started(false), visitor(std::move(v)), done(std::move(d)) {}
+    };
+
+    struct step
+    {
+      Executor                ex;
+      std::shared_ptr<state>  s;
+      std::size_t             batch;
+
+      void operator()() const
+      {
+        try
+        {
+          if (!s->started)
+          {
+            s->started = true;
+            s->it = s->gen.begin();
+          }
+          for (std::size_t n = 0; n < batch && s->it != s->gen.end(); ++n, ++s->it)
+            s->visitor(*s->it);
+          if (s->it == s->gen.end())
+          {
+            s->done(std::exception_ptr());
+            return;
+          }
+        }
+        catch (...)
+        {
+          s->done(std::current_exception());
+          return;
+        }
+        ex(*this);
+      }
+    };
+
+    step first = {ex, std::make_shared<state>(std::move(gen), std::move(visitor),
+      std::move(done)), batch == 0 ? 1 : batch};
+    ex(first);
+  }
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_HAS_COROUTINES
+
+#endif  // FILESYSTEM8_GENERATOR_HPP
@@ -0,0 +1,139 @@
+//  filesystem8/metadata_cache.hpp  ----------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_METADATA_CACHE_HPP
+#define FILESYSTEM8_METADATA_CACHE_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <filesystem8/file_info.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                  metadata_cache                                      //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  An opt-in cache in front of status(), symlink_status(), file_size() and
+//  last_write_time(), for a process that asks about the same paths again and again,
+//  such as a server checking exists() on its hot paths per request. Its member functions
+//  answer as the functions of the same name do, but from what was found out about the
+//  path no longer than ttl ago; a miss makes one query() for the type, permissions, size
+//  and mtime together, so status() followed by file_size() of a path costs one system
+//  call between them. That a path does not exist is cached as well; any other error is
+//  not.
+//
+//  Entries are keyed by the path as given, so a/b and a/./b are cached apart, and
+//  what status() and symlink_status() found is cached apart. The cache is split into
+//  shards, each with its own lock, picked by a hash of the path, so that threads asking
+//  about different paths seldom wait for each other. The query of a miss is made
+//  without a lock held. A shard that reaches its share of max_entries first drops its
+//  expired entries, and if that is not enough, all of them.
+//
+//  A change made through the cache's own process is not seen until the entry expires
+//  unless the path is invalidated: invalidate(p) drops the entries of p, and
+//  invalidate_subtree(p) those of p and every path below it. A miss whose query was
+//  under way when its shard was invalidated or cleared still answers its caller, but is
+//  not cached, as what it found may be from before the change.
+//
+//  A miss is answered by miss(), which a derived class may override to find out about
+//  paths some other way, such as from a filesystem of its own or a test's.
+
+  struct metadata_cache_options
+  {
+    std::chrono::steady_clock::duration  ttl;  // how long an entry is used
+    unsigned     shards;       // rounded up to a power of two; 0 means 1
+    std::size_t  max_entries;  // across all shards, roughly; 0 means no limit
+
+    metadata_cache_options()
+      : ttl(std::chrono::seconds(1)), shards(16), max_entries(1024 * 1024) {}
+  };
+
+  struct metadata_cache_stats
+  {
+    std::uint64_t  hits;
+    std::uint64_t  misses;
+    std::size_t    entries;  // paths cached, expired or not
+  };
+
+  class FILESYSTEM8_EXPORT metadata_cache
+  {
+  public:
+    explicit metadata_cache(
+      const metadata_cache_options& options = metadata_cache_options());
+    virtual ~metadata_cache();
+
+    metadata_cache(const metadata_cache&) = delete;
+    metadata_cache& operator=(const metadata_cache&) = delete;
+
+    file_status     status(const path& p)
+                                       {return m_status(p, true, 0);}
+    file_status     status(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return m_status(p, true, &ec);}
+    file_status     symlink_status(const path& p)
+                                       {return m_status(p, false, 0);}
+    file_status     symlink_status(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return m_status(p, false, &ec);}
+    std::uintmax_t  file_size(const path& p)
+                                       {return m_file_size(p, 0);}
+    std::uintmax_t  file_size(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return m_file_size(p, &ec);}
+    std::time_t     last_write_time(const path& p)
+                                       {return m_last_write_time(p, 0);}
+    std::time_t     last_write_time(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return m_last_write_time(p, &ec);}
+
+    bool exists(const path& p)         {return filesystem8::exists(status(p));}
+    bool exists(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return filesystem8::exists(status(p, ec));}
+    bool is_directory(const path& p)   {return filesystem8::is_directory(status(p));}
+    bool is_directory(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return filesystem8::is_directory(status(p, ec));}
+    bool is_regular_file(const path& p)
+                                       {return filesystem8::is_regular_file(status(p));}
+    bool is_regular_file(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return filesystem8::is_regular_file(status(p, ec));}
+
+    void  invalidate(const path& p);
+    void  invalidate_subtree(const path& p);
+    void  clear();
+
+    metadata_cache_stats  stats() const;
+
+  protected:
+    //  Called with no lock held. Returns: what query() finds of the type, permissions,
+    //  size and mtime of p, following symlinks if follow, and sets ec to its error
+    virtual file_info  miss(const path& p, bool follow, std::error_code& ec);
+
+  private:
+    struct entry;
+    struct shard;
+
+    metadata_cache_options               m_options;
+    std::size_t                          m_shard_limit;  // entries per shard; 0 is none
+    std::vector<std::unique_ptr<shard> > m_shards;
+
+    //  Returns: what query() found of p, and sets errnum to its error, if any
+    file_info       m_lookup(const path& p, bool follow, int& errnum);
+    file_status     m_status(const path& p, bool follow, std::error_code* ec);
+    std::uintmax_t  m_file_size(const path& p, std::error_code* ec);
+    std::time_t     m_last_write_time(const path& p, std::error_code* ec);
+  };
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_METADATA_CACHE_HPP
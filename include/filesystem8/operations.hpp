@@ -19,15 +19,21 @@
 #include <filesystem8/path.hpp>
 
 #include <filesystem8/detail/bitmask.hpp>
+#include <filesystem8/detail/bloom_filter.hpp>
 #include <system_error>
 #include <memory>
 #include <type_traits>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <utility> // for pair
 #include <ctime>
+#include <chrono>
 #include <vector>
 #include <stack>
+#include <deque>
+#include <algorithm>
+#include <unordered_set>
 
 #ifdef FILESYSTEM8_WINDOWS_API
 #  include <fstream>
@@ -307,6 +313,62 @@ FILESYSTEM8_BITMASK(perms)
                                           { return exists(f) && !is_regular_file(f)
                                                 && !is_directory(f) && !is_symlink(f); }
 
+//--------------------------------------------------------------------------------------//
+//                                   file_time_type                                     //
+//--------------------------------------------------------------------------------------//
+
+  //  A file time to the nanosecond; std::time_t, as last_write_time() returns it, drops
+  //  what the filesystem keeps below the second
+  typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds>
+    file_time_type;
+
+//--------------------------------------------------------------------------------------//
+//                                      file_id                                         //
+//--------------------------------------------------------------------------------------//
+
+  //  Identifies a file by device and inode number, or on Windows by volume serial number
+  //  and file index. Two paths name the same file if their ids are equal, so hard links
+  //  and equivalent paths among many are found by hashing or sorting ids instead of
+  //  comparing paths pairwise. An id holds only while the file exists: one removed may
+  //  have its id reused by a file created after it.
+  struct file_id
+  {
+    std::uint64_t  dev;
+    std::uint64_t  ino;
+
+    file_id() FILESYSTEM8_NOEXCEPT : dev(0), ino(0) {}
+    file_id(std::uint64_t d, std::uint64_t i) FILESYSTEM8_NOEXCEPT : dev(d), ino(i) {}
+
+    bool operator==(const file_id& rhs) const FILESYSTEM8_NOEXCEPT
+      { return dev == rhs.dev && ino == rhs.ino; }
+    bool operator!=(const file_id& rhs) const FILESYSTEM8_NOEXCEPT
+      { return !(*this == rhs); }
+    bool operator< (const file_id& rhs) const FILESYSTEM8_NOEXCEPT
+      { return dev < rhs.dev || (dev == rhs.dev && ino < rhs.ino); }
+    bool operator<=(const file_id& rhs) const FILESYSTEM8_NOEXCEPT {return !(rhs < *this);}
+    bool operator> (const file_id& rhs) const FILESYSTEM8_NOEXCEPT {return rhs < *this;}
+    bool operator>=(const file_id& rhs) const FILESYSTEM8_NOEXCEPT {return !(*this < rhs);}
+  };
+
+  struct file_id_hash
+  {
+    std::size_t operator()(const file_id& id) const FILESYSTEM8_NOEXCEPT
+    {
+      return static_cast<std::size_t>(detail::hash_mix(id.ino ^ detail::hash_mix(id.dev)));
+    }
+  };
+
+  //  On most POSIX filesystems a directory's st_nlink is 2 plus its number of
+  //  subdirectories, so after that many subdirectories the remaining entries can be
+  //  known not to be directories without being stat'ed; find relies on this unless
+  //  given -noleaf. Directories reporting st_nlink < 2, as on btrfs, are never assumed
+  //  to be leaves. Opt in only on filesystems known to keep the convention.
+  enum class leaf_option
+  {
+    none,
+    nlink
+  };
+
   struct space_info
   {
     // all values are byte counts
@@ -329,6 +391,63 @@ FILESYSTEM8_BITMASK(perms)
     create_hard_links = 256
 };
 
+  //  How copy_file() copies the data of a regular file. On Linux it tries, in turn:
+  //  ioctl(FICLONE), by which the new file shares the extents of the old on a copy on
+  //  write filesystem such as Btrfs or XFS, in constant time; copy_file_range(), by
+  //  which the kernel copies, or has the filesystem or NFS server copy, without the
+  //  data passing through the process; and sendfile(), which also copies in the kernel.
+  //  It falls back to read() and write() through a buffer. A way that fails with an
+  //  error meaning only that it does not apply to these files, such as EXDEV or
+  //  EOPNOTSUPP, is given up for the next one, going on from where it stopped; any
+  //  other error is reported. Elsewhere on POSIX only the buffer is used, and on
+  //  Windows, CopyFileW(). copy_file() returns the way that finished the copy.
+  enum class copy_option
+  {
+    none = 0,
+    fail_if_exists = none,
+    overwrite_if_exists = 1,
+
+    no_clone = 0x10,            // the copy's blocks are its own, not shared with from
+    no_copy_file_range = 0x20,
+    no_sendfile = 0x40,
+    buffered = no_clone | no_copy_file_range | no_sendfile
+  };
+
+  FILESYSTEM8_BITMASK(copy_option)
+
+  enum class copy_method
+  {
+    none,             // nothing was copied, on error
+    clone,
+    copy_file_range,
+    sendfile,
+    buffered,
+    system            // CopyFileW(), on Windows
+  };
+
+  //  How copy_file() copies through a buffer, for large files: the buffer is the size of
+  //  the file, rounded up to a page and kept within min_buffer and max_buffer, and the
+  //  source is read with posix_fadvise(POSIX_FADV_SEQUENTIAL). On Linux, preallocate
+  //  has the destination's blocks allocated up front, in as few extents as the
+  //  filesystem can, and a sync_interval has what was written start going to disk every
+  //  that many bytes, waiting for the previous interval's and dropping it from the page
+  //  cache, so that a copy larger than memory neither piles up dirty pages nor pushes
+  //  out everything else cached. direct reads and writes with O_DIRECT, bypassing the
+  //  page cache, where the filesystem supports it, and through it where it does not.
+  //  Use copy_option::buffered to have the buffer used when the kernel could copy.
+  struct copy_tuning
+  {
+    std::size_t     min_buffer;
+    std::size_t     max_buffer;
+    bool            preallocate;
+    std::uintmax_t  sync_interval;  // 0 for none
+    bool            direct;
+
+    copy_tuning()
+      : min_buffer(32768), max_buffer(1024 * 1024), preallocate(true), sync_interval(0),
+        direct(false) {}
+  };
+
 //--------------------------------------------------------------------------------------//
 //                             implementation details                                   //
 //--------------------------------------------------------------------------------------//
@@ -338,14 +457,15 @@ FILESYSTEM8_BITMASK(perms)
     //  We cannot pass a BOOST_SCOPED_ENUM to a compled function because it will result
     //  in an undefined reference if the library is compled with -std=c++0x but the use
     //  is compiled in C++03 mode, or visa versa. See tickets 6124, 6779, 10038.
-    enum copy_option {none=0, fail_if_exists = none, overwrite_if_exists};
+    enum copy_option {none=0, fail_if_exists = none, overwrite_if_exists,
+      no_clone = 0x10, no_copy_file_range = 0x20, no_sendfile = 0x40};
 
     FILESYSTEM8_EXPORT
     file_status status(const path&p, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
     file_status symlink_status(const path& p, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
-    bool is_empty(const path& p, std::error_code* ec=0);
+    bool is_empty(const path& p, leaf_option opt, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
     path initial_path(std::error_code* ec=0);
     FILESYSTEM8_EXPORT
@@ -355,9 +475,12 @@ FILESYSTEM8_BITMASK(perms)
     FILESYSTEM8_EXPORT
     void copy_directory(const path& from, const path& to, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
-    void copy_file(const path& from, const path& to,  // See ticket #2925
+    copy_method copy_file(const path& from, const path& to,  // See ticket #2925
                     detail::copy_option option, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
+    copy_method copy_file(const path& from, const path& to, detail::copy_option option,
+                    const copy_tuning& tuning, std::error_code* ec=0);
+    FILESYSTEM8_EXPORT
     void copy_symlink(const path& existing_symlink, const path& new_symlink, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
     bool create_directories(const path& p, std::error_code* ec=0);
@@ -377,6 +500,8 @@ FILESYSTEM8_BITMASK(perms)
     FILESYSTEM8_EXPORT
     bool equivalent(const path& p1, const path& p2, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
+    file_id file_id_of(const path& p, std::error_code* ec=0);
+    FILESYSTEM8_EXPORT
     std::uintmax_t file_size(const path& p, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
     std::uintmax_t hard_link_count(const path& p, std::error_code* ec=0);
@@ -386,6 +511,10 @@ FILESYSTEM8_BITMASK(perms)
     void last_write_time(const path& p, const std::time_t new_time,
                          std::error_code* ec=0);
     FILESYSTEM8_EXPORT
+    file_time_type last_write_time_ns(const path& p, std::error_code* ec=0);
+    FILESYSTEM8_EXPORT
+    void last_write_time(const path& p, file_time_type new_time, std::error_code* ec=0);
+    FILESYSTEM8_EXPORT
     void permissions(const path& p, perms prms, std::error_code* ec=0);
     FILESYSTEM8_EXPORT
     path read_symlink(const path& p, std::error_code* ec=0);
@@ -455,10 +584,17 @@ FILESYSTEM8_BITMASK(perms)
   bool is_symlink(const path& p, std::error_code& ec)
                                        {return is_symlink(detail::symlink_status(p, &ec));}
   inline
-  bool is_empty(const path& p)         {return detail::is_empty(p);}
+  bool is_empty(const path& p)         {return detail::is_empty(p, leaf_option::none);}
   inline
   bool is_empty(const path& p, std::error_code& ec)
-                                       {return detail::is_empty(p, &ec);}
+                                       {return detail::is_empty(p, leaf_option::none, &ec);}
+  //  leaf_option::nlink: a directory with st_nlink > 2 is not empty; it is not opened
+  inline
+  bool is_empty(const path& p, leaf_option opt)
+                                       {return detail::is_empty(p, opt);}
+  inline
+  bool is_empty(const path& p, leaf_option opt, std::error_code& ec)
+                                       {return detail::is_empty(p, opt, &ec);}
 
 //--------------------------------------------------------------------------------------//
 //                                                                                      //
@@ -498,26 +634,40 @@ FILESYSTEM8_BITMASK(perms)
   void copy_directory(const path& from, const path& to, std::error_code& ec) FILESYSTEM8_NOEXCEPT
                                        {detail::copy_directory(from, to, &ec);}
   inline
-  void copy_file(const path& from, const path& to,   // See ticket #2925
+  copy_method copy_file(const path& from, const path& to,   // See ticket #2925
                  copy_option option)
   {
-    detail::copy_file(from, to, static_cast<detail::copy_option>(option));
+    return detail::copy_file(from, to, static_cast<detail::copy_option>(option));
   }
   inline
-  void copy_file(const path& from, const path& to)
+  copy_method copy_file(const path& from, const path& to)
   {
-    detail::copy_file(from, to, detail::fail_if_exists);
+    return detail::copy_file(from, to, detail::fail_if_exists);
   }
   inline
-  void copy_file(const path& from, const path& to,   // See ticket #2925
+  copy_method copy_file(const path& from, const path& to,   // See ticket #2925
                  copy_option option, std::error_code& ec) FILESYSTEM8_NOEXCEPT
   {
-    detail::copy_file(from, to, static_cast<detail::copy_option>(option), &ec);
+    return detail::copy_file(from, to, static_cast<detail::copy_option>(option), &ec);
+  }
+  inline
+  copy_method copy_file(const path& from, const path& to,
+                 std::error_code& ec) FILESYSTEM8_NOEXCEPT
+  {
+    return detail::copy_file(from, to, detail::fail_if_exists, &ec);
+  }
+  inline
+  copy_method copy_file(const path& from, const path& to, copy_option option,
+                 const copy_tuning& tuning)
+  {
+    return detail::copy_file(from, to, static_cast<detail::copy_option>(option), tuning);
   }
   inline
-  void copy_file(const path& from, const path& to, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+  copy_method copy_file(const path& from, const path& to, copy_option option,
+                 const copy_tuning& tuning, std::error_code& ec) FILESYSTEM8_NOEXCEPT
   {
-    detail::copy_file(from, to, detail::fail_if_exists, &ec);
+    return detail::copy_file(from, to, static_cast<detail::copy_option>(option), tuning,
+      &ec);
   }
   inline
   void copy_symlink(const path& existing_symlink,
@@ -575,6 +725,13 @@ FILESYSTEM8_BITMASK(perms)
   inline
   bool equivalent(const path& p1, const path& p2, std::error_code& ec) FILESYSTEM8_NOEXCEPT
                                        {return detail::equivalent(p1, p2, &ec);}
+  //  The id of the file p resolves to, following symlinks
+  inline
+  file_id file_id_of(const path& p)    {return detail::file_id_of(p);}
+
+  inline
+  file_id file_id_of(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return detail::file_id_of(p, &ec);}
   inline
   std::uintmax_t file_size(const path& p) {return detail::file_size(p);}
 
@@ -611,6 +768,22 @@ FILESYSTEM8_BITMASK(perms)
   void last_write_time(const path& p, const std::time_t new_time,
                        std::error_code& ec) FILESYSTEM8_NOEXCEPT
                                        {detail::last_write_time(p, new_time, &ec);}
+
+  //  To the nanosecond, or as near as the filesystem keeps; setting the time takes one
+  //  utimensat() on POSIX, and leaves the last access time alone
+  inline
+  file_time_type last_write_time_ns(const path& p)
+                                       {return detail::last_write_time_ns(p);}
+  inline
+  file_time_type last_write_time_ns(const path& p, std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {return detail::last_write_time_ns(p, &ec);}
+  inline
+  void last_write_time(const path& p, file_time_type new_time)
+                                       {detail::last_write_time(p, new_time);}
+  inline
+  void last_write_time(const path& p, file_time_type new_time,
+                       std::error_code& ec) FILESYSTEM8_NOEXCEPT
+                                       {detail::last_write_time(p, new_time, &ec);}
   inline
   void permissions(const path& p, perms prms)
                                        {detail::permissions(p, prms);}
@@ -703,27 +876,52 @@ FILESYSTEM8_BITMASK(perms)
 //  sub-namespace that also has a class named path. The workaround is to always
 //  fully qualify the name path when it refers to the class name.
 
+//  An entry read by directory_iterator holds the path of its directory, shared with the
+//  other entries of that directory, and its own filename. The full path is formed the
+//  first time path() is called, like the cached status(); an entry used only by
+//  filename() and status never copies the directory part. A copy of an entry has its
+//  path formed, so that path() of an entry handed to other threads only reads it; like
+//  status(), path() of the iterator's own entry is not to be called from two threads.
+
 class FILESYSTEM8_EXPORT directory_entry
 {
 public:
   typedef filesystem8::path::value_type value_type;   // enables class path ctor taking directory_entry
 
-  directory_entry() FILESYSTEM8_NOEXCEPT {}
+  directory_entry() FILESYSTEM8_NOEXCEPT : m_path_formed(true), m_ids_known(0) {}
   explicit directory_entry(const filesystem8::path& p)
-    : m_path(p), m_status(file_status()), m_symlink_status(file_status())
+    : m_path(p), m_path_formed(true), m_status(file_status()),
+      m_symlink_status(file_status()), m_ids_known(0)
     {}
   directory_entry(const filesystem8::path& p,
     file_status st, file_status symlink_st = file_status())
-    : m_path(p), m_status(st), m_symlink_status(symlink_st) {}
+    : m_path(p), m_path_formed(true), m_status(st), m_symlink_status(symlink_st),
+      m_ids_known(0) {}
 
   directory_entry(const directory_entry& rhs)
-    : m_path(rhs.m_path), m_status(rhs.m_status), m_symlink_status(rhs.m_symlink_status){}
+    : m_parent(rhs.m_parent), m_filename(rhs.m_filename),
+      m_path(rhs.m_path_formed ? rhs.m_path : *rhs.m_parent / rhs.m_filename),
+      m_path_formed(true),
+      m_status(rhs.m_status), m_symlink_status(rhs.m_symlink_status),
+      m_id(rhs.m_id), m_symlink_id(rhs.m_symlink_id), m_ids_known(rhs.m_ids_known){}
 
   directory_entry& operator=(const directory_entry& rhs)
   {
-    m_path = rhs.m_path;
+    m_parent = rhs.m_parent;
+    m_filename = rhs.m_filename;
+    if (rhs.m_path_formed)
+      m_path = rhs.m_path;
+    else
+    {
+      m_path = *rhs.m_parent;
+      m_path /= rhs.m_filename;
+    }
+    m_path_formed = true;
     m_status = rhs.m_status;
     m_symlink_status = rhs.m_symlink_status;
+    m_id = rhs.m_id;
+    m_symlink_id = rhs.m_symlink_id;
+    m_ids_known = rhs.m_ids_known;
     return *this;
   }
 
@@ -734,35 +932,90 @@ public:
 #if !defined(FILESYSTEM8_NO_CXX11_RVALUE_REFERENCES)
   directory_entry(directory_entry&& rhs) FILESYSTEM8_NOEXCEPT
   {
+    m_parent = std::move(rhs.m_parent);
+    m_filename = std::move(rhs.m_filename);
     m_path = std::move(rhs.m_path);
+    m_path_formed = rhs.m_path_formed;
     m_status = std::move(rhs.m_status);
     m_symlink_status = std::move(rhs.m_symlink_status);
+    m_id = rhs.m_id;
+    m_symlink_id = rhs.m_symlink_id;
+    m_ids_known = rhs.m_ids_known;
   }
   directory_entry& operator=(directory_entry&& rhs) FILESYSTEM8_NOEXCEPT
   { 
+    m_parent = std::move(rhs.m_parent);
+    m_filename = std::move(rhs.m_filename);
     m_path = std::move(rhs.m_path);
+    m_path_formed = rhs.m_path_formed;
     m_status = std::move(rhs.m_status);
     m_symlink_status = std::move(rhs.m_symlink_status);
+    m_id = rhs.m_id;
+    m_symlink_id = rhs.m_symlink_id;
+    m_ids_known = rhs.m_ids_known;
     return *this;
   }
 #endif
 
   void assign(const filesystem8::path& p,
     file_status st = file_status(), file_status symlink_st = file_status())
-    { m_path = p; m_status = st; m_symlink_status = symlink_st; }
+  {
+    m_parent.reset();
+    m_filename.clear();
+    m_path = p;
+    m_path_formed = true;
+    m_status = st;
+    m_symlink_status = symlink_st;
+    m_ids_known = 0;
+  }
+
+  //  The entry filename in directory *parent; path() forms parent / filename when called
+  void assign(const std::shared_ptr<const filesystem8::path>& parent,
+    const filesystem8::path& filename,
+    file_status st = file_status(), file_status symlink_st = file_status())
+  {
+    m_parent = parent;
+    m_filename = filename;
+    m_path_formed = false;
+    m_status = st;
+    m_symlink_status = symlink_st;
+    m_ids_known = 0;
+  }
 
   void replace_filename(const filesystem8::path& p,
     file_status st = file_status(), file_status symlink_st = file_status())
   {
-    m_path.remove_filename();
-    m_path /= p;
+    if (m_parent)
+    {
+      m_filename = p;
+      m_path_formed = false;
+    }
+    else
+    {
+      m_path.remove_filename();
+      m_path /= p;
+    }
     m_status = st;
     m_symlink_status = symlink_st;
+    m_ids_known = 0;
+  }
+
+  const filesystem8::path&  path() const
+  {
+    if (!m_path_formed)
+    {
+      m_path = *m_parent;  // reuses the storage of the path formed last
+      m_path /= m_filename;
+      m_path_formed = true;
+    }
+    return m_path;
   }
+  operator const filesystem8::path&() const                   {return path();}
+
+  //  Same as path().filename(), without forming path()
+  filesystem8::path  filename() const
+                           {return m_parent ? m_filename : m_path.filename();}
 
-  const filesystem8::path&  path() const FILESYSTEM8_NOEXCEPT {return m_path;}
-  operator const filesystem8::path&() const FILESYSTEM8_NOEXCEPT
-                                                              {return m_path;}
   file_status   status() const                                {return m_get_status();}
   file_status   status(std::error_code& ec) const FILESYSTEM8_NOEXCEPT
                                                               {return m_get_status(&ec); }
@@ -770,20 +1023,39 @@ public:
   file_status   symlink_status(std::error_code& ec) const FILESYSTEM8_NOEXCEPT
                                                               {return m_get_symlink_status(&ec); }
 
-  bool operator==(const directory_entry& rhs) const FILESYSTEM8_NOEXCEPT {return m_path == rhs.m_path; }
-  bool operator!=(const directory_entry& rhs) const FILESYSTEM8_NOEXCEPT {return m_path != rhs.m_path;} 
-  bool operator< (const directory_entry& rhs) const FILESYSTEM8_NOEXCEPT {return m_path < rhs.m_path;} 
-  bool operator<=(const directory_entry& rhs) const FILESYSTEM8_NOEXCEPT {return m_path <= rhs.m_path;} 
-  bool operator> (const directory_entry& rhs) const FILESYSTEM8_NOEXCEPT {return m_path > rhs.m_path;} 
-  bool operator>=(const directory_entry& rhs) const FILESYSTEM8_NOEXCEPT {return m_path >= rhs.m_path;} 
+  //  The id of the file, following symlinks like status(), and of the entry itself like
+  //  symlink_status(). Each is read once and then cached, along with the status read
+  //  with it if that was not known.
+  file_id       id() const                                    {return m_get_id(true);}
+  file_id       id(std::error_code& ec) const FILESYSTEM8_NOEXCEPT
+                                                              {return m_get_id(true, &ec);}
+  file_id       symlink_id() const                            {return m_get_id(false);}
+  file_id       symlink_id(std::error_code& ec) const FILESYSTEM8_NOEXCEPT
+                                                              {return m_get_id(false, &ec);}
+
+  bool operator==(const directory_entry& rhs) const {return path() == rhs.path(); }
+  bool operator!=(const directory_entry& rhs) const {return path() != rhs.path();} 
+  bool operator< (const directory_entry& rhs) const {return path() < rhs.path();} 
+  bool operator<=(const directory_entry& rhs) const {return path() <= rhs.path();} 
+  bool operator> (const directory_entry& rhs) const {return path() > rhs.path();} 
+  bool operator>=(const directory_entry& rhs) const {return path() >= rhs.path();} 
 
 private:
-  filesystem8::path   m_path;
+  std::shared_ptr<const filesystem8::path>  m_parent;  // 0 if m_path was given whole
+  filesystem8::path         m_filename;         // if m_parent
+  mutable filesystem8::path m_path;
+  mutable bool              m_path_formed;      // else m_path is stale
   mutable file_status       m_status;           // stat()-like
   mutable file_status       m_symlink_status;   // lstat()-like
+  mutable file_id           m_id;
+  mutable file_id           m_symlink_id;
+  mutable unsigned char     m_ids_known;        // id_known | symlink_id_known
+
+  enum { id_known = 1, symlink_id_known = 2 };
 
   file_status m_get_status(std::error_code* ec=0) const;
   file_status m_get_symlink_status(std::error_code* ec=0) const;
+  file_id m_get_id(bool follow, std::error_code* ec=0) const;
 }; // directory_entry
 
 //--------------------------------------------------------------------------------------//
@@ -794,8 +1066,67 @@ private:
 
 class directory_iterator;
 
+//  entry_type_mask selects entries by the type of the entry itself, i.e. symlinks are
+//  not followed. Iteration tests the mask against the type the directory read supplies
+//  (d_type on POSIX) wherever it can, so that excluded entries are neither stat'ed nor
+//  given a path.
+
+  enum class entry_type_mask
+  {
+    none = 0,
+    regular = 1,
+    directory = 2,
+    symlink = 4,
+    other = 8,      // block, character, fifo, socket
+    all = regular | directory | symlink | other
+  };
+
+  FILESYSTEM8_BITMASK(entry_type_mask)
+
+//  directory_order::inode reads the whole directory when it is opened and then visits
+//  the entries in inode number order, so that a caller stat'ing each entry walks the
+//  inode table sequentially instead of seeking at random; on spinning disks and ext4
+//  this is much faster. Costs memory proportional to the directory size. Ignored on
+//  Windows, which does not report inode numbers when reading a directory.
+
+  enum class directory_order
+  {
+    native,   // as the operating system returns the entries
+    inode
+  };
+
 namespace detail
 {
+  //  Returns: the entry_type_mask bit for t, or entry_type_mask::all if t does not tell
+  //  the type, i.e. the status is not known or is an error.
+  inline
+  entry_type_mask entry_type_of(file_type t) FILESYSTEM8_NOEXCEPT
+  {
+    switch (t)
+    {
+      case file_type::regular:   return entry_type_mask::regular;
+      case file_type::directory: return entry_type_mask::directory;
+      case file_type::symlink:   return entry_type_mask::symlink;
+      case file_type::block:
+      case file_type::character:
+      case file_type::fifo:
+      case file_type::socket:    return entry_type_mask::other;
+      default:                   return entry_type_mask::all;
+    }
+  }
+
+  //  Returns: true if e is of one of types. An entry whose type cannot be determined is
+  //  never excluded.
+  inline
+  bool is_type_included(const directory_entry& e, entry_type_mask types) FILESYSTEM8_NOEXCEPT
+  {
+    if (types == entry_type_mask::all)
+      return true;
+    std::error_code ec;
+    file_status st = e.symlink_status(ec);  // from d_type when known, else lstat()
+    return ec || (entry_type_of(st.type()) & types) != entry_type_mask::none;
+  }
+
   FILESYSTEM8_EXPORT
     std::error_code dir_itr_close(// never throws()
     void *& handle
@@ -804,16 +1135,32 @@ namespace detail
 #   endif
   ); 
 
+  struct dir_itr_snapshot_entry
+  {
+    path::string_type  filename;
+    file_status        file_stat;
+    file_status        symlink_file_stat;
+    std::uintmax_t     ino;
+  };
+
   struct dir_itr_imp
   {
     directory_entry  dir_entry;
     void*            handle;
+    entry_type_mask  types;   // entries of other types are skipped
+    directory_order  order;
+
+    //  directory_order::inode, or detached: the entries not yet visited, the next one
+    //  last
+    std::vector<dir_itr_snapshot_entry>  snapshot;
+    bool             detached;  // handle closed early, the rest read into snapshot
 
 #   ifdef FILESYSTEM8_POSIX_API
     void*            buffer;  // see dir_itr_increment implementation
 #   endif
 
-    dir_itr_imp() : handle(0)
+    dir_itr_imp() : handle(0), types(entry_type_mask::all), order(directory_order::native),
+      detached(false)
 #   ifdef FILESYSTEM8_POSIX_API
       , buffer(0)
 #   endif
@@ -827,13 +1174,78 @@ namespace detail
 #       endif
     );
     }
+
+    bool at_end() const FILESYSTEM8_NOEXCEPT { return handle == 0 && !detached; }
   };
 
+  //  The directory reading state machine, independent of the iterator that owns the
+  //  dir_itr_imp. Both position imp on the next entry other than dot or dot-dot; on end
+  //  of directory or on error, imp.at_end() on return. Never throw.
+  FILESYSTEM8_EXPORT
+  std::error_code dir_itr_imp_open(dir_itr_imp& imp, const path& p);
+  FILESYSTEM8_EXPORT
+  std::error_code dir_itr_imp_increment(dir_itr_imp& imp);
+
+  //  Reads the rest of the entries of imp into its snapshot and closes its handle,
+  //  releasing the file descriptor and buffer while iteration goes on unchanged. On
+  //  error, iteration goes on with the entries read before it. A no-op on Windows.
+  FILESYSTEM8_EXPORT
+  std::error_code dir_itr_imp_detach(dir_itr_imp& imp);
+
   // see path::iterator: comment below
   FILESYSTEM8_EXPORT void directory_iterator_construct(directory_iterator& it,
     const path& p, std::error_code* ec);
   FILESYSTEM8_EXPORT void directory_iterator_increment(directory_iterator& it,
     std::error_code* ec);
+  FILESYSTEM8_EXPORT std::error_code directory_iterator_detach(directory_iterator& it);
+
+  //  Sets key to that of the directory it reads, dir, from the handle it holds open if
+  //  any: an fstat rather than a stat of the path on POSIX.
+  FILESYSTEM8_EXPORT std::error_code directory_iterator_key(const directory_iterator& it,
+    const path& dir, file_id& key);
+  FILESYSTEM8_EXPORT std::error_code directory_iterator_key(const dir_itr_imp& imp,
+    const path& dir, file_id& key);
+
+  //  Sets key to that of the entry it is at, following symlinks, before it is opened:
+  //  an fstatat relative to the handle it holds open if any, which on Linux does not
+  //  trigger an automount.
+  FILESYSTEM8_EXPORT std::error_code directory_entry_key(const directory_iterator& it,
+    file_id& key);
+
+  //  Sets key to that of p, following symlinks
+  FILESYSTEM8_EXPORT std::error_code path_key(const path& p, file_id& key);
+
+  //  Appends the devices of the mounted pseudo filesystems, such as proc and sysfs, as
+  //  /proc/self/mountinfo lists them. Appends none on other than Linux.
+  FILESYSTEM8_EXPORT std::error_code pseudo_filesystem_devices(
+    std::vector<std::uint64_t>& devices);
+
+  //  The directories a traversal has opened, so that it opens none twice. With a
+  //  prefilter, a key not yet seen is usually told so by a few bits of a Bloom filter
+  //  instead of by probing the set.
+  class visited_directories
+  {
+  public:
+    explicit visited_directories(std::size_t prefilter_bits = 0)
+      : m_prefilter(prefilter_bits) {}
+
+    //  Returns: true if key was not seen before
+    bool insert(const file_id& key)
+    {
+      if (m_prefilter.bits() == 0)
+        return m_seen.insert(key).second;
+      std::uint64_t h = file_id_hash()(key);
+      if (m_prefilter.may_contain(h) && m_seen.count(key) != 0)
+        return false;
+      m_prefilter.insert(h);
+      m_seen.insert(key);
+      return true;
+    }
+
+  private:
+    bloom_filter  m_prefilter;
+    std::unordered_set<file_id, file_id_hash>  m_seen;
+  };
 
 }  // namespace detail
 
@@ -862,6 +1274,31 @@ namespace detail
         : m_imp(new detail::dir_itr_imp)
           { detail::directory_iterator_construct(*this, p, &ec); }
 
+    //  Only entries of one of types, in the given order; see entry_type_mask and
+    //  directory_order
+    directory_iterator(const path& p, entry_type_mask types,
+      directory_order order = directory_order::native)
+        : m_imp(new detail::dir_itr_imp)
+    {
+      m_imp->types = types;
+      m_imp->order = order;
+      detail::directory_iterator_construct(*this, p, 0);
+    }
+
+    directory_iterator(const path& p, entry_type_mask types,
+      std::error_code& ec) FILESYSTEM8_NOEXCEPT
+        : m_imp(new detail::dir_itr_imp)
+          { m_imp->types = types; detail::directory_iterator_construct(*this, p, &ec); }
+
+    directory_iterator(const path& p, entry_type_mask types, directory_order order,
+      std::error_code& ec) FILESYSTEM8_NOEXCEPT
+        : m_imp(new detail::dir_itr_imp)
+    {
+      m_imp->types = types;
+      m_imp->order = order;
+      detail::directory_iterator_construct(*this, p, &ec);
+    }
+
    ~directory_iterator() {}
 
     directory_iterator& increment(std::error_code& ec) FILESYSTEM8_NOEXCEPT
@@ -879,6 +1316,12 @@ namespace detail
       const path& p, std::error_code* ec);
     friend FILESYSTEM8_EXPORT void detail::directory_iterator_increment(directory_iterator& it,
       std::error_code* ec);
+    friend FILESYSTEM8_EXPORT std::error_code detail::directory_iterator_detach(
+      directory_iterator& it);
+    friend FILESYSTEM8_EXPORT std::error_code detail::directory_iterator_key(
+      const directory_iterator& it, const path& dir, file_id& key);
+    friend FILESYSTEM8_EXPORT std::error_code detail::directory_entry_key(
+      const directory_iterator& it, file_id& key);
 
     // shared_ptr provides shallow-copy semantics required for InputIterators.
     // m_imp.get()==0 indicates the end iterator.
@@ -938,28 +1381,249 @@ namespace filesystem8
     none,
     no_recurse = none,         // don't follow directory symlinks (default behavior)
     recurse,                   // follow directory symlinks
-    _detail_no_push = recurse << 1  // internal use only
+    _detail_no_push = recurse << 1,  // internal use only
+    skip_visited = recurse << 2  // with recurse, descend into each directory only once
   };
   
   FILESYSTEM8_BITMASK(symlink_option)
 
+//  Following directory symlinks may lead back into a directory being traversed, and so
+//  around forever, or into one traversed already. With symlink_option::skip_visited, a
+//  traversal remembers the device and inode number of each directory it opens, and a
+//  directory seen before is visited as an entry but not descended into again. That costs
+//  an fstat of each directory opened, and memory for the set, which
+//  recursion_options::visited_prefilter may front with a Bloom filter of that many bits.
+
+//  A traversal with mount_option::one_file_system descends only into directories on the
+//  same device as its root, like find -xdev or du -x; with skip_pseudo, it does not
+//  descend into those on proc, sysfs and other pseudo filesystems, as listed by
+//  /proc/self/mountinfo, which is read once per traversal. The device of a directory is
+//  found before it is opened, by an fstatat relative to the directory being read, so a
+//  network filesystem or automount point skipped is not even opened. Either costs that
+//  stat per directory; the root itself is always traversed. skip_pseudo does nothing on
+//  other than Linux. If the root's device cannot be found out, or mountinfo cannot be
+//  read, the traversal fails as if the root could not be opened.
+
+  enum class mount_option
+  {
+    none = 0,
+    one_file_system = 1,
+    skip_pseudo = 2
+  };
+
+  FILESYSTEM8_BITMASK(mount_option)
+
+//  Options a recursive traversal applies as it reads each directory, so that what it
+//  is told to skip costs as little as possible. The default is to visit everything.
+
+  struct recursion_options
+  {
+    symlink_option   symlinks;   // whether directory symlinks are followed
+    int              max_depth;  // deepest depth() visited; -1 means no limit
+    entry_type_mask  types;      // entries visited; directories of other types are
+                                 // still descended into
+    directory_order  order;      // within each directory
+    leaf_option      leaf;       // ignored if directory symlinks are followed
+
+    //  If set and it returns true for a directory, the directory is not descended into,
+    //  just as if disable_recursion_pending() had been called for it. It is called
+    //  before the directory is stat'ed or opened, so it should decide by name, as in
+    //    [](const directory_entry& e) { return e.filename() == ".git"; }
+    //  It must not throw if the error_code overloads are used.
+    std::function<bool(const directory_entry&)>  prune;
+
+    //  If nonzero, the most directories recursive_directory_iterator holds open at once.
+    //  Opening one more first reads the rest of the shallowest open directory into
+    //  memory and closes it, so a tree of any depth needs only this many descriptors.
+    //  parallel_walk, which holds one directory open per thread, ignores it.
+    std::size_t      open_limit;
+
+    std::size_t      visited_prefilter;  // see symlink_option::skip_visited
+    mount_option     mounts;     // which filesystems are descended into
+
+    recursion_options()
+      : symlinks(symlink_option::none), max_depth(-1), types(entry_type_mask::all),
+        order(directory_order::native), leaf(leaf_option::none), open_limit(0),
+        visited_prefilter(0), mounts(mount_option::none) {}
+  };
+
   namespace detail
   {
+    //  Returns: the types a recursive traversal must read to visit types: it also needs
+    //  the directories, and the symlinks if directory symlinks are followed.
+    inline
+    entry_type_mask traversal_read_types(entry_type_mask types,
+      symlink_option opts) FILESYSTEM8_NOEXCEPT
+    {
+      types |= entry_type_mask::directory;
+      if ((opts & symlink_option::recurse) == symlink_option::recurse)
+        types |= entry_type_mask::symlink;
+      return types;
+    }
+
+    //  Returns: the number of subdirectories of dir that leaf_option::nlink lets a
+    //  traversal assume, or uintmax_t(-1) if it cannot assume anything.
+    inline
+    std::uintmax_t subdirectory_count(const path& dir,
+      const recursion_options& options) FILESYSTEM8_NOEXCEPT
+    {
+      if (options.leaf != leaf_option::nlink
+        || (options.symlinks & symlink_option::recurse) == symlink_option::recurse)
+        return static_cast<std::uintmax_t>(-1);
+      std::error_code ec;
+      std::uintmax_t links = detail::hard_link_count(dir, &ec);
+      return ec || links < 2 ? static_cast<std::uintmax_t>(-1) : links - 2;
+    }
+
+    //  Returns: true if a traversal with options should consider descending into e,
+    //  a directory at the given depth, before it stat's e.
+    inline
+    bool is_descent_allowed(const directory_entry& e, int depth,
+      const recursion_options& options)
+    {
+      return (options.max_depth < 0 || depth < options.max_depth)
+        && !(options.prune && options.prune(e));
+    }
+
+    //  Returns: true if e is a directory that a recursive traversal should descend into,
+    //  taking symlink_option::recurse into account. Always returns false on error.
+    //  Shared by recursive_directory_iterator and parallel_walk() so that both follow
+    //  directory symlinks under exactly the same conditions.
+    inline
+    bool is_recursable_directory(const directory_entry& e, symlink_option opts,
+      std::error_code& ec) FILESYSTEM8_NOEXCEPT
+    {
+      // Logic for following predicate was contributed by Daniel Aarno to handle cyclic
+      // symlinks correctly and efficiently, fixing ticket #5652.
+      //   if (((m_options & symlink_option::recurse) == symlink_option::recurse
+      //         || !is_symlink(m_stack.top()->symlink_status()))
+      //       && is_directory(m_stack.top()->status())) ...
+      // The predicate code has since been rewritten to pass error_code arguments,
+      // per ticket #5653.
+
+      ec.clear();
+      file_status symlink_stat;
+
+      if ((opts & symlink_option::recurse) != symlink_option::recurse)
+      {
+        symlink_stat = e.symlink_status(ec);
+        if (ec)
+          return false;
+      }
+
+      if ((opts & symlink_option::recurse) == symlink_option::recurse
+        || !is_symlink(symlink_stat))
+      {
+        file_status stat = e.status(ec);
+        return !ec && is_directory(stat);
+      }
+      return false;
+    }
+
+    //  recursion_options::mounts, for one traversal
+    class device_filter
+    {
+    public:
+      explicit device_filter(mount_option opts) : m_options(opts), m_root(0) {}
+
+      //  it reads root, the root of the traversal
+      std::error_code start(const directory_iterator& it, const path& root)
+      {
+        file_id key;
+        std::error_code ec = directory_iterator_key(it, root, key);
+        m_root = key.dev;
+        if (!ec && (m_options & mount_option::skip_pseudo) == mount_option::skip_pseudo)
+        {
+          ec = pseudo_filesystem_devices(m_pseudo);
+          std::sort(m_pseudo.begin(), m_pseudo.end());
+        }
+        return ec;
+      }
+
+      //  Returns: true if a directory on dev is to be descended into
+      bool allows(std::uint64_t dev) const
+      {
+        return ((m_options & mount_option::one_file_system) != mount_option::one_file_system
+            || dev == m_root)
+          && !std::binary_search(m_pseudo.begin(), m_pseudo.end(), dev);
+      }
+
+      //  Returns: true if the directory it is at is to be descended into. Always returns
+      //  false on error.
+      bool allows(const directory_iterator& it, std::error_code& ec) const
+      {
+        file_id key;
+        ec = directory_entry_key(it, key);
+        return !ec && allows(key.dev);
+      }
+
+      //  Returns: true if the directory p is to be descended into. Always returns false
+      //  on error.
+      bool allows(const path& p, std::error_code& ec) const
+      {
+        file_id key;
+        ec = path_key(p, key);
+        return !ec && allows(key.dev);
+      }
+
+    private:
+      mount_option                m_options;
+      std::uint64_t               m_root;
+      std::vector<std::uint64_t>  m_pseudo;  // sorted
+    };
+
     struct recur_dir_itr_imp
     {
       typedef directory_iterator element_type;
       std::stack< element_type, std::vector< element_type > > m_stack;
       int  m_level;
       symlink_option m_options;
+      recursion_options m_filter;      // m_filter.symlinks is unused; see m_options
+      entry_type_mask m_read_types;
+
+      //  leaf_option::nlink: for each directory in m_stack, the number of its
+      //  subdirectories not yet seen
+      std::vector<std::uintmax_t> m_subdirs_left;
+
+      //  open_limit: the levels of m_stack not yet detached, shallowest first; always
+      //  the deepest ones
+      std::deque<directory_iterator> m_open_levels;
 
-      recur_dir_itr_imp() : m_level(0), m_options(symlink_option::none) {}
+      //  symlink_option::skip_visited, if set in m_options when the root was opened
+      std::unique_ptr<visited_directories> m_visited;
+
+      //  m_filter.mounts, if not none
+      std::unique_ptr<device_filter> m_devices;
+
+      recur_dir_itr_imp()
+        : m_level(0), m_options(symlink_option::none),
+          m_read_types(entry_type_mask::all) {}
+
+      explicit recur_dir_itr_imp(const recursion_options& options)
+        : m_level(0), m_options(options.symlinks), m_filter(options),
+          m_read_types(traversal_read_types(options.types, options.symlinks)) {}
 
       void increment(std::error_code* ec);  // ec == 0 means throw on error
 
-      bool push_directory(std::error_code& ec) FILESYSTEM8_NOEXCEPT;
+      bool push_directory(std::error_code& ec);
+
+      void skip_excluded(std::error_code& ec);
+
+      void advance();
 
       void pop();
 
+      void push_level(const path& dir, const directory_iterator& it);
+
+      void pop_level();
+
+      void make_room(std::error_code& ec);
+
+      std::error_code visit_root(const path& root);
+
+      bool is_first_visit(const path& dir, const directory_iterator& it,
+        std::error_code& ec);
+
     };
 
     //  Implementation is inline to avoid dynamic linking difficulties with m_stack:
@@ -967,7 +1631,7 @@ namespace filesystem8
     //  clients of struct 'filesystem8::detail::recur_dir_itr_imp'
 
     inline
-    bool recur_dir_itr_imp::push_directory(std::error_code& ec) FILESYSTEM8_NOEXCEPT
+    bool recur_dir_itr_imp::push_directory(std::error_code& ec)
     // Returns: true if push occurs, otherwise false. Always returns false on error.
     {
       ec.clear();
@@ -978,39 +1642,27 @@ namespace filesystem8
       if ((m_options & symlink_option::_detail_no_push) == symlink_option::_detail_no_push)
         m_options &= ~symlink_option::_detail_no_push;
 
-      else
+      //  once all of a directory's subdirectories are seen, leaf_option::nlink
+      //  spares stat'ing the rest of its entries
+      else if (is_descent_allowed(*m_stack.top(), m_level, m_filter)
+        && (m_filter.leaf != leaf_option::nlink || m_subdirs_left.back() != 0)
+        && is_recursable_directory(*m_stack.top(), m_options, ec)
+        && (!m_devices || m_devices->allows(m_stack.top(), ec)))
       {
-        // Logic for following predicate was contributed by Daniel Aarno to handle cyclic
-        // symlinks correctly and efficiently, fixing ticket #5652.
-        //   if (((m_options & symlink_option::recurse) == symlink_option::recurse
-        //         || !is_symlink(m_stack.top()->symlink_status()))
-        //       && is_directory(m_stack.top()->status())) ...
-        // The predicate code has since been rewritten to pass error_code arguments,
-        // per ticket #5653.
-
-        file_status symlink_stat;
-
-        if ((m_options & symlink_option::recurse) != symlink_option::recurse)
+        if (m_filter.leaf == leaf_option::nlink)
+          --m_subdirs_left.back();
+        if (m_filter.open_limit != 0)
         {
-          symlink_stat = m_stack.top()->symlink_status(ec);
+          make_room(ec);
           if (ec)
             return false;
         }
-
-        if ((m_options & symlink_option::recurse) == symlink_option::recurse
-          || !is_symlink(symlink_stat))
+        directory_iterator next(m_stack.top()->path(), m_read_types, m_filter.order, ec);
+        if (!ec && next != directory_iterator()
+          && is_first_visit(m_stack.top()->path(), next, ec))
         {
-          file_status stat = m_stack.top()->status(ec);
-          if (ec || !is_directory(stat))
-            return false;
-
-          directory_iterator next(m_stack.top()->path(), ec);
-          if (!ec && next != directory_iterator())
-          {
-            m_stack.push(next);
-            ++m_level;
-            return true;
-          }
+          push_level(m_stack.top()->path(), next);
+          return true;
         }
       }
       return false;
@@ -1028,22 +1680,11 @@ namespace filesystem8
     {
       std::error_code ec_push_directory;
 
-      //  if various conditions are met, push a directory_iterator into the iterator stack
-      if (push_directory(ec_push_directory))
-      {
-        if (ec)
-          ec->clear();
-        return;
-      }
-
-      //  Do the actual increment operation on the top iterator in the iterator
-      //  stack, popping the stack if necessary, until either the stack is empty or a
-      //  non-end iterator is reached.
-      while (!m_stack.empty() && ++m_stack.top() == directory_iterator())
-      {
-        m_stack.pop();
-        --m_level;
-      }
+      //  if various conditions are met, push a directory_iterator into the iterator stack;
+      //  the first entry of a pushed directory is as subject to m_filter.types as any
+      if (!push_directory(ec_push_directory))
+        advance();
+      skip_excluded(ec_push_directory);
 
       // report errors if any
       if (ec_push_directory)
@@ -1061,6 +1702,101 @@ namespace filesystem8
         ec->clear();
     }
 
+    inline
+    void recur_dir_itr_imp::advance()
+    {
+      //  Do the actual increment operation on the top iterator in the iterator
+      //  stack, popping the stack if necessary, until either the stack is empty or a
+      //  non-end iterator is reached.
+      while (!m_stack.empty() && ++m_stack.top() == directory_iterator())
+        pop_level();
+    }
+
+    inline
+    void recur_dir_itr_imp::push_level(const path& dir, const directory_iterator& it)
+    {
+      m_stack.push(it);
+      ++m_level;
+      if (m_filter.leaf == leaf_option::nlink)
+        m_subdirs_left.push_back(subdirectory_count(dir, m_filter));
+      if (m_filter.open_limit != 0)
+        m_open_levels.push_back(it);
+    }
+
+    inline
+    void recur_dir_itr_imp::pop_level()
+    {
+      m_stack.pop();
+      --m_level;
+      if (m_filter.leaf == leaf_option::nlink)
+        m_subdirs_left.pop_back();
+      if (!m_open_levels.empty())  // the level popped was not detached
+        m_open_levels.pop_back();
+    }
+
+    inline
+    void recur_dir_itr_imp::make_room(std::error_code& ec)
+    // Detaches the shallowest open levels until one more fits within open_limit. They
+    // are detached even on error, which means some of their entries are lost.
+    {
+      while (m_open_levels.size() >= m_filter.open_limit)
+      {
+        std::error_code result = directory_iterator_detach(m_open_levels.front());
+        m_open_levels.pop_front();
+        if (result && !ec)
+          ec = result;
+      }
+    }
+
+    inline
+    std::error_code recur_dir_itr_imp::visit_root(const path& root)
+    // Returns: the error of finding out the root's device, or the pseudo filesystems,
+    // for m_filter.mounts; without them the mounts could not be told apart
+    {
+      if (m_filter.mounts != mount_option::none)
+      {
+        m_devices.reset(new device_filter(m_filter.mounts));
+        std::error_code ec = m_devices->start(m_stack.top(), root);
+        if (ec)
+          return ec;
+      }
+      if ((m_options & (symlink_option::recurse | symlink_option::skip_visited))
+        == (symlink_option::recurse | symlink_option::skip_visited))
+      {
+        m_visited.reset(new visited_directories(m_filter.visited_prefilter));
+        file_id key;
+        if (!directory_iterator_key(m_stack.top(), root, key))
+          m_visited->insert(key);
+      }
+      return std::error_code();
+    }
+
+    inline
+    bool recur_dir_itr_imp::is_first_visit(const path& dir, const directory_iterator& it,
+      std::error_code& ec)
+    {
+      if (!m_visited)
+        return true;
+      file_id key;
+      ec = directory_iterator_key(it, dir, key);
+      return !ec && m_visited->insert(key);
+    }
+
+    inline
+    void recur_dir_itr_imp::skip_excluded(std::error_code& ec)
+    // Moves past entries that m_filter.types excludes, still descending into those that
+    // are directories. ec keeps the first error; progress is made regardless.
+    {
+      while (!m_stack.empty() && !is_type_included(*m_stack.top(), m_filter.types))
+      {
+        std::error_code ec_push_directory;
+        if (!push_directory(ec_push_directory))
+          advance();
+        if (ec_push_directory && !ec)
+          ec = ec_push_directory;
+      }
+    }
+
     inline
     void recur_dir_itr_imp::pop()
     {
@@ -1069,10 +1805,15 @@ namespace filesystem8
 
       do
       {
-        m_stack.pop();
-        --m_level;
+        pop_level();
       }
       while (!m_stack.empty() && ++m_stack.top() == directory_iterator());
+
+      std::error_code ec;
+      skip_excluded(ec);
+      if (ec)
+        FILESYSTEM8_THROW(filesystem_error(
+          "filesystem::recursive_directory_iterator directory error", ec));
     }
   } // namespace detail
 
@@ -1099,6 +1840,8 @@ namespace filesystem8
       m_imp->m_stack.push(directory_iterator(dir_path));
       if (m_imp->m_stack.top() == directory_iterator())
         { m_imp.reset(); }
+      else
+        m_imp->visit_root(dir_path);
     }
 
     recursive_directory_iterator(const path& dir_path,
@@ -1109,6 +1852,8 @@ namespace filesystem8
       m_imp->m_stack.push(directory_iterator(dir_path));
       if (m_imp->m_stack.top() == directory_iterator())
         { m_imp.reset (); }
+      else
+        m_imp->visit_root(dir_path);
     }
 
     recursive_directory_iterator(const path& dir_path,
@@ -1120,6 +1865,8 @@ namespace filesystem8
       m_imp->m_stack.push(directory_iterator(dir_path, ec));
       if (m_imp->m_stack.top() == directory_iterator())
         { m_imp.reset (); }
+      else
+        m_imp->visit_root(dir_path);
     }
 
     recursive_directory_iterator(const path& dir_path,
@@ -1130,6 +1877,56 @@ namespace filesystem8
       m_imp->m_stack.push(directory_iterator(dir_path, ec));
       if (m_imp->m_stack.top() == directory_iterator())
         { m_imp.reset (); }
+      else
+        m_imp->visit_root(dir_path);
+    }
+
+    recursive_directory_iterator(const path& dir_path,
+      const recursion_options& options)  // throws if !exists()
+    : m_imp(new detail::recur_dir_itr_imp(options))
+    {
+      m_imp->m_stack.push(directory_iterator(dir_path, m_imp->m_read_types,
+        options.order));
+      if (m_imp->m_stack.top() == directory_iterator())
+        { m_imp.reset (); return; }
+      std::error_code ec = m_imp->visit_root(dir_path);
+      if (ec)
+      {
+        m_imp.reset();
+        FILESYSTEM8_THROW(filesystem_error(
+          "filesystem::recursive_directory_iterator directory error", dir_path, ec));
+      }
+      if (options.leaf == leaf_option::nlink)
+        m_imp->m_subdirs_left.push_back(detail::subdirectory_count(dir_path, options));
+      if (options.open_limit != 0)
+        m_imp->m_open_levels.push_back(m_imp->m_stack.top());
+      m_imp->skip_excluded(ec);
+      if (m_imp->m_stack.empty())
+        { m_imp.reset (); }
+      if (ec)
+        FILESYSTEM8_THROW(filesystem_error(
+          "filesystem::recursive_directory_iterator directory error", ec));
+    }
+
+    recursive_directory_iterator(const path& dir_path,
+      const recursion_options& options,
+      std::error_code & ec)
+    : m_imp(new detail::recur_dir_itr_imp(options))
+    {
+      m_imp->m_stack.push(directory_iterator(dir_path, m_imp->m_read_types,
+        options.order, ec));
+      if (m_imp->m_stack.top() == directory_iterator())
+        { m_imp.reset (); return; }
+      ec = m_imp->visit_root(dir_path);
+      if (ec)
+        { m_imp.reset (); return; }
+      if (options.leaf == leaf_option::nlink)
+        m_imp->m_subdirs_left.push_back(detail::subdirectory_count(dir_path, options));
+      if (options.open_limit != 0)
+        m_imp->m_open_levels.push_back(m_imp->m_stack.top());
+      m_imp->skip_excluded(ec);
+      if (m_imp->m_stack.empty())
+        { m_imp.reset (); }
     }
 
     recursive_directory_iterator& increment(std::error_code& ec) FILESYSTEM8_NOEXCEPT
@@ -0,0 +1,94 @@
+//  filesystem8/parallel_walk.hpp  -----------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_PARALLEL_WALK_HPP
+#define FILESYSTEM8_PARALLEL_WALK_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <cstddef>
+#include <functional>
+#include <system_error>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                  parallel_walk                                       //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  Visits every entry below root, like recursive_directory_iterator, but each directory
+//  is read by whichever thread of a work-stealing pool gets to it first, so subtrees are
+//  traversed concurrently.
+//
+//  The visitor is called concurrently from the pool's threads and in no particular
+//  order; it must be thread safe. It returns false to skip recursion into the entry, the
+//  equivalent of recursive_directory_iterator::disable_recursion_pending(). Its return
+//  value is ignored for entries that are not directories.
+//
+//  The recursion_options of walk_options are applied exactly as
+//  recursive_directory_iterator applies them; in particular, directory symlinks are
+//  followed under the same conditions. prune is called concurrently too. With
+//  symlink_option::skip_visited, of two paths to the same directory, neither below the
+//  other, the one descended into is whichever a thread opens first.
+//
+//  The first error stops the walk: directories not yet started are abandoned, the
+//  threads are joined, and the error is then thrown or reported via ec. An exception
+//  thrown by the visitor stops the walk the same way and is rethrown to the caller.
+//
+//  With walk_options::ordered, the directories are still read concurrently, but the
+//  visitor is called from the calling thread only, one entry at a time, in the order of
+//  a sequential walk that sorts each directory by filename: every directory is followed
+//  by the entries below it, and the paths visited ascend by path::compare. The entries
+//  of a directory read ahead of the visitor wait in a reorder buffer, so that output
+//  such as a manifest is the same from one run to the next. read_ahead bounds the
+//  number of directories read or being read ahead of the visitor; once it is reached,
+//  the directory a worker reads next is the first by path::compare of those waiting,
+//  and the visitor reads a directory itself if no worker has got to it. An entry for
+//  which the visitor returns false has the directory read ahead below it discarded.
+//
+//  In ordered mode the directory_order of walk_options is ignored, prune is still called
+//  concurrently and in no particular order, and an error is reported when the walk gets
+//  to it, after the entries visited before it in sequential order, rather than as soon
+//  as it is found; so the error, too, is the same from one run to the next.
+
+  typedef std::function<bool(const directory_entry&)> walk_visitor;
+
+  struct walk_options : recursion_options
+  {
+    unsigned     threads;     // 0 means std::thread::hardware_concurrency()
+    bool         ordered;     // visit in sorted sequential order, from the calling thread
+    std::size_t  read_ahead;  // ordered: directories read ahead at most; 0 means no limit
+
+    walk_options() : threads(0), ordered(false), read_ahead(0) {}
+  };
+
+  namespace detail
+  {
+    FILESYSTEM8_EXPORT
+    void parallel_walk(const path& root, const walk_visitor& visitor,
+      const walk_options& options, std::error_code* ec=0);
+  }
+
+  inline
+  void parallel_walk(const path& root, const walk_visitor& visitor,
+    const walk_options& options = walk_options())
+                                       {detail::parallel_walk(root, visitor, options);}
+  inline
+  void parallel_walk(const path& root, const walk_visitor& visitor,
+    std::error_code& ec)
+                                       {detail::parallel_walk(root, visitor, walk_options(), &ec);}
+  inline
+  void parallel_walk(const path& root, const walk_visitor& visitor,
+    const walk_options& options, std::error_code& ec)
+                                       {detail::parallel_walk(root, visitor, options, &ec);}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_PARALLEL_WALK_HPP
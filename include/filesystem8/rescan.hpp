@@ -0,0 +1,117 @@
+//  filesystem8/rescan.hpp  ------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_RESCAN_HPP
+#define FILESYSTEM8_RESCAN_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                  scan and rescan                                     //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  scan() records the metadata of every entry below a root directory. rescan() brings
+//  such a record up to date and reports what changed, reading only what it must:
+//
+//    - every directory is lstat'ed, but only a directory whose mtime or ctime differs
+//      from the previous scan is read, and only its entries are lstat'ed;
+//    - the entries of an unchanged directory are carried over, sharing memory with the
+//      previous result.
+//
+//  Adding, removing or renaming an entry changes its directory's mtime, so these are
+//  always found. The flip side is that a file whose contents or attributes change
+//  while its directory's entries do not is reported only once something else in that
+//  directory changes; scan() and compare where that matters.
+//
+//  A directory whose timestamps are within two seconds of the start of the scan that
+//  read it is read again by the next rescan regardless, as a later change within the
+//  same timestamp tick would not alter its mtime. So is a directory that could not be
+//  read; its previous entries are kept meanwhile. Directory symlinks are not followed.
+
+  struct scan_entry
+  {
+    file_type       type;      // of the entry itself
+    perms           permissions;
+    std::uintmax_t  size;      // regular files only, else 0
+    std::int64_t    mtime_ns;  // last data modification, nanoseconds since the epoch
+    std::int64_t    ctime_ns;  // last status change; equal to mtime_ns on Windows
+  };
+
+  struct scan_change
+  {
+    enum kind_type { added, removed, modified };
+
+    kind_type          kind;
+    filesystem8::path  relative_path;  // to the root
+  };
+
+  class FILESYSTEM8_EXPORT scan_result
+  {
+  public:
+    struct node;
+
+    scan_result() : m_size(0) {}  // empty
+
+    const path&        root() const FILESYSTEM8_NOEXCEPT { return m_root; }
+    std::size_t        size() const FILESYSTEM8_NOEXCEPT { return m_size; }  // below root
+    bool               empty() const FILESYSTEM8_NOEXCEPT { return !m_top; }
+
+    //  Returns: the entry at relative, a path relative to root, or 0 if there is none;
+    //  "." is the root itself
+    const scan_entry*  find(const path& relative) const;
+
+    //  Calls f(relative path, entry) for each entry below root, a directory before its
+    //  entries, which come sorted by filename
+    void               for_each(
+      const std::function<void(const path&, const scan_entry&)>& f) const;
+
+  private:
+    friend struct scan_result_access;
+
+    path                         m_root;
+    std::shared_ptr<const node>  m_top;   // immutable; rescans share unchanged subtrees
+    std::size_t                  m_size;
+  };
+
+  namespace detail
+  {
+    FILESYSTEM8_EXPORT
+    scan_result scan(const path& root, std::error_code* ec=0);
+    FILESYSTEM8_EXPORT
+    scan_result rescan(const scan_result& previous, std::vector<scan_change>* changes,
+      std::error_code* ec=0);
+  }
+
+  inline
+  scan_result scan(const path& root)   {return detail::scan(root);}
+  inline
+  scan_result scan(const path& root, std::error_code& ec)
+                                       {return detail::scan(root, &ec);}
+
+  //  Appends the changes since previous to changes, parents before their entries, and
+  //  returns the new result. previous must not be empty.
+  inline
+  scan_result rescan(const scan_result& previous, std::vector<scan_change>& changes)
+                                       {return detail::rescan(previous, &changes);}
+  inline
+  scan_result rescan(const scan_result& previous, std::vector<scan_change>& changes,
+    std::error_code& ec)               {return detail::rescan(previous, &changes, &ec);}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_RESCAN_HPP
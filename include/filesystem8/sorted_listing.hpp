@@ -0,0 +1,109 @@
+//  filesystem8/sorted_listing.hpp  ----------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_SORTED_LISTING_HPP
+#define FILESYSTEM8_SORTED_LISTING_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <cstddef>
+#include <memory>
+#include <system_error>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                            sorted_directory_iterator                                 //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  Visits the entries of a directory by filename, in path::compare order, holding no
+//  more than about memory_budget bytes of them in memory however large the directory.
+//
+//  The directory is read when the iterator is constructed. Entries are gathered until
+//  the budget is reached, then sorted and written out as a run to a spill file in
+//  temp_directory, and so on; the runs are then merged as the iterator is incremented.
+//  If there are more runs than the budget allows to be read at once, groups of them are
+//  first merged into longer runs. A directory that fits in the budget is sorted in
+//  memory; no file is written, and temp_directory_path() is not asked for. On POSIX the
+//  spill files are unlinked as soon as they are created, so nothing is left behind if
+//  the process dies.
+//
+//  Each entry keeps the type of its symlink_status(), which costs an lstat per entry only
+//  where reading the directory does not tell the type; other status is queried when
+//  asked for.
+
+  struct sorted_listing_options
+  {
+    std::size_t      memory_budget;   // bytes of entries held at once, roughly
+    entry_type_mask  types;           // entries of other types are skipped
+    path             temp_directory;  // for spill files; empty means temp_directory_path()
+
+    sorted_listing_options()
+      : memory_budget(64 * 1024 * 1024), types(entry_type_mask::all) {}
+  };
+
+  class FILESYSTEM8_EXPORT sorted_directory_iterator
+    : public iterator_facade<
+        sorted_directory_iterator,
+        directory_entry,
+        std::input_iterator_tag >
+  {
+  public:
+    sorted_directory_iterator() FILESYSTEM8_NOEXCEPT {}  // creates the "end" iterator
+
+    explicit sorted_directory_iterator(const path& dir_path,
+      const sorted_listing_options& options = sorted_listing_options())  // throws
+                                       { m_construct(dir_path, options, 0); }
+    sorted_directory_iterator(const path& dir_path, std::error_code& ec)
+                                       { m_construct(dir_path, sorted_listing_options(), &ec); }
+    sorted_directory_iterator(const path& dir_path,
+      const sorted_listing_options& options, std::error_code& ec)
+                                       { m_construct(dir_path, options, &ec); }
+
+    //  An error reading a spill file ends the iteration
+    sorted_directory_iterator& increment(std::error_code& ec)
+                                       { m_increment(&ec); return *this; }
+
+    //  Runs spilled to disk by the constructor; 0 if the directory was sorted in memory
+    std::size_t  runs() const FILESYSTEM8_NOEXCEPT;
+
+  private:
+    friend class iterator_facade<
+        sorted_directory_iterator,
+        directory_entry,
+        std::input_iterator_tag >;
+
+    struct imp;
+
+    // shared_ptr provides shallow-copy semantics required for InputIterators.
+    // m_imp.get()==0 indicates the end iterator.
+    std::shared_ptr<imp>  m_imp;
+
+    void       m_construct(const path& dir_path, const sorted_listing_options& options,
+                 std::error_code* ec);
+    void       m_increment(std::error_code* ec);
+
+    reference  dereference() const;
+    void       increment()             { m_increment(0); }
+    bool       equal(const sorted_directory_iterator& rhs) const
+                                       { return m_imp == rhs.m_imp; }
+  };
+
+  inline
+  const sorted_directory_iterator&
+    begin(const sorted_directory_iterator& iter) FILESYSTEM8_NOEXCEPT {return iter;}
+  inline
+  sorted_directory_iterator
+    end(const sorted_directory_iterator&) FILESYSTEM8_NOEXCEPT
+                                                  {return sorted_directory_iterator();}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_SORTED_LISTING_HPP
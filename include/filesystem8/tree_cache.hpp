@@ -0,0 +1,100 @@
+//  filesystem8/tree_cache.hpp  --------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_TREE_CACHE_HPP
+#define FILESYSTEM8_TREE_CACHE_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <ctime>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                    tree_cache                                        //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  An in-memory mirror of the directory tree below root: the name, type, permissions,
+//  size and last write time of every entry, read with directory_iterator when the
+//  cache is constructed. Queries for root and paths below it are answered from memory,
+//  without system calls.
+//
+//  On Linux the cache is live: a background thread applies inotify events as they
+//  arrive, so the mirror trails the filesystem by the time it takes to deliver an
+//  event. If the kernel's event queue overflows, the whole tree is read again. Elsewhere
+//  the cache is a snapshot, brought up to date by refresh().
+//
+//  Paths are matched lexically against root, so give them in the same form, e.g. both
+//  absolute. Paths not below root are answered from the filesystem, as is status() of a
+//  symlink, since the target of a symlink may lie outside the tree or change unseen.
+//  Directory symlinks are not followed.
+//
+//  All member functions may be called concurrently.
+
+  class FILESYSTEM8_EXPORT tree_cache
+  {
+  public:
+    explicit tree_cache(const path& root);
+    tree_cache(const path& root, std::error_code& ec);
+    ~tree_cache();
+
+    tree_cache(const tree_cache&) = delete;
+    tree_cache& operator=(const tree_cache&) = delete;
+
+    const path&     root() const FILESYSTEM8_NOEXCEPT;
+
+    //  Returns: true if inotify keeps the cache current
+    bool            is_live() const FILESYSTEM8_NOEXCEPT;
+
+    //  Reads the whole tree again
+    void            refresh()                           {m_refresh(0);}
+    void            refresh(std::error_code& ec)        {m_refresh(&ec);}
+
+    //  As the non-member functions of the same names
+    file_status     status(const path& p) const         {return m_status(p, false, 0);}
+    file_status     status(const path& p, std::error_code& ec) const
+                                                        {return m_status(p, false, &ec);}
+    file_status     symlink_status(const path& p) const {return m_status(p, true, 0);}
+    file_status     symlink_status(const path& p, std::error_code& ec) const
+                                                        {return m_status(p, true, &ec);}
+    bool            exists(const path& p) const
+                                         {return filesystem8::exists(m_status(p, false, 0));}
+    bool            exists(const path& p, std::error_code& ec) const
+                                         {return filesystem8::exists(m_status(p, false, &ec));}
+    std::uintmax_t  file_size(const path& p) const      {return m_file_size(p, 0);}
+    std::uintmax_t  file_size(const path& p, std::error_code& ec) const
+                                                        {return m_file_size(p, &ec);}
+    std::time_t     last_write_time(const path& p) const {return m_last_write_time(p, 0);}
+    std::time_t     last_write_time(const path& p, std::error_code& ec) const
+                                                        {return m_last_write_time(p, &ec);}
+
+    //  Returns: the entries directory_iterator(dir) would visit, sorted by filename, with
+    //  their status and symlink_status already known
+    std::vector<directory_entry> list(const path& dir) const {return m_list(dir, 0);}
+    std::vector<directory_entry> list(const path& dir, std::error_code& ec) const
+                                                        {return m_list(dir, &ec);}
+
+  private:
+    struct imp;
+    std::unique_ptr<imp>  m_imp;
+
+    void            m_refresh(std::error_code* ec);
+    file_status     m_status(const path& p, bool symlink, std::error_code* ec) const;
+    std::uintmax_t  m_file_size(const path& p, std::error_code* ec) const;
+    std::time_t     m_last_write_time(const path& p, std::error_code* ec) const;
+    std::vector<directory_entry> m_list(const path& dir, std::error_code* ec) const;
+  };
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_TREE_CACHE_HPP
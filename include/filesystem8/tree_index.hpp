@@ -0,0 +1,115 @@
+//  filesystem8/tree_index.hpp  --------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#ifndef FILESYSTEM8_TREE_INDEX_HPP
+#define FILESYSTEM8_TREE_INDEX_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <cstdint>
+#include <memory>
+#include <system_error>
+#include <utility>
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                    tree_index                                        //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+//  A tree_index file records the tree below a root directory so that it can be queried
+//  straight from a memory mapping, without reading or parsing it first:
+//
+//    header          magic, version, byte order, entry count, string table size, and
+//                    when the walk began
+//    entries         fixed-size tree_index_entry records; entry 0 is the root, and the
+//                    entries of each directory are adjacent and sorted by filename,
+//                    so a lookup is a binary search per path element
+//    string table    the filenames, and the root path, without terminators
+//
+//  The file is in the byte order of the machine that wrote it, and is rejected by a
+//  machine of the other byte order. write_tree_index() writes to a temporary file next
+//  to the index and renames it into place, so a reader never sees a partial index.
+
+  struct tree_index_entry  // read in place from the mapping
+  {
+    std::uint32_t  parent;        // entry number; 0 for the root itself
+    std::uint32_t  first_child;   // entry number of the first entry of a directory
+    std::uint32_t  child_count;
+    std::uint32_t  name_size;     // in path::value_type units
+    std::uint64_t  name_offset;   // into the string table, in path::value_type units
+    std::uint64_t  size;          // regular files only, else 0
+    std::int64_t   mtime_ns;      // last write time, nanoseconds since the epoch
+    std::uint16_t  mode;          // perms
+    std::uint8_t   kind;          // file_type
+    std::uint8_t   reserved[5];
+
+    file_type  type() const FILESYSTEM8_NOEXCEPT { return static_cast<file_type>(kind); }
+    perms      permissions() const FILESYSTEM8_NOEXCEPT
+                                                { return static_cast<perms>(mode); }
+  };
+
+  class FILESYSTEM8_EXPORT tree_index
+  {
+  public:
+    typedef std::pair<const tree_index_entry*, const tree_index_entry*> range;
+
+    //  Maps index_file, which must have been written by write_tree_index()
+    explicit tree_index(const path& index_file);
+    tree_index(const path& index_file, std::error_code& ec);
+    ~tree_index();
+
+    tree_index(const tree_index&) = delete;
+    tree_index& operator=(const tree_index&) = delete;
+
+    //  The directory the index was written for
+    const path&              root() const FILESYSTEM8_NOEXCEPT;
+    std::size_t              size() const FILESYSTEM8_NOEXCEPT;  // entries below root
+
+    //  When write_tree_index() began to walk root; a directory written to within the
+    //  same timestamp tick may have changed without its recorded mtime showing it
+    file_time_type           walk_start() const FILESYSTEM8_NOEXCEPT;
+
+    //  Returns: the entry at relative, a path relative to root, or 0 if there is none;
+    //  "." is the root itself
+    const tree_index_entry*  find(const path& relative) const;
+
+    //  Returns: the entries of directory e, sorted by filename; empty for other types
+    range                    list(const tree_index_entry& e) const FILESYSTEM8_NOEXCEPT;
+
+    path                     filename(const tree_index_entry& e) const;  // empty for root
+    path                     relative_path(const tree_index_entry& e) const;  // ditto
+
+  private:
+    struct imp;
+    std::unique_ptr<imp>  m_imp;
+
+    void m_open(const path& index_file, std::error_code* ec);
+  };
+
+  namespace detail
+  {
+    FILESYSTEM8_EXPORT
+    void write_tree_index(const path& root, const path& index_file,
+      std::error_code* ec=0);
+  }
+
+  //  Walks root with recursive_directory_iterator, not following directory symlinks,
+  //  and writes the index of what it finds to index_file
+  inline
+  void write_tree_index(const path& root, const path& index_file)
+                                       {detail::write_tree_index(root, index_file);}
+  inline
+  void write_tree_index(const path& root, const path& index_file, std::error_code& ec)
+                                       {detail::write_tree_index(root, index_file, &ec);}
+
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_TREE_INDEX_HPP
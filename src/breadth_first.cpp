@@ -0,0 +1,255 @@
+//  breadth_first.cpp  -----------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/breadth_first.hpp>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::directory_entry;
+using fs::directory_iterator;
+using fs::queued_directory;
+using fs::filesystem_error;
+using std::error_code;
+
+namespace filesystem8
+{
+  struct breadth_first_directory_iterator::imp
+  {
+    struct level
+    {
+      directory_iterator  it;
+      int                 depth;         // of the entries of it
+      std::uintmax_t      subdirs_left;  // see recursion_options::leaf
+    };
+
+    frontier_options  options;
+    entry_type_mask   read_types;
+    bool              pending;  // recursion into the current entry
+
+    //  symlink_option::skip_visited
+    std::unique_ptr<detail::visited_directories>  visited;
+
+    //  options.mounts, if not none; set once the root is open
+    std::unique_ptr<detail::device_filter>  devices;
+
+    //  The queued directories: first in, first out, or a heap ordered by options.before
+    std::deque<queued_directory>  frontier;
+
+    //  The directory being read, and those being read depth first below it; the current
+    //  entry is that of the last one
+    std::vector<level>  stack;
+
+    explicit imp(const frontier_options& o)
+      : options(o), read_types(detail::traversal_read_types(o.types, o.symlinks)),
+        pending(true)
+    {
+      if ((o.symlinks & (symlink_option::recurse | symlink_option::skip_visited))
+        == (symlink_option::recurse | symlink_option::skip_visited))
+        visited.reset(new detail::visited_directories(o.visited_prefilter));
+    }
+
+    //  The heap puts the directory to read next first; before() says which that is
+    bool after(const queued_directory& lhs, const queued_directory& rhs) const
+      { return options.before(rhs, lhs); }
+
+    bool open(const path& dir, int depth, error_code& result)
+    {
+      error_code ec;
+      directory_iterator it(dir, read_types, options.order, ec);
+      if (ec && !result)
+        result = ec;
+      if (it == directory_iterator())
+        return false;
+      if (depth == 0 && options.mounts != mount_option::none)
+      {
+        devices.reset(new detail::device_filter(options.mounts));
+        ec = devices->start(it, dir);
+        if (ec)
+        {
+          if (!result)
+            result = ec;
+          return false;
+        }
+      }
+      if (visited)
+      {
+        file_id key;
+        ec = detail::directory_iterator_key(it, dir, key);
+        if (ec && !result)
+          result = ec;
+        if (ec || !visited->insert(key))
+          return false;
+      }
+      level l = {it, depth, detail::subdirectory_count(dir, options)};
+      stack.push_back(l);
+      return true;
+    }
+
+    //  Queues the current entry, or reads it right away if the frontier is full.
+    //  Returns: true if it was read right away and is not empty, so that the current
+    //  entry is now its first one
+    bool descend(error_code& result)
+    {
+      level& top = stack.back();
+      const directory_entry& e = *top.it;
+      if (top.subdirs_left == 0  // leaf_option::nlink: the rest are not directories
+        || !detail::is_descent_allowed(e, top.depth, options))
+        return false;
+      error_code ec;
+      if (!detail::is_recursable_directory(e, options.symlinks, ec)
+        || (devices && !devices->allows(top.it, ec)))
+      {
+        if (ec && !result)
+          result = ec;
+        return false;
+      }
+      if (top.subdirs_left != static_cast<std::uintmax_t>(-1))
+        --top.subdirs_left;
+
+      if (options.max_frontier != 0 && frontier.size() >= options.max_frontier)
+        return open(e.path(), top.depth + 1, result);
+
+      queued_directory q = {e.path(), top.depth + 1};
+      frontier.push_back(q);
+      if (options.before)
+        std::push_heap(frontier.begin(), frontier.end(),
+          [this](const queued_directory& lhs, const queued_directory& rhs)
+            { return after(lhs, rhs); });
+      return false;
+    }
+
+    //  Moves past the current entry, to the next one in the stack, or else to the first
+    //  one of the next queued directory that is not empty.
+    //  Returns: false if there is none
+    bool next(error_code& result)
+    {
+      while (!stack.empty())
+      {
+        error_code ec;
+        stack.back().it.increment(ec);
+        if (ec && !result)
+          result = ec;
+        if (stack.back().it != directory_iterator())
+          return true;
+        stack.pop_back();  // and move the one it was found in past it
+      }
+
+      while (!frontier.empty())
+      {
+        if (options.before)
+          std::pop_heap(frontier.begin(), frontier.end(),
+            [this](const queued_directory& lhs, const queued_directory& rhs)
+              { return after(lhs, rhs); });
+        queued_directory q(options.before ? frontier.back() : frontier.front());
+        if (options.before)
+          frontier.pop_back();
+        else
+          frontier.pop_front();
+        if (open(q.dir, q.depth, result))
+          return true;
+      }
+      return false;
+    }
+
+    //  Moves to the next entry of the wanted types, first descending into the current
+    //  one if descend. Progress is made regardless of errors; result keeps the first.
+    void increment(bool descend, error_code& result)
+    {
+      for (;;)
+      {
+        if (!(descend && this->descend(result)) && !next(result))
+          return;
+        if (detail::is_type_included(*stack.back().it, options.types))
+          return;
+        descend = true;
+      }
+    }
+  };
+
+  void breadth_first_directory_iterator::m_construct(const path& dir_path,
+    const frontier_options& options, std::error_code* ec)
+  {
+    m_imp.reset(new imp(options));
+    error_code result;
+    if (m_imp->open(dir_path, 0, result)
+      && !detail::is_type_included(*m_imp->stack.back().it, options.types))
+      m_imp->increment(true, result);
+    if (m_imp->stack.empty())
+      m_imp.reset();
+
+    if (result)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error(
+          "filesystem8::breadth_first_directory_iterator", dir_path, result));
+      *ec = result;
+    }
+    else if (ec != 0)
+      ec->clear();
+  }
+
+  void breadth_first_directory_iterator::m_increment(std::error_code* ec)
+  {
+    FILESYSTEM8_ASSERT_MSG(m_imp.get(),
+      "increment of end breadth_first_directory_iterator");
+
+    error_code result;
+    bool descend = m_imp->pending;
+    m_imp->pending = true;
+    m_imp->increment(descend, result);
+    if (m_imp->stack.empty())
+      m_imp.reset();  // done, so make end iterator
+
+    if (result)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error(
+          "filesystem8::breadth_first_directory_iterator directory error", result));
+      *ec = result;
+    }
+    else if (ec != 0)
+      ec->clear();
+  }
+
+  int breadth_first_directory_iterator::depth() const FILESYSTEM8_NOEXCEPT
+  {
+    FILESYSTEM8_ASSERT_MSG(m_imp.get(), "depth() on end breadth_first_directory_iterator");
+    return m_imp->stack.back().depth;
+  }
+
+  std::size_t breadth_first_directory_iterator::frontier_size() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp ? m_imp->frontier.size() : 0;
+  }
+
+  bool breadth_first_directory_iterator::recursion_pending() const FILESYSTEM8_NOEXCEPT
+  {
+    FILESYSTEM8_ASSERT_MSG(m_imp.get(),
+      "recursion_pending() on end breadth_first_directory_iterator");
+    return m_imp->pending;
+  }
+
+  void breadth_first_directory_iterator::disable_recursion_pending(bool value)
+    FILESYSTEM8_NOEXCEPT
+  {
+    FILESYSTEM8_ASSERT_MSG(m_imp.get(),
+      "disable_recursion_pending() on end breadth_first_directory_iterator");
+    m_imp->pending = !value;
+  }
+
+  breadth_first_directory_iterator::reference
+    breadth_first_directory_iterator::dereference() const
+  {
+    FILESYSTEM8_ASSERT_MSG(m_imp.get(),
+      "dereference of end breadth_first_directory_iterator");
+    return *m_imp->stack.back().it;
+  }
+}  // namespace filesystem8
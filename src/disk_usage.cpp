@@ -0,0 +1,280 @@
+//  disk_usage.cpp  --------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/disk_usage.hpp>
+#include <cerrno>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::usage_totals;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+
+namespace
+{
+  const std::size_t shard_count = 32;  // a power of two
+
+  //  What one lstat tells about an entry, or, for a symlink followed, a stat of its target
+  struct entry_usage
+  {
+    bool           directory;
+    bool           regular;
+    bool           shared;  // may be reached by another path; dedupe by id
+    fs::file_id    id;
+    usage_totals   totals;  // of the entry alone
+  };
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  int read_usage(const path& p, bool following, entry_usage& u)
+  {
+    struct stat st;
+    if (::lstat(p.c_str(), &st) != 0)
+      return errno;
+
+    // a symlink followed counts as its target, which may be reached by its own path too;
+    // a dangling one counts as itself
+    bool via_symlink = false;
+    struct stat target;
+    if (following && S_ISLNK(st.st_mode) && ::stat(p.c_str(), &target) == 0)
+    {
+      st = target;
+      via_symlink = true;
+    }
+
+    u.directory = S_ISDIR(st.st_mode);
+    u.regular = S_ISREG(st.st_mode);
+    u.shared = u.directory ? following : via_symlink || st.st_nlink > 1;
+    u.id = fs::file_id(static_cast<std::uint64_t>(st.st_dev),
+      static_cast<std::uint64_t>(st.st_ino));
+    (u.directory ? u.totals.directories : u.totals.files) = 1;
+    u.totals.apparent_size = static_cast<std::uintmax_t>(st.st_size);
+    u.totals.allocated = static_cast<std::uintmax_t>(st.st_blocks) * 512;
+    return 0;
+  }
+
+# else
+
+  int read_usage(const path& p, bool, entry_usage& u)
+  {
+    error_code ec;
+    fs::file_status st = fs::detail::symlink_status(p, &ec);
+    if (ec)
+      return ec.value();
+    u.directory = fs::is_directory(st);
+    u.regular = fs::is_regular_file(st);
+    u.shared = false;
+    u.id = fs::file_id();
+    (u.directory ? u.totals.directories : u.totals.files) = 1;
+    u.totals.apparent_size = u.regular ? fs::detail::file_size(p, &ec) : 0;
+    u.totals.allocated = u.totals.apparent_size;
+    return ec.value();
+  }
+
+# endif
+
+  std::size_t size_class(std::uintmax_t size)
+  {
+    std::size_t k = 0;
+    for (; size != 0; size >>= 1)
+      ++k;
+    return k;
+  }
+
+  typedef std::unordered_map<path::string_type, usage_totals> totals_map;
+
+  //  The visitor runs on every thread of the walk; each shard, chosen by the hash of
+  //  what is updated, has its own mutex so that threads rarely wait for one another
+  struct usage_shard
+  {
+    std::mutex  mutex;
+    totals_map  directories;  // own entries only, by directory; rolled up at the end
+    totals_map  extensions;
+    std::vector<usage_totals>  size_classes;
+    usage_totals  total;
+  };
+
+  struct seen_shard
+  {
+    std::mutex  mutex;
+    std::unordered_set<fs::file_id, fs::file_id_hash>  ids;
+  };
+
+  struct usage_state
+  {
+    const fs::disk_usage_options&  options;
+    usage_shard  shards[shard_count];
+    seen_shard   seen[shard_count];
+
+    explicit usage_state(const fs::disk_usage_options& o) : options(o) {}
+
+    //  Returns: true if u is seen for the first time
+    bool first_sight(const entry_usage& u)
+    {
+      if (!u.shared)
+        return true;
+      seen_shard& s = seen[fs::file_id_hash()(u.id) & (shard_count - 1)];
+      std::lock_guard<std::mutex> lk(s.mutex);
+      return s.ids.insert(u.id).second;
+    }
+
+    //  dir is p itself if p is a directory, as its totals include itself
+    void add(const path& p, const path::string_type& dir, const entry_usage& u)
+    {
+      path::string_type ext;
+      if (!u.directory)
+        ext = p.extension().native();
+      usage_shard& s = shards[std::hash<path::string_type>()(
+        options.per_directory ? dir : ext) & (shard_count - 1)];
+
+      std::lock_guard<std::mutex> lk(s.mutex);
+      s.total += u.totals;
+      if (options.per_directory)
+        s.directories[dir] += u.totals;
+      if (u.directory)
+        return;
+      s.extensions[ext] += u.totals;
+      if (u.regular)
+      {
+        std::size_t k = size_class(u.totals.apparent_size);
+        if (s.size_classes.size() <= k)
+          s.size_classes.resize(k + 1);
+        s.size_classes[k] += u.totals;
+      }
+    }
+  };
+
+  std::size_t component_count(const path& p)
+  {
+    std::size_t n = 0;
+    for (path::iterator it = p.begin(); it != p.end(); ++it)
+      ++n;
+    return n;
+  }
+
+  //  Adds each directory's own totals into those of all directories above it
+  void roll_up(const path& root, std::vector<totals_map>& own,
+    std::map<path, usage_totals>& result)
+  {
+    // by depth below root, so that a directory is complete before it is added upwards
+    const std::size_t root_depth = component_count(root / "x") - 1;
+    std::vector<std::map<path, usage_totals> > by_depth(1);
+    for (std::size_t i = 0; i < own.size(); ++i)
+    {
+      for (totals_map::const_iterator it = own[i].begin(); it != own[i].end(); ++it)
+      {
+        path dir(it->first);
+        std::size_t depth = it->first == root.native()  // counts towards itself
+          ? 0 : component_count(dir) - root_depth;
+        if (by_depth.size() <= depth)
+          by_depth.resize(depth + 1);
+        by_depth[depth][depth == 0 ? root : dir] += it->second;
+      }
+      totals_map().swap(own[i]);
+    }
+
+    for (std::size_t depth = by_depth.size() - 1; depth != 0; --depth)
+    {
+      for (std::map<path, usage_totals>::const_iterator it = by_depth[depth].begin();
+        it != by_depth[depth].end(); ++it)
+        by_depth[depth - 1][depth == 1 ? root : it->first.parent_path()] += it->second;
+    }
+    for (std::size_t depth = 0; depth != by_depth.size(); ++depth)
+      result.insert(by_depth[depth].begin(), by_depth[depth].end());
+  }
+}  // unnamed namespace
+
+namespace filesystem8
+{
+namespace detail
+{
+  FILESYSTEM8_EXPORT
+  disk_usage_info disk_usage(const path& root, const disk_usage_options& options,
+    std::error_code* ec)
+  {
+    disk_usage_info info;
+    const bool following
+      = (options.symlinks & symlink_option::recurse) == symlink_option::recurse;
+
+    entry_usage root_usage;
+    int errnum = read_usage(root, following, root_usage);
+    if (errnum != 0)
+    {
+      error_code root_ec(errnum, system_category());
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error("filesystem8::disk_usage", root, root_ec));
+      *ec = root_ec;
+      return info;
+    }
+
+    usage_state s(options);
+    s.first_sight(root_usage);
+    if (root_usage.directory)
+    {
+      // a directory reached again is neither counted nor descended into; the walk's own
+      // visited set covers directories the visitor is not called for, by options.types
+      walk_options walk(options);
+      if (following)
+        walk.symlinks |= symlink_option::skip_visited;
+
+      error_code walk_ec;
+      detail::parallel_walk(root,
+        [&s, following](const directory_entry& e) -> bool
+        {
+          entry_usage u;
+          if (read_usage(e.path(), following, u) != 0)
+            return true;  // removed meanwhile
+          if (!s.first_sight(u))
+            return false;
+          s.add(e.path(), u.directory ? e.path().native()
+            : e.path().parent_path().native(), u);
+          return true;
+        },
+        walk, ec != 0 ? &walk_ec : 0);
+      if (walk_ec)
+      {
+        *ec = walk_ec;
+        return info;
+      }
+    }
+    s.add(root, root.native(), root_usage);
+
+    std::vector<totals_map> own;
+    for (std::size_t i = 0; i < shard_count; ++i)
+    {
+      usage_shard& shard = s.shards[i];
+      info.total += shard.total;
+      for (totals_map::const_iterator it = shard.extensions.begin();
+        it != shard.extensions.end(); ++it)
+        info.extensions[it->first] += it->second;
+      if (info.size_classes.size() < shard.size_classes.size())
+        info.size_classes.resize(shard.size_classes.size());
+      for (std::size_t k = 0; k != shard.size_classes.size(); ++k)
+        info.size_classes[k] += shard.size_classes[k];
+      own.push_back(totals_map());
+      own.back().swap(shard.directories);
+    }
+
+    if (options.per_directory)
+      roll_up(root, own, info.directories);
+    if (ec != 0)
+      ec->clear();
+    return info;
+  }
+}  // namespace detail
+}  // namespace filesystem8
@@ -0,0 +1,354 @@
+//  existence_filter.cpp  --------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/existence_filter.hpp>
+#include <filesystem8/file_info.hpp>
+#include "helpers.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef FILESYSTEM8_WINDOWS_API
+#   include <windows.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_type;
+using fs::file_info;
+using fs::file_info_fields;
+using fs::query_option;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+using fs::detail::racy_window_ns;
+
+namespace
+{
+  typedef path::string_type string_type;
+
+  const std::uint64_t root_hash = 0x6a09e667f3bcc908ULL;
+
+  //  The hash of a path relative to the root, from that of its parent and its filename
+  std::uint64_t child_hash(std::uint64_t parent, const string_type& name)
+  {
+    return fs::detail::hash_mix(fs::detail::hash_mix(parent)
+      ^ static_cast<std::uint64_t>(std::hash<string_type>()(name)));
+  }
+
+  std::int64_t nanoseconds_since(std::chrono::steady_clock::time_point t)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      t.time_since_epoch()).count();
+  }
+
+  bool is_dot(const path& element)
+  {
+    return element.native().size() == 1 && element.native()[0] == '.';
+  }
+
+  bool is_dot_dot(const path& element)
+  {
+    return element.native().size() == 2 && element.native()[0] == '.'
+      && element.native()[1] == '.';
+  }
+
+  void skip_dots(path::iterator& it, const path::iterator& end)
+  {
+    while (it != end && is_dot(*it))
+      ++it;
+  }
+
+  struct directory_record
+  {
+    std::uint64_t  hash;
+    std::int64_t   mtime_ns;
+  };
+}
+
+namespace filesystem8
+{
+  struct existence_filter::imp
+  {
+    struct directory
+    {
+      std::int64_t               mtime_ns;
+      bool                       racy;     // never trusted
+      std::atomic<std::int64_t>  checked;  // steady clock ns of the last look; 0 if none
+      std::atomic<bool>          changed;
+
+      directory() : mtime_ns(0), racy(false), checked(0), changed(false) {}
+    };
+
+    path                      root;
+    existence_filter_options  options;
+    std::size_t               size;
+    detail::bloom_filter      filter;
+    std::unordered_map<std::uint64_t, std::size_t>  directory_index;  // by hash
+    std::unique_ptr<directory[]>  directories;
+    mutable std::atomic<bool> stale;
+
+    imp(const path& r, const existence_filter_options& o)
+      : root(r), options(o), size(0), stale(false) {}
+
+    //  Sizes the filter for the entries found and fills it in
+    void finish(const std::vector<std::uint64_t>& hashes,
+      const std::vector<directory_record>& dirs, std::int64_t walk_start_ns)
+    {
+      size = hashes.size();
+
+      //  m = -n ln p / (ln 2)^2 bits, and k = m/n ln 2 probes
+      double p = options.false_positive_rate;
+      if (!(p > 0.0))
+        p = 1e-9;
+      if (p > 0.5)
+        p = 0.5;
+      const double ln2 = std::log(2.0);
+      double n = static_cast<double>(size == 0 ? 1 : size);
+      double m = -n * std::log(p) / (ln2 * ln2);
+      unsigned k = static_cast<unsigned>(m / n * ln2 + 0.5);
+      filter = detail::bloom_filter(static_cast<std::size_t>(m) + 1, k < 1 ? 1 : k);
+      for (std::size_t i = 0; i != hashes.size(); ++i)
+        filter.insert(hashes[i]);
+
+      directories.reset(new directory[dirs.size()]);
+      directory_index.reserve(dirs.size());
+      for (std::size_t i = 0; i != dirs.size(); ++i)
+      {
+        directories[i].mtime_ns = dirs[i].mtime_ns;
+        directories[i].racy = dirs[i].mtime_ns > walk_start_ns - racy_window_ns;
+        directory_index.emplace(dirs[i].hash, i);
+      }
+    }
+
+    //  Returns: true if directory d, at dir_path, has not changed since the build, as
+    //  far as a look at most options.recheck ago tells
+    bool trusted(directory& d, const path& dir_path) const
+    {
+      if (d.racy || d.changed.load(std::memory_order_relaxed))
+        return false;
+      std::int64_t now = nanoseconds_since(std::chrono::steady_clock::now());
+      std::int64_t checked = d.checked.load(std::memory_order_relaxed);
+      if (checked != 0 && now - checked < std::chrono::duration_cast<
+          std::chrono::nanoseconds>(options.recheck).count())
+        return true;
+
+      error_code ec;
+      file_info info(detail::query(dir_path, file_info_fields::type
+        | file_info_fields::mtime, query_option::none, &ec));
+      if (ec || info.type != file_type::directory || info.mtime_ns != d.mtime_ns)
+      {
+        d.changed.store(true, std::memory_order_relaxed);
+        stale.store(true, std::memory_order_relaxed);
+        return false;
+      }
+      d.checked.store(now, std::memory_order_relaxed);
+      return true;
+    }
+
+    bool may_exist(const path& p) const
+    {
+      path::iterator pi = p.begin(), pe = p.end();
+      path::iterator ri = root.begin(), re = root.end();
+      skip_dots(pi, pe);
+      skip_dots(ri, re);
+      while (ri != re)
+      {
+        if (pi == pe || *pi != *ri)
+          return true;  // not below root
+        ++pi;
+        ++ri;
+        skip_dots(pi, pe);
+        skip_dots(ri, re);
+      }
+
+      //  the hash of p, and the nearest directory above it that was in the tree
+      const path::iterator relative = pi;
+      std::uint64_t h = root_hash;
+      directory* nearest = 0;
+      std::size_t nearest_depth = 0, depth = 0;
+      bool through_entry = false;  // below nearest, through an entry of the tree
+      for (; pi != pe; skip_dots(pi, pe))
+      {
+        if (is_dot_dot(*pi))
+          return true;
+        std::unordered_map<std::uint64_t, std::size_t>::const_iterator
+          it = directory_index.find(h);
+        if (it != directory_index.end())
+        {
+          nearest = &directories[it->second];
+          nearest_depth = depth;
+          through_entry = false;
+        }
+        else if (depth != 0 && filter.may_contain(h))
+          through_entry = true;
+        h = child_hash(h, pi->native());
+        ++pi;
+        ++depth;
+      }
+
+      //  an entry that is not a directory, but that p goes through, is a symlink the
+      //  walk did not follow; what it leads to is not known, nor whether it changed
+      if (through_entry || filter.may_contain(h) || nearest == 0)
+        return true;
+
+      path dir_path(root);
+      pi = relative;
+      for (std::size_t i = 0; i != nearest_depth; skip_dots(pi, pe), ++i)
+        dir_path /= *pi++;
+      return !trusted(*nearest, dir_path);
+    }
+  };
+
+  void existence_filter::m_build(const path& root, const existence_filter_options& options,
+    error_code* ec)
+  {
+    const char* const message = "filesystem8::existence_filter";
+    std::unique_ptr<imp> result(new imp(root, options));
+    std::vector<std::uint64_t> hashes(1, root_hash);
+    std::vector<directory_record> dirs;
+    const std::int64_t walk_start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+
+    const file_info_fields fields = file_info_fields::type | file_info_fields::mtime;
+    error_code walk_ec;
+    file_info info(detail::query(root, fields, query_option::none, &walk_ec));
+    if (!walk_ec && info.type == file_type::directory)
+    {
+      directory_record d = { root_hash, info.mtime_ns };
+      dirs.push_back(d);
+
+      //  the write time of each directory is read before the directory is, so that
+      //  an entry added while it is being read changes it
+      std::vector<std::uint64_t> parents(1, root_hash);  // the directory at each depth
+      for (recursive_directory_iterator it(root, walk_ec), end;
+        !walk_ec && it != end; it.increment(walk_ec))
+      {
+        parents.resize(it.level() + 1);
+        std::uint64_t h = child_hash(parents.back(), it->filename().native());
+        hashes.push_back(h);
+        if (it->symlink_status().type() != file_type::directory)
+          continue;
+        error_code entry_ec;
+        info = detail::query(it->path(), fields, query_option::no_follow, &entry_ec);
+        if (entry_ec || info.type != file_type::directory)
+          continue;  // replaced meanwhile; nothing below it is trusted
+        d.hash = h;
+        d.mtime_ns = info.mtime_ns;
+        dirs.push_back(d);
+        parents.push_back(h);
+      }
+    }
+    if (walk_ec)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error(message, root, walk_ec));
+      *ec = walk_ec;
+      m_imp.reset(new imp(root, options));  // covers nothing
+      return;
+    }
+    if (ec != 0)
+      ec->clear();
+
+    result->finish(hashes, dirs, walk_start_ns);
+    m_imp = std::move(result);
+  }
+
+  existence_filter::existence_filter(const path& root,
+    const existence_filter_options& options)
+  {
+    m_build(root, options, 0);
+  }
+
+  existence_filter::existence_filter(const path& root,
+    const existence_filter_options& options, error_code& ec)
+  {
+    m_build(root, options, &ec);
+  }
+
+  existence_filter::existence_filter(const tree_index& index,
+    const existence_filter_options& options)
+    : m_imp(new imp(index.root(), options))
+  {
+    std::vector<std::uint64_t> hashes(1, root_hash);
+    std::vector<directory_record> dirs;
+    const tree_index_entry* top = index.find(".");
+    if (top != 0 && top->type() == file_type::directory)
+    {
+      directory_record d = { root_hash, top->mtime_ns };
+      dirs.push_back(d);
+      std::vector<std::pair<const tree_index_entry*, std::uint64_t> > pending;
+      pending.push_back(std::make_pair(top, root_hash));
+      while (!pending.empty())
+      {
+        std::pair<const tree_index_entry*, std::uint64_t> dir = pending.back();
+        pending.pop_back();
+        tree_index::range r(index.list(*dir.first));
+        for (const tree_index_entry* e = r.first; e != r.second; ++e)
+        {
+          std::uint64_t h = child_hash(dir.second, index.filename(*e).native());
+          hashes.push_back(h);
+          if (e->type() != file_type::directory)
+            continue;
+          d.hash = h;
+          d.mtime_ns = e->mtime_ns;
+          dirs.push_back(d);
+          pending.push_back(std::make_pair(e, h));
+        }
+      }
+    }
+    //  its directories were read after the index's walk began, as a walk's are here
+    m_imp->finish(hashes, dirs, index.walk_start().time_since_epoch().count());
+  }
+
+  existence_filter::~existence_filter() {}
+
+  const path& existence_filter::root() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->root;
+  }
+
+  std::size_t existence_filter::size() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->size;
+  }
+
+  bool existence_filter::stale() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->stale.load(std::memory_order_relaxed);
+  }
+
+  bool existence_filter::may_exist(const path& p) const
+  {
+    return m_imp->may_exist(p);
+  }
+
+  bool existence_filter::exists(const path& p) const
+  {
+    return !m_imp->may_exist(p) ? false : filesystem8::exists(detail::status(p));
+  }
+
+  bool existence_filter::exists(const path& p, error_code& ec) const FILESYSTEM8_NOEXCEPT
+  {
+    if (!m_imp->may_exist(p))
+    {
+#     ifdef FILESYSTEM8_POSIX_API
+      ec.assign(ENOENT, system_category());  // as status() reports it
+#     else
+      ec.assign(ERROR_FILE_NOT_FOUND, system_category());
+#     endif
+      return false;
+    }
+    return filesystem8::exists(detail::status(p, &ec));
+  }
+
+}  // namespace filesystem8
@@ -0,0 +1,43 @@
+//  expected.cpp  ----------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/expected.hpp>
+#include <type_traits>
+
+namespace filesystem8
+{
+  static_assert(std::is_trivially_copyable<fs_error>::value,
+    "fs_error is copied around by the try_ functions, and must not allocate");
+
+  const char* op_name(fs_op op) FILESYSTEM8_NOEXCEPT
+  {
+    switch (op)
+    {
+    case fs_op::status:           return "filesystem8::status";
+    case fs_op::symlink_status:   return "filesystem8::symlink_status";
+    case fs_op::exists:           return "filesystem8::exists";
+    case fs_op::is_directory:     return "filesystem8::is_directory";
+    case fs_op::is_regular_file:  return "filesystem8::is_regular_file";
+    case fs_op::file_size:        return "filesystem8::file_size";
+    case fs_op::last_write_time:  return "filesystem8::last_write_time";
+    case fs_op::hard_link_count:  return "filesystem8::hard_link_count";
+    case fs_op::file_id_of:       return "filesystem8::file_id_of";
+    default:                      return "filesystem8";
+    }
+  }
+
+  filesystem_error fs_error::exception(const path& p) const
+  {
+    return filesystem_error(op_name(m_op), p, code());
+  }
+
+  void fs_error::raise(const path& p) const
+  {
+    FILESYSTEM8_THROW(exception(p));
+  }
+
+}  // namespace filesystem8
@@ -0,0 +1,621 @@
+//  file_info.cpp  ---------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/file_info.hpp>
+#include "file_time.hpp"
+#include "helpers.hpp"
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <dirent.h>
+#   include <unistd.h>
+#   if defined(__linux__) && defined(STATX_BASIC_STATS)
+#     include <sys/sysmacros.h>
+#     define FILESYSTEM8_STATX
+#   endif
+#else
+#   include <windows.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_type;
+using fs::file_status;
+using fs::file_info;
+using fs::file_info_fields;
+using fs::query_option;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+using fs::detail::error;
+#ifdef FILESYSTEM8_POSIX_API
+using fs::detail::type_of;
+using fs::detail::nanoseconds;
+#endif
+
+namespace
+{
+  bool any(query_option options, query_option o)
+  {
+    return (options & o) != query_option::none;
+  }
+
+  bool any(file_info_fields fields, file_info_fields f)
+  {
+    return (fields & f) != file_info_fields::none;
+  }
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  bool not_found_error(int errnum)
+  {
+    return errnum == ENOENT || errnum == ENOTDIR;
+  }
+
+  //  What stat() tells, all of it at once
+  const file_info_fields stat_fields = file_info_fields::all
+#   ifndef __APPLE__
+    & ~file_info_fields::btime
+#   endif
+    ;
+
+  void from_stat(const struct stat& st, file_info_fields fields, file_info& info)
+  {
+    info.fields = fields & stat_fields;
+    info.type = type_of(st.st_mode);
+    info.permissions = static_cast<fs::perms>(st.st_mode) & fs::perms::mask;
+    info.size = static_cast<std::uintmax_t>(st.st_size);
+    info.blocks = static_cast<std::uintmax_t>(st.st_blocks);
+    info.nlink = static_cast<std::uintmax_t>(st.st_nlink);
+    info.uid = st.st_uid;
+    info.gid = st.st_gid;
+    info.dev = static_cast<std::uint64_t>(st.st_dev);
+    info.ino = static_cast<std::uint64_t>(st.st_ino);
+#   if defined(__APPLE__)
+    info.atime_ns = nanoseconds(st.st_atimespec);
+    info.mtime_ns = nanoseconds(st.st_mtimespec);
+    info.ctime_ns = nanoseconds(st.st_ctimespec);
+    info.btime_ns = nanoseconds(st.st_birthtimespec);
+#   else
+    info.atime_ns = nanoseconds(st.st_atim);
+    info.mtime_ns = nanoseconds(st.st_mtim);
+    info.ctime_ns = nanoseconds(st.st_ctim);
+#   endif
+  }
+
+# ifdef FILESYSTEM8_STATX
+
+  //  Set once statx() has failed with ENOSYS, from a kernel older than 4.11, or EPERM,
+  //  from a seccomp filter that does not know it; stat() is used from then on
+  std::atomic<bool> no_statx(false);
+
+  //  The statx() mask bits of each of file_info_fields, in order
+  const unsigned statx_bits[] =
+  {
+    STATX_TYPE, STATX_MODE, STATX_SIZE, STATX_BLOCKS, STATX_NLINK, STATX_UID | STATX_GID,
+    STATX_INO, STATX_ATIME, STATX_MTIME, STATX_CTIME, STATX_BTIME
+  };
+
+  unsigned statx_mask(file_info_fields fields)
+  {
+    unsigned mask = 0;
+    for (unsigned i = 0; i != sizeof(statx_bits) / sizeof(statx_bits[0]); ++i)
+      if (any(fields, static_cast<file_info_fields>(1 << i)))
+        mask |= statx_bits[i];
+    return mask;
+  }
+
+  //  Returns: those of fields the mask returned by statx() covers
+  file_info_fields statx_fields(file_info_fields fields, unsigned mask)
+  {
+    file_info_fields result = file_info_fields::none;
+    for (unsigned i = 0; i != sizeof(statx_bits) / sizeof(statx_bits[0]); ++i)
+      if ((mask & statx_bits[i]) == statx_bits[i])
+        result |= static_cast<file_info_fields>(1 << i);
+    return result & fields;
+  }
+
+  std::int64_t nanoseconds(const struct statx_timestamp& ts)
+  {
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  void from_statx(const struct statx& st, file_info_fields fields, file_info& info)
+  {
+    info.fields = statx_fields(fields, st.stx_mask);
+    info.type = type_of(st.stx_mode);
+    info.permissions = static_cast<fs::perms>(st.stx_mode) & fs::perms::mask;
+    info.size = st.stx_size;
+    info.blocks = st.stx_blocks;
+    info.nlink = st.stx_nlink;
+    info.uid = st.stx_uid;
+    info.gid = st.stx_gid;
+    info.dev = static_cast<std::uint64_t>(makedev(st.stx_dev_major, st.stx_dev_minor));
+    info.ino = st.stx_ino;
+    info.atime_ns = nanoseconds(st.stx_atime);
+    info.mtime_ns = nanoseconds(st.stx_mtime);
+    info.ctime_ns = nanoseconds(st.stx_ctime);
+    info.btime_ns = nanoseconds(st.stx_btime);
+  }
+
+# endif
+
+  //  Returns: 0, or the errno of the failure
+  int query_at(int dirfd, const char* name, file_info_fields fields, query_option options,
+    file_info& info)
+  {
+#   ifdef FILESYSTEM8_STATX
+    if (!no_statx.load(std::memory_order_relaxed))
+    {
+      //  AT_NO_AUTOMOUNT, as stat() implies, so that a query does not mount anything
+      int flags = AT_NO_AUTOMOUNT;
+      if (any(options, query_option::no_follow))
+        flags |= AT_SYMLINK_NOFOLLOW;
+      if (any(options, query_option::dont_sync))
+        flags |= AT_STATX_DONT_SYNC;
+      struct statx st;
+      if (::statx(dirfd, name, flags, statx_mask(fields), &st) == 0)
+      {
+        from_statx(st, fields, info);
+        return 0;
+      }
+      if (errno != ENOSYS && errno != EPERM)
+        return errno;
+      no_statx.store(true, std::memory_order_relaxed);
+    }
+#   endif
+    struct stat st;
+    if (::fstatat(dirfd, name, &st,
+      any(options, query_option::no_follow) ? AT_SYMLINK_NOFOLLOW : 0) != 0)
+      return errno;
+    from_stat(st, fields, info);
+    return 0;
+  }
+
+  int query_path(const path& p, file_info_fields fields, query_option options,
+    file_info& info)
+  {
+    return query_at(AT_FDCWD, p.c_str(), fields, options, info);
+  }
+
+# else  // Windows
+
+  bool not_found_error(int errnum)
+  {
+    return errnum == ERROR_FILE_NOT_FOUND
+      || errnum == ERROR_PATH_NOT_FOUND
+      || errnum == ERROR_INVALID_NAME
+      || errnum == ERROR_INVALID_DRIVE
+      || errnum == ERROR_NOT_READY
+      || errnum == ERROR_INVALID_PARAMETER
+      || errnum == ERROR_BAD_PATHNAME
+      || errnum == ERROR_BAD_NETPATH;
+  }
+
+  std::int64_t nanoseconds(const FILETIME& ft)
+  {
+    std::int64_t t = (static_cast<std::int64_t>(ft.dwHighDateTime) << 32) + ft.dwLowDateTime;
+    return (t - 116444736000000000LL) * 100;  // 100 ns units since 1601
+  }
+
+  //  Windows keeps no owner ids or status change time, and no allocation in the
+  //  information by handle
+  const file_info_fields handle_fields = file_info_fields::all
+    & ~(file_info_fields::blocks | file_info_fields::owner | file_info_fields::ctime);
+
+  int query_path(const path& p, file_info_fields fields, query_option options,
+    file_info& info)
+  {
+    DWORD flags = FILE_FLAG_BACKUP_SEMANTICS;
+    if (any(options, query_option::no_follow))
+      flags |= FILE_FLAG_OPEN_REPARSE_POINT;
+    HANDLE h = ::CreateFileW(p.c_str(), FILE_READ_ATTRIBUTES,
+      FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, flags, 0);
+    if (h == INVALID_HANDLE_VALUE)
+      return ::GetLastError();
+    BY_HANDLE_FILE_INFORMATION fi;
+    BOOL ok = ::GetFileInformationByHandle(h, &fi);
+    int errnum = ok ? 0 : ::GetLastError();
+    ::CloseHandle(h);
+    if (!ok)
+      return errnum;
+
+    info.fields = fields & handle_fields;
+    if (any(options, query_option::no_follow)
+      && (fi.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+      info.type = file_type::symlink;
+    else if ((fi.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+      info.type = file_type::directory;
+    else
+      info.type = file_type::regular;
+    info.permissions = fs::perms::owner_read | fs::perms::group_read | fs::perms::others_read;
+    if ((fi.dwFileAttributes & FILE_ATTRIBUTE_READONLY) == 0)
+      info.permissions |= fs::perms::owner_write | fs::perms::group_write
+        | fs::perms::others_write;
+    info.size = (static_cast<std::uintmax_t>(fi.nFileSizeHigh) << 32) | fi.nFileSizeLow;
+    info.nlink = fi.nNumberOfLinks;
+    info.dev = fi.dwVolumeSerialNumber;
+    info.ino = (static_cast<std::uint64_t>(fi.nFileIndexHigh) << 32) | fi.nFileIndexLow;
+    info.atime_ns = nanoseconds(fi.ftLastAccessTime);
+    info.mtime_ns = nanoseconds(fi.ftLastWriteTime);
+    info.btime_ns = nanoseconds(fi.ftCreationTime);
+    return 0;
+  }
+
+# endif
+
+  //  The result of a query of a path that does not exist
+  file_info not_found_info()
+  {
+    file_info info;
+    info.fields = file_info_fields::type;
+    info.type = file_type::not_found;
+    info.permissions = fs::perms::none;
+    return info;
+  }
+
+  //  batches  -------------------------------------------------------------------------//
+
+  //  The least number of paths worth handing to a thread of their own
+  const std::size_t min_slice = 64;
+
+  struct batch_item
+  {
+    std::size_t  index;     // in the batch
+    std::size_t  dir_size;  // of the parent directory in the native string; 0 if the
+                            // path is taken as a whole
+    std::size_t  name;      // where the filename starts
+  };
+
+  //  Where the operation on a path of a batch is to be done
+  struct batch_target
+  {
+    std::size_t  index;
+    const path*  p;
+#   ifdef FILESYSTEM8_POSIX_API
+    int          dirfd;     // of the parent directory, or AT_FDCWD with name the whole path
+    const char*  name;
+#   endif
+  };
+
+  //  Records the error of the first path, by index, that failed
+  struct batch_error
+  {
+    std::mutex   mutex;
+    std::size_t  index;
+    int          errnum;
+
+    batch_error() : index(static_cast<std::size_t>(-1)), errnum(0) {}
+
+    void record(std::size_t i, int e)
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      if (i < index)
+      {
+        index = i;
+        errnum = e;
+      }
+    }
+
+    //  Throws or reports the error recorded, if any
+    void report(const path* paths, error_code* ec, const char* message)
+    {
+      error(errnum, errnum != 0 ? paths[index] : path(), ec, message);
+    }
+  };
+
+  //  Sets the parent directory of item's path by which it is batched, or none if the
+  //  path is taken as a whole: a filename only, or a path ending in a separator, which
+  //  names the directory itself
+  void set_dir(const path& p, batch_item& item)
+  {
+    item.dir_size = item.name = 0;
+#   ifdef FILESYSTEM8_POSIX_API
+    const path::string_type& s = p.native();
+    path::string_type::size_type pos = s.rfind('/');
+    if (pos == path::string_type::npos || pos + 1 == s.size())
+      return;
+    item.dir_size = pos == 0 ? 1 : pos;  // the parent of /x is /
+    item.name = pos + 1;
+#   else
+    (void)p;
+#   endif
+  }
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  bool same_dir(const path* paths, const batch_item& lhs, const batch_item& rhs)
+  {
+    return lhs.dir_size == rhs.dir_size
+      && paths[lhs.index].native().compare(0, lhs.dir_size,
+           paths[rhs.index].native(), 0, rhs.dir_size) == 0;
+  }
+
+  int open_dir(const std::string& dir)
+  {
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+#   ifdef O_PATH
+    flags |= O_PATH;  // needs only search permission, and reads nothing
+#   endif
+    return ::open(dir.c_str(), flags);
+  }
+
+# endif
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  //  Sorts [first, last), items all of the directory of dir, by the inode numbers the
+  //  directory lists for them, those it does not list last
+  void sort_by_inode(const path* paths, const batch_item& dir, const batch_item** first,
+    const batch_item** last)
+  {
+    const ino_t unlisted = static_cast<ino_t>(-1);
+    std::unordered_map<std::string, ino_t> inos;
+    for (const batch_item** it = first; it != last; ++it)
+      inos.emplace(paths[(*it)->index].c_str() + (*it)->name, unlisted);
+
+    DIR* d = ::opendir(paths[dir.index].native().substr(0, dir.dir_size).c_str());
+    if (d == 0)
+      return;  // the queries will tell why
+    std::string name;
+    std::size_t left = inos.size();
+    for (struct dirent* e; left != 0 && (e = ::readdir(d)) != 0;)
+    {
+      name.assign(e->d_name);
+      std::unordered_map<std::string, ino_t>::iterator it = inos.find(name);
+      if (it != inos.end() && it->second == unlisted)
+      {
+        it->second = e->d_ino;
+        --left;
+      }
+    }
+    ::closedir(d);
+
+    std::stable_sort(first, last,
+      [paths, &inos](const batch_item* lhs, const batch_item* rhs)
+      {
+        return inos.find(paths[lhs->index].c_str() + lhs->name)->second
+          < inos.find(paths[rhs->index].c_str() + rhs->name)->second;
+      });
+  }
+
+# endif
+
+  //  Calls op(target) for items [first, last), opening each parent directory once; with
+  //  directory_order::inode, each directory's paths in the order of their inode numbers
+  template <class Op>
+  void run_slice(const path* paths, const batch_item* first, const batch_item* last,
+    fs::directory_order order, Op& op)
+  {
+    batch_target t;
+#   ifdef FILESYSTEM8_POSIX_API
+    std::vector<const batch_item*> items;
+    items.reserve(last - first);
+    for (; first != last; ++first)
+      items.push_back(first);
+    if (order == fs::directory_order::inode)
+    {
+      for (std::size_t begin = 0, end; begin != items.size(); begin = end)
+      {
+        for (end = begin + 1;
+          end != items.size() && same_dir(paths, *items[begin], *items[end]); ++end) {}
+        if (items[begin]->dir_size != 0 && end - begin > 1)
+          sort_by_inode(paths, *items[begin], items.data() + begin, items.data() + end);
+      }
+    }
+
+    int dirfd = -1;
+    const batch_item* dir = 0;  // whose parent dirfd is open, or failed to open
+    for (std::size_t i = 0; i != items.size(); ++i)
+    {
+      const batch_item& item = *items[i];
+      t.index = item.index;
+      t.p = &paths[item.index];
+      if (item.dir_size != 0 && (dir == 0 || !same_dir(paths, *dir, item)))
+      {
+        if (dirfd >= 0)
+          ::close(dirfd);
+        dir = &item;
+        dirfd = open_dir(t.p->native().substr(0, item.dir_size));
+      }
+      if (item.dir_size == 0 || dirfd < 0)  // the directory is not searchable, or
+      {                                     // not there: path by path
+        t.dirfd = AT_FDCWD;
+        t.name = t.p->c_str();
+      }
+      else
+      {
+        t.dirfd = dirfd;
+        t.name = t.p->c_str() + item.name;
+      }
+      op(t);
+    }
+    if (dirfd >= 0)
+      ::close(dirfd);
+#   else
+    (void)order;
+    for (; first != last; ++first)
+    {
+      t.index = first->index;
+      t.p = &paths[first->index];
+      op(t);
+    }
+#   endif
+  }
+
+  //  Calls op(target) for each of paths, concurrently from the threads of a pool, so op
+  //  must be thread safe
+  template <class Op>
+  void run_batch(const path* paths, std::size_t count, const fs::batch_options& options,
+    Op op)
+  {
+    std::vector<batch_item> items(count);
+    for (std::size_t i = 0; i != count; ++i)
+    {
+      items[i].index = i;
+      set_dir(paths[i], items[i]);
+    }
+
+    //  by parent directory, then by index, so that each directory's paths are together
+    std::sort(items.begin(), items.end(),
+      [paths](const batch_item& lhs, const batch_item& rhs)
+      {
+        int c = paths[lhs.index].native().compare(0, lhs.dir_size,
+          paths[rhs.index].native(), 0, rhs.dir_size);
+        return c < 0 || (c == 0 && lhs.index < rhs.index);
+      });
+
+    unsigned threads = options.threads;
+    if (threads == 0)
+      threads = std::thread::hardware_concurrency();
+    if (threads <= 1 || count < 2 * min_slice)
+    {
+      run_slice(paths, items.data(), items.data() + count, options.order, op);
+      return;
+    }
+
+    //  a few slices per thread, to even out slow directories
+    std::size_t slice = std::max(min_slice, count / (4 * threads) + 1);
+    fs::detail::work_stealing_pool pool(threads);
+    for (std::size_t first = 0; first < count; first += slice)
+    {
+      const batch_item* begin = items.data() + first;
+      const batch_item* end = items.data() + std::min(count, first + slice);
+      fs::directory_order order = options.order;
+      pool.submit([paths, begin, end, order, &op]()
+        { run_slice(paths, begin, end, order, op); });
+    }
+    pool.wait();
+  }
+
+  //  Queries each of paths, passing each index and result to store
+  template <class Store>
+  void query_many(const path* paths, std::size_t count, file_info_fields fields,
+    query_option options, const fs::batch_options& batch, Store store,
+    error_code* ec, const char* message)
+  {
+    batch_error err;
+    run_batch(paths, count, batch,
+      [fields, options, &store, &err](const batch_target& t)
+      {
+        file_info info;
+#       ifdef FILESYSTEM8_POSIX_API
+        int errnum = query_at(t.dirfd, t.name, fields, options, info);
+#       else
+        int errnum = query_path(*t.p, fields, options, info);
+#       endif
+        if (errnum != 0)
+        {
+          if (not_found_error(errnum))
+            info = not_found_info();
+          else
+          {
+            info = file_info();
+            err.record(t.index, errnum);
+          }
+        }
+        store(t.index, info);
+      });
+    err.report(paths, ec, message);
+  }
+
+}  // unnamed namespace
+
+namespace filesystem8
+{
+namespace detail
+{
+  FILESYSTEM8_EXPORT
+  file_info query(const path& p, file_info_fields fields, query_option options,
+    error_code* ec)
+  {
+    file_info info;
+    int errnum = query_path(p, fields, options, info);
+    if (errnum != 0 && not_found_error(errnum))
+    {
+      if (ec != 0)  // as status(), always report errno
+        ec->assign(errnum, system_category());
+      return not_found_info();
+    }
+    if (error(errnum, p, ec, "filesystem8::query"))
+      return file_info();
+    return info;
+  }
+
+  FILESYSTEM8_EXPORT
+  int query_errno(const path& p, file_info_fields fields, query_option options,
+    file_info& info) FILESYSTEM8_NOEXCEPT
+  {
+    info = file_info();
+    int errnum = query_path(p, fields, options, info);
+    if (errnum != 0)
+      info = not_found_error(errnum) ? not_found_info() : file_info();
+    return errnum;
+  }
+
+  FILESYSTEM8_EXPORT
+  void query_many(const path* paths, std::size_t count, file_info* results,
+    file_info_fields fields, query_option options, const batch_options& batch,
+    error_code* ec)
+  {
+    ::query_many(paths, count, fields, options, batch,
+      [results](std::size_t i, const file_info& info) { results[i] = info; },
+      ec, "filesystem8::query_many");
+  }
+
+  FILESYSTEM8_EXPORT
+  void status_many(const path* paths, std::size_t count, file_status* results,
+    query_option options, const batch_options& batch, error_code* ec)
+  {
+    ::query_many(paths, count, file_info_fields::type | file_info_fields::perms,
+      options, batch,
+      [results](std::size_t i, const file_info& info) { results[i] = info.status(); },
+      ec, any(options, query_option::no_follow)
+        ? "filesystem8::symlink_status_many" : "filesystem8::status_many");
+  }
+
+  FILESYSTEM8_EXPORT
+  void touch_many(const path* paths, std::size_t count, file_time_type new_time,
+    const batch_options& batch, error_code* ec)
+  {
+    batch_error err;
+#   if defined(FILESYSTEM8_POSIX_API) && defined(UTIME_OMIT)
+    struct timespec times[2];
+    write_time_only(new_time, times);
+    run_batch(paths, count, batch,
+      [&times, &err](const batch_target& t)
+      {
+        if (::utimensat(t.dirfd, t.name, times, 0) != 0)
+          err.record(t.index, errno);
+      });
+#   else
+    run_batch(paths, count, batch,
+      [new_time, &err](const batch_target& t)
+      {
+        error_code ec;
+        detail::last_write_time(*t.p, new_time, &ec);
+        if (ec)
+          err.record(t.index, ec.value());
+      });
+#   endif
+    err.report(paths, ec, "filesystem8::touch_many");
+  }
+
+}  // namespace detail
+}  // namespace filesystem8
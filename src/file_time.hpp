@@ -0,0 +1,56 @@
+//  file_time.hpp  ---------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+//  Private to the library implementation; not installed.
+//
+//  The conversion of a file_time_type to what utimensat() takes, shared by
+//  last_write_time() and touch_many().
+
+#ifndef FILESYSTEM8_FILE_TIME_HPP
+#define FILESYSTEM8_FILE_TIME_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <chrono>
+#include <cstdint>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <time.h>
+#endif
+
+namespace filesystem8
+{
+namespace detail
+{
+# if defined(FILESYSTEM8_POSIX_API) && defined(UTIME_OMIT)
+
+  //  Sets times, as utimensat() takes them, to leave the access time alone and set the
+  //  last write time to t
+  inline
+  void write_time_only(file_time_type t, struct timespec (&times)[2])
+  {
+    std::int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      t.time_since_epoch()).count();
+    std::int64_t sec = ns / 1000000000, nsec = ns % 1000000000;
+    if (nsec < 0)  // tv_nsec is never negative
+    {
+      --sec;
+      nsec += 1000000000;
+    }
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = static_cast<time_t>(sec);
+    times[1].tv_nsec = static_cast<long>(nsec);
+  }
+
+# endif
+}  // namespace detail
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_FILE_TIME_HPP
@@ -0,0 +1,81 @@
+//  helpers.hpp  -----------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+//  Private to the library implementation; not installed.
+//
+//  Small helpers shared by the translation units that report errors through a
+//  std::error_code* and read struct stat themselves, or trust last write times.
+
+#ifndef FILESYSTEM8_HELPERS_HPP
+#define FILESYSTEM8_HELPERS_HPP
+
+#include <filesystem8/config.hpp>
+#include <filesystem8/operations.hpp>
+#include <cstdint>
+#include <system_error>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <time.h>
+#endif
+
+namespace filesystem8
+{
+namespace detail
+{
+  //  A directory written to within this long before it was read may be written to again
+  //  within the granularity of its timestamp without its last write time changing
+  const std::int64_t racy_window_ns = 2000000000;  // FAT timestamps are 2 s apart
+
+  //  Clears *ec if error_num is 0; otherwise throws filesystem_error(message, p) if ec
+  //  is 0, else sets *ec. Returns: true if error_num is an error
+  inline
+  bool error(int error_num, const path& p, std::error_code* ec, const char* message)
+  {
+    if (!error_num)
+    {
+      if (ec != 0) ec->clear();
+    }
+    else
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error(message,
+          p, std::error_code(error_num, std::system_category())));
+      else
+        ec->assign(error_num, std::system_category());
+    }
+    return error_num != 0;
+  }
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  inline
+  file_type type_of(mode_t mode)
+  {
+    if (S_ISREG(mode))  return file_type::regular;
+    if (S_ISDIR(mode))  return file_type::directory;
+    if (S_ISLNK(mode))  return file_type::symlink;
+    if (S_ISBLK(mode))  return file_type::block;
+    if (S_ISCHR(mode))  return file_type::character;
+    if (S_ISFIFO(mode)) return file_type::fifo;
+    if (S_ISSOCK(mode)) return file_type::socket;
+    return file_type::unknown;
+  }
+
+  inline
+  std::int64_t nanoseconds(const struct timespec& ts)
+  {
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+# endif
+
+}  // namespace detail
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_HELPERS_HPP
@@ -0,0 +1,264 @@
+//  metadata_cache.cpp  ----------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/metadata_cache.hpp>
+#include "helpers.hpp"
+#include <cerrno>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef FILESYSTEM8_WINDOWS_API
+#   include <windows.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_type;
+using fs::file_status;
+using fs::file_info;
+using fs::file_info_fields;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+using fs::detail::error;
+
+namespace
+{
+  typedef std::chrono::steady_clock clock_type;
+
+  //  What a miss asks for: all that the cached functions answer
+  const file_info_fields cached_fields = file_info_fields::type | file_info_fields::perms
+    | file_info_fields::size | file_info_fields::mtime;
+
+  bool is_separator(path::value_type c)
+  {
+#   ifdef FILESYSTEM8_WINDOWS_API
+    return c == L'/' || c == L'\\';
+#   else
+    return c == '/';
+#   endif
+  }
+
+  //  Returns: true if key is root or below it
+  bool in_subtree(const path::string_type& key, const path::string_type& root)
+  {
+    if (key.compare(0, root.size(), root) != 0)
+      return false;
+    return key.size() == root.size() || root.empty() || is_separator(root.back())
+      || is_separator(key[root.size()]);
+  }
+}
+
+namespace filesystem8
+{
+  struct metadata_cache::entry
+  {
+    struct slot
+    {
+      bool               valid;
+      clock_type::time_point  expires;
+      file_info          info;
+      int                errnum;  // not found; other errors are not cached
+
+      slot() : valid(false), errnum(0) {}
+    };
+
+    slot  followed;     // for status()
+    slot  not_followed; // for symlink_status()
+  };
+
+  struct metadata_cache::shard
+  {
+    std::mutex     mutex;
+    std::unordered_map<path::string_type, entry>  entries;
+    std::uint64_t  hits;
+    std::uint64_t  misses;
+    std::uint64_t  generation;  // bumped by each invalidation that may touch the shard
+
+    shard() : hits(0), misses(0), generation(0) {}
+
+    //  Makes room for one more entry if the shard holds limit of them
+    void make_room(std::size_t limit, clock_type::time_point now)
+    {
+      if (limit == 0 || entries.size() < limit)
+        return;
+      for (auto it = entries.begin(); it != entries.end();)
+      {
+        if ((!it->second.followed.valid || it->second.followed.expires <= now)
+          && (!it->second.not_followed.valid || it->second.not_followed.expires <= now))
+          it = entries.erase(it);
+        else
+          ++it;
+      }
+      if (entries.size() >= limit)
+        entries.clear();
+    }
+  };
+
+  metadata_cache::metadata_cache(const metadata_cache_options& options)
+    : m_options(options)
+  {
+    std::size_t n = 1;
+    while (n < options.shards)
+      n <<= 1;
+    m_shard_limit = options.max_entries == 0 ? 0 : (options.max_entries + n - 1) / n;
+    m_shards.reserve(n);
+    for (std::size_t i = 0; i != n; ++i)
+      m_shards.push_back(std::unique_ptr<shard>(new shard));
+  }
+
+  metadata_cache::~metadata_cache() {}
+
+  file_info metadata_cache::m_lookup(const path& p, bool follow, int& errnum)
+  {
+    shard& s = *m_shards[std::hash<path::string_type>()(p.native()) & (m_shards.size() - 1)];
+    clock_type::time_point now = clock_type::now();
+    std::uint64_t generation;
+    {
+      std::lock_guard<std::mutex> lk(s.mutex);
+      auto it = s.entries.find(p.native());
+      if (it != s.entries.end())
+      {
+        const entry::slot& e = follow ? it->second.followed : it->second.not_followed;
+        if (e.valid && now < e.expires)
+        {
+          ++s.hits;
+          errnum = e.errnum;
+          return e.info;
+        }
+      }
+      ++s.misses;
+      generation = s.generation;
+    }
+
+    error_code ec;
+    file_info info(miss(p, follow, ec));
+    errnum = ec.value();
+    if (info.type == file_type::none)  // an error other than not found
+      return info;
+
+    std::lock_guard<std::mutex> lk(s.mutex);
+    if (s.generation != generation)  // invalidated meanwhile; info may be from before
+      return info;
+    auto it = s.entries.find(p.native());
+    if (it == s.entries.end())
+    {
+      s.make_room(m_shard_limit, now);
+      it = s.entries.emplace(p.native(), entry()).first;
+    }
+    entry::slot& e = follow ? it->second.followed : it->second.not_followed;
+    e.valid = true;
+    e.expires = now + m_options.ttl;
+    e.info = info;
+    e.errnum = errnum;
+    return info;
+  }
+
+  file_info metadata_cache::miss(const path& p, bool follow, error_code& ec)
+  {
+    return detail::query(p, cached_fields,
+      follow ? query_option::none : query_option::no_follow, &ec);
+  }
+
+  file_status metadata_cache::m_status(const path& p, bool follow, error_code* ec)
+  {
+    int errnum;
+    file_info info(m_lookup(p, follow, errnum));
+    if (info.type == file_type::not_found)
+    {
+      if (ec != 0)  // as status(), always report errno
+        ec->assign(errnum, system_category());
+      return info.status();
+    }
+    if (error(errnum, p, ec,
+      follow ? "filesystem8::status" : "filesystem8::symlink_status"))
+      return file_status(file_type::none);
+    return info.status();
+  }
+
+  std::uintmax_t metadata_cache::m_file_size(const path& p, error_code* ec)
+  {
+    int errnum;
+    file_info info(m_lookup(p, true, errnum));
+    if (error(errnum, p, ec, "filesystem8::file_size"))
+      return static_cast<std::uintmax_t>(-1);
+#   ifdef FILESYSTEM8_POSIX_API
+    const int not_regular = EPERM;
+#   else
+    const int not_regular = ERROR_NOT_SUPPORTED;
+#   endif
+    if (error(info.type != file_type::regular ? not_regular : 0,
+      p, ec, "filesystem8::file_size"))
+      return static_cast<std::uintmax_t>(-1);
+    return info.size;
+  }
+
+  std::time_t metadata_cache::m_last_write_time(const path& p, error_code* ec)
+  {
+    int errnum;
+    file_info info(m_lookup(p, true, errnum));
+    if (error(errnum, p, ec, "filesystem8::last_write_time"))
+      return std::time_t(-1);
+    std::int64_t t = info.mtime_ns / 1000000000;
+    if (info.mtime_ns % 1000000000 < 0)  // rounded toward zero; the seconds are floored
+      --t;
+    return static_cast<std::time_t>(t);
+  }
+
+  void metadata_cache::invalidate(const path& p)
+  {
+    shard& s = *m_shards[std::hash<path::string_type>()(p.native()) & (m_shards.size() - 1)];
+    std::lock_guard<std::mutex> lk(s.mutex);
+    s.entries.erase(p.native());
+    ++s.generation;
+  }
+
+  void metadata_cache::invalidate_subtree(const path& p)
+  {
+    path::string_type root(p.native());
+    while (root.size() > 1 && is_separator(root.back()))
+      root.pop_back();
+    for (std::size_t i = 0; i != m_shards.size(); ++i)
+    {
+      shard& s = *m_shards[i];
+      std::lock_guard<std::mutex> lk(s.mutex);
+      for (auto it = s.entries.begin(); it != s.entries.end();)
+      {
+        if (in_subtree(it->first, root))
+          it = s.entries.erase(it);
+        else
+          ++it;
+      }
+      ++s.generation;  // a path below p may be being queried, not yet an entry
+    }
+  }
+
+  void metadata_cache::clear()
+  {
+    for (std::size_t i = 0; i != m_shards.size(); ++i)
+    {
+      std::lock_guard<std::mutex> lk(m_shards[i]->mutex);
+      m_shards[i]->entries.clear();
+      ++m_shards[i]->generation;
+    }
+  }
+
+  metadata_cache_stats metadata_cache::stats() const
+  {
+    metadata_cache_stats result = { 0, 0, 0 };
+    for (std::size_t i = 0; i != m_shards.size(); ++i)
+    {
+      std::lock_guard<std::mutex> lk(m_shards[i]->mutex);
+      result.hits += m_shards[i]->hits;
+      result.misses += m_shards[i]->misses;
+      result.entries += m_shards[i]->entries.size();
+    }
+    return result;
+  }
+
+}  // namespace filesystem8
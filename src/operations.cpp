@@ -34,8 +34,11 @@
 #endif
 
 #include <filesystem8/operations.hpp>
+#include <filesystem8/file_info.hpp>
+#include "file_time.hpp"
 #include <memory>
 #include <vector> 
+#include <algorithm>
 #include <cstdlib>     // for malloc, free
 #include <cstring>
 #include <cstdio>      // for remove, rename
@@ -80,6 +83,16 @@ using std::wstring;
 #   include <fcntl.h>
 #   include <utime.h>
 #   include "limits.h"
+#   ifdef __linux__
+#     include <sys/sysmacros.h>  // for makedev
+#     include <sys/ioctl.h>
+#     include <sys/sendfile.h>
+#     include <sys/syscall.h>
+#     include <fstream>
+#     ifndef FICLONE  // <linux/fs.h> has it, but clashes with <sys/mount.h>
+#       define FICLONE _IOW(0x94, 9, int)
+#     endif
+#   endif
 
 # else // FILESYSTEM8_WINDOW_API
 
@@ -205,7 +218,8 @@ typedef int err_t;
 #   define FILESYSTEM8_DELETE_FILE(P)(::unlink(P)== 0)
 #   define FILESYSTEM8_COPY_DIRECTORY(F,T)(!(::stat(from.c_str(), &from_stat)!= 0\
          || ::mkdir(to.c_str(),from_stat.st_mode)!= 0))
-#   define FILESYSTEM8_COPY_FILE(F,T,FailIfExistsBool)copy_file_api(F, T, FailIfExistsBool)
+#   define FILESYSTEM8_COPY_FILE(F,T,Option,Tuning,Method)\
+         copy_file_api(F, T, Option, Tuning, Method)
 #   define FILESYSTEM8_MOVE_FILE(OLD,NEW)(::rename(OLD, NEW)== 0)
 #   define FILESYSTEM8_RESIZE_FILE(P,SZ)(::truncate(P, SZ)== 0)
 
@@ -225,7 +239,8 @@ typedef DWORD err_t;
 #   define FILESYSTEM8_REMOVE_DIRECTORY(P)(::RemoveDirectoryW(P)!= 0)
 #   define FILESYSTEM8_DELETE_FILE(P)(::DeleteFileW(P)!= 0)
 #   define FILESYSTEM8_COPY_DIRECTORY(F,T)(::CreateDirectoryExW(F, T, 0)!= 0)
-#   define FILESYSTEM8_COPY_FILE(F,T,FailIfExistsBool)(::CopyFileW(F, T, FailIfExistsBool)!= 0)
+#   define FILESYSTEM8_COPY_FILE(F,T,Option,Tuning,Method)((Method = fs::copy_method::system),\
+         ::CopyFileW(F, T, (Option & fs::detail::overwrite_if_exists) == 0)!= 0)
 #   define FILESYSTEM8_MOVE_FILE(OLD,NEW)(::MoveFileExW(OLD, NEW, MOVEFILE_REPLACE_EXISTING|MOVEFILE_COPY_ALLOWED)!= 0)
 #   define FILESYSTEM8_RESIZE_FILE(P,SZ)(resize_file_api(P, SZ)!= 0)
 #   define FILESYSTEM8_READ_SYMLINK(P,T)
@@ -400,43 +415,182 @@ namespace
     return errno == ENOENT || errno == ENOTDIR;
   }
 
-  bool // true if ok
-  copy_file_api(const std::string& from_p,
-    const std::string& to_p, bool fail_if_exists)
+# ifdef UTIME_OMIT
+  //  One utimensat(), leaving the access time alone
+  void set_last_write_time(const path& p, fs::file_time_type new_time, error_code* ec)
   {
-    const std::size_t buf_sz = 32768;
-    std::unique_ptr<char[]> buf(new char [buf_sz]);
-    int infile=-1, outfile=-1;  // -1 means not open
+    struct timespec times[2];
+    fs::detail::write_time_only(new_time, times);
+    error(::utimensat(AT_FDCWD, p.c_str(), times, 0) != 0 ? FILESYSTEM8_ERRNO : 0,
+      p, ec, "filesystem8::last_write_time");
+  }
+# endif
 
-    // bug fixed: code previously did a stat()on the from_file first, but that
-    // introduced a gratuitous race condition; the stat()is now done after the open()
+  //  copy_file helpers  ---------------------------------------------------------------//
 
-    if ((infile = ::open(from_p.c_str(), O_RDONLY))< 0)
-      { return false; }
+  enum copy_step
+  {
+    copy_done,
+    copy_next,    // the way tried does not apply; the next one goes on from the offsets
+    copy_failed
+  };
 
-    struct stat from_stat;
-    if (::stat(from_p.c_str(), &from_stat)!= 0)
-    { 
-      ::close(infile);
-      return false;
+  //  Returns: true if errnum, from a way of copying, means only that the way does not
+  //  apply to these files or this system
+  bool copy_unsupported(int errnum)
+  {
+    return errnum == EXDEV || errnum == EOPNOTSUPP || errnum == ENOTSUP
+      || errnum == ENOSYS || errnum == EINVAL || errnum == ENOTTY
+      || errnum == EPERM;  // as seccomp filters that do not know a call report it
+  }
+
+# ifdef __linux__
+
+  copy_step clone_file(int infile, int outfile, int& errnum)
+  {
+    if (::ioctl(outfile, FICLONE, infile) == 0)
+      return copy_done;
+    errnum = errno;
+    return copy_unsupported(errnum) ? copy_next : copy_failed;
+  }
+
+  //  Copies the rest of infile, from its offset, to outfile, at its offset, in the
+  //  kernel: by copy_file_range(), or sendfile() if use_sendfile
+  copy_step kernel_copy(int infile, int outfile, bool use_sendfile, int& errnum)
+  {
+    const std::size_t chunk = std::size_t(1) << 30;
+    bool copied = false;
+    for (;;)
+    {
+      ssize_t sz;
+      if (use_sendfile)
+        sz = ::sendfile(outfile, infile, 0, chunk);
+#     ifdef __NR_copy_file_range
+      else  // called directly, as glibc before 2.30 emulates it through a buffer
+        sz = ::syscall(__NR_copy_file_range, infile, static_cast<loff_t*>(0), outfile,
+          static_cast<loff_t*>(0), chunk, 0u);
+#     else
+      else
+      {
+        errnum = ENOSYS;
+        return copy_next;
+      }
+#     endif
+      if (sz > 0)
+        copied = true;
+      else if (sz == 0)  // at the end, or at once for a file it cannot read, as in /proc
+        return copied ? copy_done : copy_next;
+      else if (errno != EINTR)
+      {
+        errnum = errno;
+        return copy_unsupported(errnum) ? copy_next : copy_failed;
+      }
     }
+  }
 
-    int oflag = O_CREAT | O_WRONLY | O_TRUNC;
-    if (fail_if_exists)
-      oflag |= O_EXCL;
-    if ((outfile = ::open(to_p.c_str(), oflag, from_stat.st_mode))< 0)
+# endif
+
+  struct free_buffer
+  {
+    void operator()(char* p) const { std::free(p); }
+  };
+
+# ifdef O_DIRECT
+
+  bool set_direct(int fd, bool on)
+  {
+    int flags = ::fcntl(fd, F_GETFL);
+    return flags != -1
+      && ::fcntl(fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT) == 0;
+  }
+
+# endif
+
+# if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+
+  //  Starts writeback of outfile's bytes [begin, end), waits for that of [prev, begin),
+  //  started last time, and drops those from the page cache for both files
+  void write_behind(int infile, int outfile, off_t prev, off_t begin, off_t end)
+  {
+    ::sync_file_range(outfile, begin, end - begin, SYNC_FILE_RANGE_WRITE);
+    if (begin == prev)
+      return;
+    ::sync_file_range(outfile, prev, begin - prev, SYNC_FILE_RANGE_WAIT_BEFORE
+      | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    ::posix_fadvise(outfile, prev, begin - prev, POSIX_FADV_DONTNEED);
+    ::posix_fadvise(infile, prev, begin - prev, POSIX_FADV_DONTNEED);
+  }
+
+# endif
+
+  //  Copies the rest of infile, from its offset, to outfile, at its offset, through a
+  //  buffer. The hints given to the kernel are only that; one it does not take is not
+  //  an error.
+  copy_step buffered_copy(int infile, int outfile, const struct stat& from_stat,
+    const fs::copy_tuning& tuning, int& errnum)
+  {
+    const std::size_t page = 4096;  // the alignment O_DIRECT asks for, at most
+    std::uintmax_t want = from_stat.st_size > 0
+      ? static_cast<std::uintmax_t>(from_stat.st_size) : tuning.min_buffer;
+    if (want > tuning.max_buffer)
+      want = tuning.max_buffer;
+    if (want < tuning.min_buffer)
+      want = tuning.min_buffer;
+    const std::size_t buf_sz = want <= page ? page
+      : static_cast<std::size_t>((want + page - 1) / page * page);
+    void* mem = 0;
+    if (::posix_memalign(&mem, page, buf_sz) != 0)
     {
-      int open_errno = errno;
-      FILESYSTEM8_ASSERT(infile >= 0);
-      ::close(infile);
-      errno = open_errno;
-      return false;
+      errnum = ENOMEM;
+      return copy_failed;
     }
+    std::unique_ptr<char, free_buffer> buf(static_cast<char*>(mem));
+
+    const off_t start = ::lseek(outfile, 0, SEEK_CUR);  // past what another way copied
+#   ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(infile, start, 0, POSIX_FADV_SEQUENTIAL);
+#   endif
+#   if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    if (tuning.preallocate && S_ISREG(from_stat.st_mode) && from_stat.st_size > start)
+      ::fallocate(outfile, FALLOC_FL_KEEP_SIZE, start, from_stat.st_size - start);
+#   endif
+    bool direct = false;
+#   ifdef O_DIRECT
+    if (tuning.direct && start % page == 0 && set_direct(infile, true))
+    {
+      direct = set_direct(outfile, true);
+      if (!direct)
+        set_direct(infile, false);
+    }
+#   endif
+    off_t offset = start, synced = start, prev_synced = start;
 
     ssize_t sz, sz_read=1, sz_write;
-    while (sz_read > 0
-      && (sz_read = ::read(infile, buf.get(), buf_sz)) > 0)
+    while (sz_read > 0)
     {
+      sz_read = ::read(infile, buf.get(), buf_sz);
+#     ifdef O_DIRECT
+      if (sz_read < 0 && errno == EINVAL && direct)
+      {
+        // accepted by fcntl(), but not by the filesystem
+        set_direct(infile, false);
+        set_direct(outfile, false);
+        direct = false;
+        sz_read = 1;
+        continue;
+      }
+      if (direct && sz_read > 0 && static_cast<std::size_t>(sz_read) % page != 0)
+      {
+        // the tail, or a short read; O_DIRECT writes whole blocks only, and infile's
+        // offset is no longer aligned for the next read
+        set_direct(infile, false);
+        set_direct(outfile, false);
+        direct = false;
+      }
+#     endif
+      if (sz_read <= 0)
+        break;
+
       // Allow for partial writes - see Advanced Unix Programming (2nd Ed.),
       // Marc Rochkind, Addison-Wesley, 2004, page 94
       sz_write = 0;
@@ -450,20 +604,119 @@ namespace
         if ((sz = ::write(outfile, buf.get() + sz_write,
           sz_read - sz_write)) < 0)
         { 
+#         ifdef O_DIRECT
+          if (errno == EINVAL && direct)
+          {
+            set_direct(outfile, false);
+            direct = false;
+            continue;
+          }
+#         endif
           sz_read = sz; // cause read loop termination
           break;        //  and error reported after closes
         }
         FILESYSTEM8_ASSERT(sz > 0);                  // #2
         sz_write += sz;
       } while (sz_write < sz_read);
+
+      offset += sz_write;
+#     if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+      if (sz_read > 0 && tuning.sync_interval != 0
+        && static_cast<std::uintmax_t>(offset - synced) >= tuning.sync_interval)
+      {
+        write_behind(infile, outfile, prev_synced, synced, offset);
+        prev_synced = synced;
+        synced = offset;
+      }
+#     endif
     }
 
-    if (::close(infile)< 0)
-      sz_read = -1;
-    if (::close(outfile)< 0)
-      sz_read = -1;
+    if (sz_read < 0)
+    {
+      errnum = errno;
+      return copy_failed;
+    }
+    return copy_done;
+  }
+
+  bool // true if ok
+  copy_file_api(const std::string& from_p, const std::string& to_p,
+    fs::detail::copy_option option, const fs::copy_tuning& tuning, fs::copy_method& method)
+  {
+    int infile=-1, outfile=-1;  // -1 means not open
+
+    // bug fixed: code previously did a stat()on the from_file first, but that
+    // introduced a gratuitous race condition; the stat()is now done after the open()
+
+    if ((infile = ::open(from_p.c_str(), O_RDONLY))< 0)
+      { return false; }
+
+    struct stat from_stat;
+    if (::fstat(infile, &from_stat)!= 0)
+    { 
+      int stat_errno = errno;
+      ::close(infile);
+      errno = stat_errno;
+      return false;
+    }
 
-    return sz_read >= 0;
+    int oflag = O_CREAT | O_WRONLY | O_TRUNC;
+    if ((option & fs::detail::overwrite_if_exists) == 0)
+      oflag |= O_EXCL;
+    if ((outfile = ::open(to_p.c_str(), oflag, from_stat.st_mode))< 0)
+    {
+      int open_errno = errno;
+      FILESYSTEM8_ASSERT(infile >= 0);
+      ::close(infile);
+      errno = open_errno;
+      return false;
+    }
+
+    int errnum = 0;
+    copy_step step = copy_next;
+#   ifdef __linux__
+    // a file whose size is not known, such as those in /proc, is read to its end
+    const bool in_kernel = S_ISREG(from_stat.st_mode) && from_stat.st_size > 0;
+    if (in_kernel && (option & fs::detail::no_clone) == 0)
+    {
+      method = fs::copy_method::clone;
+      step = clone_file(infile, outfile, errnum);
+    }
+    if (in_kernel && step == copy_next && (option & fs::detail::no_copy_file_range) == 0)
+    {
+      method = fs::copy_method::copy_file_range;
+      step = kernel_copy(infile, outfile, false, errnum);
+    }
+    if (in_kernel && step == copy_next && (option & fs::detail::no_sendfile) == 0)
+    {
+      method = fs::copy_method::sendfile;
+      step = kernel_copy(infile, outfile, true, errnum);
+    }
+#   endif
+    if (step == copy_next)
+    {
+      method = fs::copy_method::buffered;
+      step = buffered_copy(infile, outfile, from_stat, tuning, errnum);
+    }
+
+    if (::close(infile) < 0 && step == copy_done)
+    {
+      errnum = errno;
+      step = copy_failed;
+    }
+    if (::close(outfile) < 0 && step == copy_done)
+    {
+      errnum = errno;
+      step = copy_failed;
+    }
+
+    if (step != copy_done)
+    {
+      method = fs::copy_method::none;
+      errno = errnum;
+      return false;
+    }
+    return true;
   }
 
   inline fs::file_type query_file_type(const path& p, error_code* ec)
@@ -544,6 +797,23 @@ namespace
     ft.dwHighDateTime = static_cast<DWORD>(temp >> 32);
   }
 
+  //  FILETIME counts 100 ns units since 1601
+  fs::file_time_type to_file_time(const FILETIME & ft)
+  {
+    __int64 t = (static_cast<__int64>(ft.dwHighDateTime)<< 32)
+      + ft.dwLowDateTime;
+    t -= 116444736000000000LL;
+    return fs::file_time_type(std::chrono::nanoseconds(t * 100));
+  }
+
+  void to_FILETIME(fs::file_time_type t, FILETIME & ft)
+  {
+    __int64 temp = t.time_since_epoch().count() / 100;
+    temp += 116444736000000000LL;
+    ft.dwLowDateTime = static_cast<DWORD>(temp);
+    ft.dwHighDateTime = static_cast<DWORD>(temp >> 32);
+  }
+
   // Thanks to Jeremy Maitin-Shepard for much help and for permission to
   // base the equivalent()implementation on portions of his 
   // file-equivalence-win32.cpp experimental code.
@@ -896,11 +1166,21 @@ namespace detail
   }
 
   FILESYSTEM8_EXPORT
-  void copy_file(const path& from, const path& to, copy_option option, error_code* ec)
+  copy_method copy_file(const path& from, const path& to, copy_option option,
+    error_code* ec)
+  {
+    return copy_file(from, to, option, copy_tuning(), ec);
+  }
+
+  FILESYSTEM8_EXPORT
+  copy_method copy_file(const path& from, const path& to, copy_option option,
+    const copy_tuning& tuning, error_code* ec)
   {
-    error(!FILESYSTEM8_COPY_FILE(from.c_str(), to.c_str(),
-      option == fail_if_exists) ? FILESYSTEM8_ERRNO : 0,
-        from, to, ec, "filesystem8::copy_file");
+    copy_method method = copy_method::none;
+    if (error(!FILESYSTEM8_COPY_FILE(from.c_str(), to.c_str(), option, tuning, method)
+      ? FILESYSTEM8_ERRNO : 0, from, to, ec, "filesystem8::copy_file"))
+      return copy_method::none;
+    return method;
   }
 
   FILESYSTEM8_EXPORT
@@ -1111,25 +1391,23 @@ namespace detail
   bool equivalent(const path& p1, const path& p2, std::error_code* ec)
   {
 #   ifdef FILESYSTEM8_POSIX_API
-    struct stat s2;
-    int e2(::stat(p2.c_str(), &s2));
-    struct stat s1;
-    int e1(::stat(p1.c_str(), &s1));
+    file_id id2;
+    error_code e2(path_key(p2, id2));
+    file_id id1;
+    error_code e1(path_key(p1, id1));
 
-    if (e1 != 0 || e2 != 0)
+    if (e1 || e2)
     {
       // if one is invalid and the other isn't then they aren't equivalent,
       // but if both are invalid then it is an error
-      error (e1 != 0 && e2 != 0, p1, p2, ec, "filesystem8::equivalent");
+      error(e1 && e2 ? e1.value() : 0, p1, p2, ec, "filesystem8::equivalent");
       return false;
     }
 
-    // both stats now known to be valid
-    return  s1.st_dev == s2.st_dev && s1.st_ino == s2.st_ino
-        // According to the POSIX stat specs, "The st_ino and st_dev fields
-        // taken together uniquely identify the file within the system."
-        // Just to be sure, size and mod time are also checked.
-        && s1.st_size == s2.st_size && s1.st_mtime == s2.st_mtime;
+    // According to the POSIX stat specs, "The st_ino and st_dev fields
+    // taken together uniquely identify the file within the system."
+    if (ec != 0) ec->clear();
+    return id1 == id2;
 
 #   else  // Windows
 
@@ -1234,6 +1512,14 @@ namespace detail
 #   endif
   }
 
+  FILESYSTEM8_EXPORT
+  file_id file_id_of(const path& p, std::error_code* ec)
+  {
+    file_id id;
+    error(path_key(p, id).value(), p, ec, "filesystem8::file_id_of");
+    return id;
+  }
+
   FILESYSTEM8_EXPORT
   std::uintmax_t hard_link_count(const path& p, std::error_code* ec)
   {
@@ -1274,7 +1560,7 @@ namespace detail
   }
 
   FILESYSTEM8_EXPORT
-  bool is_empty(const path& p, std::error_code* ec)
+  bool is_empty(const path& p, leaf_option opt, std::error_code* ec)
   {
 #   ifdef FILESYSTEM8_POSIX_API
 
@@ -1282,6 +1568,8 @@ namespace detail
     if (error(::stat(p.c_str(), &path_stat)!= 0,
         p, ec, "filesystem8::is_empty"))
       return false;        
+    if (S_ISDIR(path_stat.st_mode) && opt == leaf_option::nlink && path_stat.st_nlink > 2)
+      return false;  // has a subdirectory
     return S_ISDIR(path_stat.st_mode)
       ? is_empty_directory(p)
       : path_stat.st_size == 0;
@@ -1338,8 +1626,11 @@ namespace detail
   {
 #   ifdef FILESYSTEM8_POSIX_API
 
+#   ifdef UTIME_OMIT
+    set_last_write_time(p, fs::file_time_type(std::chrono::seconds(new_time)), ec);
+#   else
     struct stat path_stat;
-    if (error(::stat(p.c_str(), &path_stat)!= 0,
+    if (error(::stat(p.c_str(), &path_stat)!= 0 ? FILESYSTEM8_ERRNO : 0,
       p, ec, "filesystem8::last_write_time"))
         return;
     ::utimbuf buf;
@@ -1347,6 +1638,78 @@ namespace detail
     buf.modtime = new_time;
     error(::utime(p.c_str(), &buf)!= 0 ? FILESYSTEM8_ERRNO : 0,
       p, ec, "filesystem8::last_write_time");
+#   endif
+
+#   else
+
+    handle_wrapper hw(
+      create_file_handle(p.c_str(), FILE_WRITE_ATTRIBUTES,
+        FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0));
+
+    if (error(hw.handle == INVALID_HANDLE_VALUE ? FILESYSTEM8_ERRNO : 0,
+      p, ec, "filesystem8::last_write_time"))
+        return;
+
+    FILETIME lwt;
+    to_FILETIME(new_time, lwt);
+
+    error(::SetFileTime(hw.handle, 0, 0, &lwt)== 0 ? FILESYSTEM8_ERRNO : 0,
+      p, ec, "filesystem8::last_write_time");
+#   endif
+  }
+
+  FILESYSTEM8_EXPORT
+  file_time_type last_write_time_ns(const path& p, std::error_code* ec)
+  {
+#   ifdef FILESYSTEM8_POSIX_API
+
+    struct stat path_stat;
+    if (error(::stat(p.c_str(), &path_stat)!= 0 ? FILESYSTEM8_ERRNO : 0,
+      p, ec, "filesystem8::last_write_time_ns"))
+        return file_time_type::min();
+#     if defined(__APPLE__)
+    const struct timespec& mtime = path_stat.st_mtimespec;
+#     else
+    const struct timespec& mtime = path_stat.st_mtim;
+#     endif
+    return file_time_type(std::chrono::seconds(mtime.tv_sec)
+      + std::chrono::nanoseconds(mtime.tv_nsec));
+
+#   else
+
+    handle_wrapper hw(
+      create_file_handle(p.c_str(), 0,
+        FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0));
+
+    if (error(hw.handle == INVALID_HANDLE_VALUE ? FILESYSTEM8_ERRNO : 0,
+      p, ec, "filesystem8::last_write_time_ns"))
+        return file_time_type::min();
+
+    FILETIME lwt;
+
+    if (error(::GetFileTime(hw.handle, 0, 0, &lwt)== 0 ? FILESYSTEM8_ERRNO : 0,
+      p, ec, "filesystem8::last_write_time_ns"))
+        return file_time_type::min();
+
+    return to_file_time(lwt);
+#   endif
+  }
+
+  FILESYSTEM8_EXPORT
+  void last_write_time(const path& p, file_time_type new_time, std::error_code* ec)
+  {
+#   if defined(FILESYSTEM8_POSIX_API) && defined(UTIME_OMIT)
+
+    set_last_write_time(p, new_time, ec);
+
+#   elif defined(FILESYSTEM8_POSIX_API)
+
+    //  no utimensat(); to the second
+    last_write_time(p, static_cast<std::time_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(new_time.time_since_epoch())
+        .count()), ec);
 
 #   else
 
@@ -1936,7 +2299,7 @@ namespace detail
         m_status = m_symlink_status;
         if (ec != 0) ec->clear();
       }
-      else m_status = detail::status(m_path, ec);
+      else m_status = detail::status(path(), ec);
     }
     else if (ec != 0) ec->clear();
     return m_status;
@@ -1946,11 +2309,43 @@ namespace detail
   directory_entry::m_get_symlink_status(std::error_code* ec) const
   {
     if (!status_known(m_symlink_status))
-      m_symlink_status = detail::symlink_status(m_path, ec);
+      m_symlink_status = detail::symlink_status(path(), ec);
     else if (ec != 0) ec->clear();
     return m_symlink_status;
   }
 
+  file_id
+  directory_entry::m_get_id(bool follow, std::error_code* ec) const
+  {
+    // as for status, the id of an entry that is not a symlink is that of the entry
+    if (follow && !(m_ids_known & id_known) && (m_ids_known & symlink_id_known)
+      && !is_symlink(m_symlink_status))
+    {
+      m_id = m_symlink_id;
+      m_ids_known |= id_known;
+    }
+    if (m_ids_known & (follow ? id_known : symlink_id_known))
+    {
+      if (ec != 0) ec->clear();
+      return follow ? m_id : m_symlink_id;
+    }
+
+    error_code local_ec;
+    file_info info(detail::query(path(), file_info_fields::type | file_info_fields::perms
+      | file_info_fields::id, follow ? query_option::none : query_option::no_follow,
+      &local_ec));
+    if (error(local_ec.value(), path(), ec,
+      follow ? "filesystem8::directory_entry::id" : "filesystem8::directory_entry::symlink_id"))
+      return file_id();
+
+    file_status& st = follow ? m_status : m_symlink_status;
+    if (!status_known(st))
+      st = info.status();
+    (follow ? m_id : m_symlink_id) = info.id();
+    m_ids_known |= follow ? id_known : symlink_id_known;
+    return info.id();
+  }
+
 //  dispatch directory_entry supplied here rather than in 
 //  <filesystem8/path_traits.hpp>, thus avoiding header circularity.
 //  test cases are in operations_unit_test.cpp
@@ -1996,6 +2391,55 @@ namespace
 #define dirent dirent64
 #endif
 
+  //  dirent buffers are all of one size, so each thread keeps a few freed ones for
+  //  reuse; a deep traversal opens and closes directories at a high rate
+
+  thread_local int dirent_pool_state = 0;  // 0 not created yet, 1 alive, 2 destroyed
+
+  struct dirent_buffer_pool
+  {
+    static const std::size_t capacity = 16;
+    void*        buffers[capacity];
+    std::size_t  count;
+
+    dirent_buffer_pool() : count(0) { dirent_pool_state = 1; }
+    ~dirent_buffer_pool()
+    {
+      while (count != 0)
+        std::free(buffers[--count]);
+      dirent_pool_state = 2;
+    }
+  };
+
+  //  Returns: this thread's pool, or 0 if it is already destroyed, as happens when a
+  //  directory_iterator is destroyed during thread exit
+  dirent_buffer_pool* dirent_pool()
+  {
+    if (dirent_pool_state == 2)
+      return 0;
+    static thread_local dirent_buffer_pool pool;
+    return &pool;
+  }
+
+  void* allocate_dirent_buffer(std::size_t size)
+  {
+    dirent_buffer_pool* pool = dirent_pool();
+    if (pool != 0 && pool->count != 0)
+      return pool->buffers[--pool->count];
+    return std::malloc(size);
+  }
+
+  void release_dirent_buffer(void* buffer)
+  {
+    if (buffer == 0)
+      return;
+    dirent_buffer_pool* pool = dirent_pool();
+    if (pool != 0 && pool->count != dirent_buffer_pool::capacity)
+      pool->buffers[pool->count++] = buffer;
+    else
+      std::free(buffer);
+  }
+
   error_code dir_itr_first(void *& handle, void *& buffer,
     const char* dir, string& target,
     fs::file_status &, fs::file_status &)
@@ -2009,12 +2453,12 @@ namespace
     error_code ec = path_max(path_size);
     if (ec)return ec;
     dirent de;
-    buffer = std::malloc((sizeof(dirent) - sizeof(de.d_name))
+    buffer = allocate_dirent_buffer((sizeof(dirent) - sizeof(de.d_name))
       +  path_size + 1); // + 1 for "/0"
     return ok;
   }  
 
-  // warning: the only dirent member updated is d_name
+  // warning: the only dirent members updated are d_name, d_ino, and d_type
   inline int readdir_r_simulator(DIR * dirp, struct dirent * entry,
     struct dirent ** result)// *result set to 0 on end of directory
   {
@@ -2035,22 +2479,16 @@ namespace
     if ((p = ::readdir(dirp))== 0)
       return errno;
     std::strcpy(entry->d_name, p->d_name);
+    entry->d_ino = p->d_ino;
+#   ifdef FILESYSTEM8_STATUS_CACHE
+    entry->d_type = p->d_type;
+#   endif
     *result = entry;
     return 0;
   }
 
-  error_code dir_itr_increment(void *& handle, void *& buffer,
-    string& target, fs::file_status & sf, fs::file_status & symlink_sf)
+  void dirent_status(const dirent * entry, fs::file_status & sf, fs::file_status & symlink_sf)
   {
-    FILESYSTEM8_ASSERT(buffer != 0);
-    dirent * entry(static_cast<dirent *>(buffer));
-    dirent * result;
-    int return_code;
-    if ((return_code = readdir_r_simulator(static_cast<DIR*>(handle), entry, &result))!= 0)
-      return error_code(errno, system_category());
-    if (result == 0)
-      return fs::detail::dir_itr_close(handle, buffer);
-    target = entry->d_name;
 #   ifdef FILESYSTEM8_STATUS_CACHE
     if (entry->d_type == DT_UNKNOWN) // filesystem does not supply d_type value
     {
@@ -2072,9 +2510,65 @@ namespace
 #   else
     sf = symlink_sf = fs::file_status(fs::status_error);
 #    endif
+  }
+
+  error_code dir_itr_increment(void *& handle, void *& buffer,
+    string& target, fs::file_status & sf, fs::file_status & symlink_sf)
+  {
+    FILESYSTEM8_ASSERT(buffer != 0);
+    dirent * entry(static_cast<dirent *>(buffer));
+    dirent * result;
+    int return_code;
+    if ((return_code = readdir_r_simulator(static_cast<DIR*>(handle), entry, &result))!= 0)
+      return error_code(errno, system_category());
+    if (result == 0)
+      return fs::detail::dir_itr_close(handle, buffer);
+    target = entry->d_name;
+    dirent_status(entry, sf, symlink_sf);
     return ok;
   }
 
+  //  Appends the remaining entries other than dot and dot-dot, except those whose d_type
+  //  shows them to be excluded by types, so that the next one in order comes last: by
+  //  descending inode number, or in reverse of the order read. handle is left open, at
+  //  end of directory. On error, what was read before it is appended.
+  error_code dir_itr_read_snapshot(void * handle, void * buffer, fs::entry_type_mask types,
+    fs::directory_order order, std::vector<fs::detail::dir_itr_snapshot_entry>& snapshot)
+  {
+    FILESYSTEM8_ASSERT(buffer != 0);
+    dirent * entry(static_cast<dirent *>(buffer));
+    dirent * result;
+    int return_code = 0;
+    fs::detail::dir_itr_snapshot_entry e;
+    const std::size_t first = snapshot.size();
+
+    for (;;)
+    {
+      if ((return_code = readdir_r_simulator(static_cast<DIR*>(handle), entry, &result))!= 0)
+        break;
+      if (result == 0)
+        break;
+      if (entry->d_name[0] == '.' && (entry->d_name[1] == '\0'
+        || (entry->d_name[1] == '.' && entry->d_name[2] == '\0')))
+        continue;
+      dirent_status(entry, e.file_stat, e.symlink_file_stat);
+      if ((fs::detail::entry_type_of(e.symlink_file_stat.type()) & types)
+        == fs::entry_type_mask::none)
+        continue;
+      e.filename = entry->d_name;
+      e.ino = entry->d_ino;
+      snapshot.push_back(e);
+    }
+
+    if (order == fs::directory_order::inode)
+      std::sort(snapshot.begin() + first, snapshot.end(),
+        [](const fs::detail::dir_itr_snapshot_entry& lhs,
+          const fs::detail::dir_itr_snapshot_entry& rhs) { return lhs.ino > rhs.ino; });
+    else
+      std::reverse(snapshot.begin() + first, snapshot.end());
+    return error_code(return_code, system_category());
+  }
+
 # else // FILESYSTEM8_WINDOWS_API
 
   error_code dir_itr_first(void *& handle, const fs::path& dir,
@@ -2191,7 +2685,7 @@ namespace detail
    )
   {
 #   ifdef FILESYSTEM8_POSIX_API
-    std::free(buffer);
+    release_dirent_buffer(buffer);
     buffer = 0;
     if (handle == 0)return ok;
     DIR * h(static_cast<DIR*>(handle));
@@ -2209,90 +2703,277 @@ namespace detail
 #   endif
   }
 
-  void directory_iterator_construct(directory_iterator& it,
-    const path& p, std::error_code* ec)    
+  inline bool is_dot_or_dot_dot(const path::string_type& filename)
   {
-    if (error(p.empty() ? not_found_error_code.value() : 0, p, ec,
-              "filesystem8::directory_iterator::construct"))
-      return;
+    return filename[0] == dot
+      && (filename.size()== 1
+        || (filename[1] == dot
+          && filename.size()== 2));
+  }
+
+  FILESYSTEM8_EXPORT
+  std::error_code dir_itr_imp_open(dir_itr_imp& imp, const path& p)
+  {
+    if (p.empty())
+      return not_found_error_code;
 
     path::string_type filename;
     file_status file_stat, symlink_file_stat;
-    error_code result = dir_itr_first(it.m_imp->handle,
+    error_code result = dir_itr_first(imp.handle,
 #     if defined(FILESYSTEM8_POSIX_API)
-      it.m_imp->buffer,
+      imp.buffer,
 #     endif
       p.c_str(), filename, file_stat, symlink_file_stat);
 
     if (result)
     {
-      it.m_imp.reset();
-      error(result.value(), p,
-        ec, "filesystem8::directory_iterator::construct");
-      return;
+      dir_itr_close(imp.handle
+#       if defined(FILESYSTEM8_POSIX_API)
+        , imp.buffer
+#       endif
+      );
+      return result;
     }
-    
-    if (it.m_imp->handle == 0)
-      it.m_imp.reset(); // eof, so make end iterator
-    else // not eof
+
+    if (imp.handle == 0)  // eof
+      return ok;
+
+#   if defined(FILESYSTEM8_POSIX_API)
+    if (imp.order == directory_order::inode)
     {
-      it.m_imp->dir_entry.assign(p / filename, file_stat, symlink_file_stat);
-      if (filename[0] == dot // dot or dot-dot
-        && (filename.size()== 1
-          || (filename[1] == dot
-            && filename.size()== 2)))
-        {  it.increment(*ec); }
+      result = dir_itr_read_snapshot(imp.handle, imp.buffer, imp.types, imp.order,
+        imp.snapshot);
+      if (result)
+      {
+        imp.snapshot.clear();
+        dir_itr_close(imp.handle, imp.buffer);
+        return result;
+      }
     }
+#   endif
+
+    imp.dir_entry.assign(std::make_shared<const path>(p), filename, file_stat,
+      symlink_file_stat);
+    return is_dot_or_dot_dot(filename) || !is_type_included(imp.dir_entry, imp.types)
+      ? dir_itr_imp_increment(imp) : ok;
   }
 
-  void directory_iterator_increment(directory_iterator& it,
-    std::error_code* ec)
+  FILESYSTEM8_EXPORT
+  std::error_code dir_itr_imp_increment(dir_itr_imp& imp)
   {
-    FILESYSTEM8_ASSERT_MSG(it.m_imp.get(), "attempt to increment end iterator");
-    FILESYSTEM8_ASSERT_MSG(it.m_imp->handle != 0, "internal program error");
-    
+    FILESYSTEM8_ASSERT_MSG(!imp.at_end(), "internal program error");
+
+#   if defined(FILESYSTEM8_POSIX_API)
+    if (imp.order == directory_order::inode || imp.detached)
+    {
+      while (!imp.snapshot.empty())
+      {
+        dir_itr_snapshot_entry& e = imp.snapshot.back();
+        imp.dir_entry.replace_filename(e.filename, e.file_stat, e.symlink_file_stat);
+        imp.snapshot.pop_back();
+        if (is_type_included(imp.dir_entry, imp.types))
+          return ok;
+      }
+      std::vector<dir_itr_snapshot_entry>().swap(imp.snapshot);
+      imp.detached = false;
+      return dir_itr_close(imp.handle, imp.buffer);  // eof
+    }
+#   endif
+
     path::string_type filename;
     file_status file_stat, symlink_file_stat;
-    std::error_code temp_ec;
 
     for (;;)
     {
-      temp_ec = dir_itr_increment(it.m_imp->handle,
+      error_code result = dir_itr_increment(imp.handle,
 #       if defined(FILESYSTEM8_POSIX_API)
-        it.m_imp->buffer,
+        imp.buffer,
 #       endif
         filename, file_stat, symlink_file_stat);
 
-      if (temp_ec)  // happens if filesystem is corrupt, such as on a damaged optical disc
+      if (result)  // happens if filesystem is corrupt, such as on a damaged optical disc
       {
-        path error_path(it.m_imp->dir_entry.path().parent_path());  // fix ticket #5900
-        it.m_imp.reset();
-        if (ec == 0)
-          FILESYSTEM8_THROW(
-            filesystem_error("filesystem8::directory_iterator::operator++",
-              error_path,
-              error_code(FILESYSTEM8_ERRNO, system_category())));
-        ec->assign(FILESYSTEM8_ERRNO, system_category());
-        return;
+        dir_itr_close(imp.handle
+#         if defined(FILESYSTEM8_POSIX_API)
+          , imp.buffer
+#         endif
+        );
+        return result;
       }
-      else if (ec != 0) ec->clear();
 
-      if (it.m_imp->handle == 0)  // eof, make end
-      {
-        it.m_imp.reset();
-        return;
-      }
+      if (imp.handle == 0)  // eof
+        return ok;
 
-      if (!(filename[0] == dot // !(dot or dot-dot)
-        && (filename.size()== 1
-          || (filename[1] == dot
-            && filename.size()== 2))))
-      {
-        it.m_imp->dir_entry.replace_filename(
-          filename, file_stat, symlink_file_stat);
-        return;
-      }
+      // an entry the directory read already shows to be excluded is skipped before its
+      // path is formed; one of unknown type is stat'ed by is_type_included()
+      if (is_dot_or_dot_dot(filename)
+        || (entry_type_of(symlink_file_stat.type()) & imp.types) == entry_type_mask::none)
+        continue;
+
+      imp.dir_entry.replace_filename(filename, file_stat, symlink_file_stat);
+      if (is_type_included(imp.dir_entry, imp.types))
+        return ok;
     }
   }
+
+  FILESYSTEM8_EXPORT
+  std::error_code dir_itr_imp_detach(dir_itr_imp& imp)
+  {
+#   if defined(FILESYSTEM8_POSIX_API)
+    if (imp.handle == 0)  // at end, or detached already
+      return ok;
+    error_code result;
+    if (imp.order != directory_order::inode)  // else the snapshot is complete already
+      result = dir_itr_read_snapshot(imp.handle, imp.buffer, imp.types, imp.order,
+        imp.snapshot);
+    imp.detached = true;
+    dir_itr_close(imp.handle, imp.buffer);
+    return result;
+#   else
+    return ok;
+#   endif
+  }
+
+  void directory_iterator_construct(directory_iterator& it,
+    const path& p, std::error_code* ec)    
+  {
+    error_code result = dir_itr_imp_open(*it.m_imp, p);
+    if (result || it.m_imp->at_end())
+      it.m_imp.reset(); // error or eof, so make end iterator
+    error(result.value(), p, ec, "filesystem8::directory_iterator::construct");
+  }
+
+  void directory_iterator_increment(directory_iterator& it,
+    std::error_code* ec)
+  {
+    FILESYSTEM8_ASSERT_MSG(it.m_imp.get(), "attempt to increment end iterator");
+
+    error_code result = dir_itr_imp_increment(*it.m_imp);
+    if (result)
+    {
+      path error_path(it.m_imp->dir_entry.path().parent_path());  // fix ticket #5900
+      it.m_imp.reset();
+      error(result.value(), error_path, ec,
+        "filesystem8::directory_iterator::operator++");
+      return;
+    }
+    if (ec != 0) ec->clear();
+    if (it.m_imp->at_end())  // eof, make end
+      it.m_imp.reset();
+  }
+
+  std::error_code directory_iterator_detach(directory_iterator& it)
+  {
+    FILESYSTEM8_ASSERT_MSG(it.m_imp.get(), "attempt to detach end iterator");
+    return dir_itr_imp_detach(*it.m_imp);
+  }
+
+  std::error_code directory_iterator_key(const directory_iterator& it, const path& dir,
+    file_id& key)
+  {
+    return it.m_imp ? directory_iterator_key(*it.m_imp, dir, key) : path_key(dir, key);
+  }
+
+  std::error_code directory_iterator_key(const dir_itr_imp& imp, const path& dir,
+    file_id& key)
+  {
+#   ifdef FILESYSTEM8_POSIX_API
+    struct stat st;
+    if (imp.handle == 0)
+      return path_key(dir, key);
+    if (::fstat(::dirfd(static_cast<DIR*>(imp.handle)), &st) != 0)
+      return error_code(errno, system_category());
+    key.dev = static_cast<std::uint64_t>(st.st_dev);
+    key.ino = static_cast<std::uint64_t>(st.st_ino);
+    return ok;
+#   else
+    // the handle iterating the directory is a find handle, which tells nothing of it
+    return path_key(dir, key);
+#   endif
+  }
+
+  std::error_code directory_entry_key(const directory_iterator& it, file_id& key)
+  {
+    FILESYSTEM8_ASSERT_MSG(it.m_imp.get(), "directory_entry_key of end iterator");
+#   ifdef FILESYSTEM8_POSIX_API
+    if (it.m_imp->handle == 0)  // detached
+      return path_key(it.m_imp->dir_entry.path(), key);
+    const path name(it.m_imp->dir_entry.filename());
+    int flags = 0;
+#     ifdef AT_NO_AUTOMOUNT
+    flags |= AT_NO_AUTOMOUNT;
+#     endif
+    struct stat st;
+    if (::fstatat(::dirfd(static_cast<DIR*>(it.m_imp->handle)), name.c_str(), &st, flags)
+      != 0)
+      return error_code(errno, system_category());
+    key.dev = static_cast<std::uint64_t>(st.st_dev);
+    key.ino = static_cast<std::uint64_t>(st.st_ino);
+    return ok;
+#   else
+    return path_key(it.m_imp->dir_entry.path(), key);
+#   endif
+  }
+
+  std::error_code path_key(const path& p, file_id& key)
+  {
+#   ifdef FILESYSTEM8_POSIX_API
+    struct stat st;
+    if (::stat(p.c_str(), &st) != 0)
+      return error_code(errno, system_category());
+    key.dev = static_cast<std::uint64_t>(st.st_dev);
+    key.ino = static_cast<std::uint64_t>(st.st_ino);
+    return ok;
+#   else
+    handle_wrapper h(create_file_handle(p.c_str(), 0,
+      FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING,
+      FILE_FLAG_BACKUP_SEMANTICS, 0));
+    BY_HANDLE_FILE_INFORMATION info;
+    if (h.handle == INVALID_HANDLE_VALUE || !::GetFileInformationByHandle(h.handle, &info))
+      return error_code(FILESYSTEM8_ERRNO, system_category());
+    key.dev = info.dwVolumeSerialNumber;
+    key.ino = (static_cast<std::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    return ok;
+#   endif
+  }
+
+  std::error_code pseudo_filesystem_devices(std::vector<std::uint64_t>& devices)
+  {
+#   ifdef __linux__
+    static const char* const pseudo[] =
+    {
+      "autofs", "binfmt_misc", "bpf", "cgroup", "cgroup2", "configfs", "debugfs",
+      "devpts", "devtmpfs", "efivarfs", "fusectl", "hugetlbfs", "mqueue", "nsfs",
+      "proc", "pstore", "rpc_pipefs", "securityfs", "selinuxfs", "sysfs", "tracefs"
+    };
+    std::ifstream f("/proc/self/mountinfo");
+    if (!f)
+      return error_code(ENOENT, system_category());
+
+    //  36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+    //  (3) major:minor ... (separator) - (fstype)
+    std::string line;
+    while (std::getline(f, line))
+    {
+      unsigned major, minor;
+      std::string::size_type sep = line.find(" - ");
+      if (sep == std::string::npos
+        || std::sscanf(line.c_str(), "%*s %*s %u:%u", &major, &minor) != 2)
+        continue;
+      std::string::size_type first = sep + 3;
+      std::string fstype(line, first, line.find(' ', first) - first);
+      for (std::size_t i = 0; i != sizeof(pseudo) / sizeof(pseudo[0]); ++i)
+        if (fstype == pseudo[i])
+        {
+          devices.push_back(static_cast<std::uint64_t>(makedev(major, minor)));
+          break;
+        }
+    }
+    return ok;
+#   else
+    (void)devices;
+    return ok;
+#   endif
+  }
 }  // namespace detail
 } // namespace filesystem88
@@ -0,0 +1,471 @@
+//  parallel_walk.cpp  -----------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/parallel_walk.hpp>
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+using filesystem8::path;
+using filesystem8::filesystem_error;
+using std::error_code;
+
+namespace
+{
+  //  symlink_option::skip_visited, shared by the threads of a walk
+  struct shared_visited
+  {
+    std::mutex  mutex;
+    std::unique_ptr<filesystem8::detail::visited_directories>  set;
+
+    explicit shared_visited(const filesystem8::walk_options& o)
+    {
+      const filesystem8::symlink_option both
+        = filesystem8::symlink_option::recurse | filesystem8::symlink_option::skip_visited;
+      if ((o.symlinks & both) == both)
+        set.reset(new filesystem8::detail::visited_directories(o.visited_prefilter));
+    }
+
+    //  Returns: false if dir, which it reads, was opened before, or on error
+    bool first_visit(const path& dir, const filesystem8::directory_iterator& it,
+      error_code& ec)
+    {
+      if (!set)
+        return true;
+      filesystem8::file_id key;
+      ec = filesystem8::detail::directory_iterator_key(it, dir, key);
+      if (ec)
+        return false;
+      std::lock_guard<std::mutex> lk(mutex);
+      return set->insert(key);
+    }
+  };
+
+  struct walk_state
+  {
+    const filesystem8::walk_visitor&  visitor;
+    const filesystem8::walk_options&  options;
+    filesystem8::entry_type_mask  read_types;
+    shared_visited  visited;
+    filesystem8::detail::device_filter  devices;  // started by the root's walk_directory
+    filesystem8::detail::work_stealing_pool  pool;
+
+    std::mutex  error_mutex;
+    error_code  error;       // first error reported by any worker
+    path        error_path;
+
+    walk_state(const filesystem8::walk_visitor& v, const filesystem8::walk_options& o)
+      : visitor(v), options(o),
+        read_types(filesystem8::detail::traversal_read_types(o.types, o.symlinks)),
+        visited(o), devices(o.mounts), pool(o.threads) {}
+
+    void report(const error_code& ec, const path& p)
+    {
+      {
+        std::lock_guard<std::mutex> lk(error_mutex);
+        if (error)
+          return;
+        error = ec;
+        error_path = p;
+      }
+      pool.cancel();
+    }
+  };
+
+  //  depth is the depth() of the entries of dir
+  void walk_directory(walk_state& s, const path& dir, int depth)
+  {
+    error_code ec;
+    filesystem8::directory_iterator it(dir, s.read_types, s.options.order, ec);
+    if (!ec && it != filesystem8::directory_iterator()
+      && !s.visited.first_visit(dir, it, ec))
+      it = filesystem8::directory_iterator();  // opened before
+    if (depth == 0 && !ec && it != filesystem8::directory_iterator()
+      && s.options.mounts != filesystem8::mount_option::none)
+      ec = s.devices.start(it, dir);  // before any other thread reads devices
+    std::uintmax_t subdirs_left = filesystem8::detail::subdirectory_count(dir, s.options);
+    for (; !ec && it != filesystem8::directory_iterator(); it.increment(ec))
+    {
+      if (s.pool.cancelled())
+        return;
+
+      const filesystem8::directory_entry& e = *it;
+      if (filesystem8::detail::is_type_included(e, s.options.types) && !s.visitor(e))
+        continue;
+      if (subdirs_left == 0  // leaf_option::nlink: the rest are not directories
+        || !filesystem8::detail::is_descent_allowed(e, depth, s.options))
+        continue;
+
+      error_code rec_ec;
+      if (filesystem8::detail::is_recursable_directory(e, s.options.symlinks, rec_ec)
+        && (s.options.mounts == filesystem8::mount_option::none
+          || s.devices.allows(it, rec_ec)))
+      {
+        --subdirs_left;
+        path sub(e.path());
+        s.pool.submit([&s, sub, depth]() { walk_directory(s, sub, depth + 1); });
+      }
+      else if (rec_ec)
+      {
+        s.report(rec_ec, e.path());
+        return;
+      }
+    }
+    if (ec)
+      s.report(ec, dir);
+  }
+
+  //  ordered mode  --------------------------------------------------------------------//
+
+  //  A directory of the walk, read by a worker or by the visiting thread, whichever gets
+  //  to it first
+  struct dir_node
+  {
+    enum state_type { waiting, reading, done };
+
+    path         dir;
+    int          depth;      // of the entries of dir
+    state_type   state;      // guarded by ordered_state::mutex
+    bool         submitted;  // to the pool, and counted in read_ahead; likewise guarded
+
+    //  Set by the reader before state becomes done
+    std::vector<filesystem8::directory_entry>  entries;   // sorted by filename
+    std::vector<std::shared_ptr<dir_node> >    children;  // of entries; 0 if not descended
+    error_code   error;      // reported after entries
+    path         error_path;
+    std::exception_ptr  exception;  // thrown by prune; rethrown in place of entries
+
+    dir_node(const path& p, int d) : dir(p), depth(d), state(waiting), submitted(false) {}
+  };
+
+  typedef std::shared_ptr<dir_node> node_ptr;
+
+  struct after_in_walk  // for a heap with the directory the walk gets to first on top
+  {
+    bool operator()(const node_ptr& lhs, const node_ptr& rhs) const
+      { return rhs->dir.compare(lhs->dir) < 0; }
+  };
+
+  struct ordered_state
+  {
+    const filesystem8::walk_visitor&  visitor;
+    const filesystem8::walk_options&  options;
+    filesystem8::entry_type_mask  read_types;
+    shared_visited  visited;
+    filesystem8::detail::device_filter  devices;  // started by the root's list_node
+
+    std::mutex               mutex;
+    std::condition_variable  read;       // a node is done
+    std::size_t              in_flight;  // nodes submitted and not yet released
+    std::priority_queue<node_ptr, std::vector<node_ptr>, after_in_walk>  deferred;
+
+    filesystem8::detail::work_stealing_pool  pool;  // last, so destroyed first
+
+    ordered_state(const filesystem8::walk_visitor& v, const filesystem8::walk_options& o)
+      : visitor(v), options(o),
+        read_types(filesystem8::detail::traversal_read_types(o.types, o.symlinks)),
+        visited(o), devices(o.mounts), in_flight(0), pool(o.threads) {}
+
+    bool has_room() const
+      { return options.read_ahead == 0 || in_flight < options.read_ahead; }
+
+    //  Submits the deferred nodes first in the walk while there is room.
+    //  Requires: mutex is locked
+    void fill(std::vector<node_ptr>& to_submit)
+    {
+      while (has_room() && !deferred.empty())
+      {
+        node_ptr n = deferred.top();
+        deferred.pop();
+        if (n->state == dir_node::waiting && !n->submitted)
+        {
+          n->submitted = true;
+          ++in_flight;
+          to_submit.push_back(n);
+        }
+      }
+    }
+
+    //  The last submitted is read first by a worker, so submit those first in the walk
+    //  last
+    void submit(const std::vector<node_ptr>& to_submit)
+    {
+      for (std::size_t i = to_submit.size(); i != 0; --i)
+      {
+        node_ptr n = to_submit[i - 1];
+        pool.submit([this, n]() { claim_and_read(n); });
+      }
+    }
+
+    void claim_and_read(const node_ptr& n)
+    {
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (n->state != dir_node::waiting)  // read or discarded by the visiting thread
+          return;
+        n->state = dir_node::reading;
+      }
+      read_node(*n);
+    }
+
+    //  Lists n sorted, and finds the directories below it to descend into.
+    //  Requires: n->state is reading, set by the caller
+    void read_node(dir_node& n)
+    {
+      try { list_node(n); }
+      catch (...)
+      {
+        n.exception = std::current_exception();
+        n.entries.clear();
+        n.children.clear();
+      }
+
+      std::vector<node_ptr> to_submit;
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        n.state = dir_node::done;
+        for (std::size_t i = 0; i != n.children.size(); ++i)
+          if (n.children[i])
+            deferred.push(n.children[i]);
+        fill(to_submit);
+      }
+      read.notify_all();
+      submit(to_submit);
+    }
+
+    void list_node(dir_node& n)
+    {
+      error_code ec;
+      filesystem8::directory_iterator it(n.dir, read_types,
+        filesystem8::directory_order::native, ec);
+      if (!ec && it != filesystem8::directory_iterator()
+        && !visited.first_visit(n.dir, it, ec))
+        it = filesystem8::directory_iterator();  // opened before
+      if (n.depth == 0 && !ec && it != filesystem8::directory_iterator()
+        && options.mounts != filesystem8::mount_option::none)
+        ec = devices.start(it, n.dir);
+      for (; !ec && it != filesystem8::directory_iterator(); it.increment(ec))
+        n.entries.push_back(*it);
+      if (ec)
+      {
+        n.error = ec;
+        n.error_path = n.dir;
+      }
+      std::sort(n.entries.begin(), n.entries.end(),
+        [](const filesystem8::directory_entry& lhs, const filesystem8::directory_entry& rhs)
+          { return lhs.filename().compare(rhs.filename()) < 0; });
+
+      // the count does not depend on the order the directories are found in
+      std::uintmax_t subdirs_left = filesystem8::detail::subdirectory_count(n.dir, options);
+      n.children.resize(n.entries.size());
+      for (std::size_t i = 0; i != n.entries.size() && subdirs_left != 0; ++i)
+      {
+        const filesystem8::directory_entry& e = n.entries[i];
+        if (!filesystem8::detail::is_descent_allowed(e, n.depth, options))
+          continue;
+        error_code rec_ec;
+        if (filesystem8::detail::is_recursable_directory(e, options.symlinks, rec_ec)
+          && (options.mounts == filesystem8::mount_option::none
+            || devices.allows(e.path(), rec_ec)))
+        {
+          --subdirs_left;
+          n.children[i].reset(new dir_node(e.path(), n.depth + 1));
+        }
+        else if (rec_ec)
+        {
+          // as a sequential walk would, visit e and then stop
+          n.error = rec_ec;
+          n.error_path = e.path();
+          n.entries.resize(i + 1);
+          n.children.resize(i + 1);
+          break;
+        }
+      }
+    }
+
+    //  Returns once n is done, reading it in this thread if no worker has started to
+    void obtain(dir_node& n)
+    {
+      bool claimed = false;
+      {
+        std::unique_lock<std::mutex> lk(mutex);
+        if (n.state == dir_node::waiting)
+        {
+          n.state = dir_node::reading;
+          claimed = true;
+        }
+        while (!claimed && n.state != dir_node::done)
+          read.wait(lk);
+      }
+      if (claimed)
+        read_node(n);
+      if (n.exception)
+        std::rethrow_exception(n.exception);
+    }
+
+    //  The visitor is done with n, or n is not to be visited; frees its room in the
+    //  read ahead. Requires: mutex is locked, and n is done
+    void release(dir_node& n, std::vector<node_ptr>& to_submit)
+    {
+      std::vector<filesystem8::directory_entry>().swap(n.entries);
+      std::vector<node_ptr>().swap(n.children);
+      if (n.submitted)
+      {
+        n.submitted = false;
+        --in_flight;
+      }
+      fill(to_submit);
+    }
+
+    void release(dir_node& n)
+    {
+      std::vector<node_ptr> to_submit;
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        release(n, to_submit);
+      }
+      submit(to_submit);
+    }
+
+    //  Drops n and everything read ahead below it
+    void discard(const node_ptr& n)
+    {
+      std::vector<node_ptr> to_submit;
+      std::vector<node_ptr> stack(1, n);
+      {
+        std::unique_lock<std::mutex> lk(mutex);
+        while (!stack.empty())
+        {
+          node_ptr top = stack.back();
+          stack.pop_back();
+          if (top->state == dir_node::waiting)
+            top->state = dir_node::done;  // so that no worker reads it
+          while (top->state != dir_node::done)
+            read.wait(lk);
+          for (std::size_t i = 0; i != top->children.size(); ++i)
+            if (top->children[i])
+              stack.push_back(top->children[i]);
+          release(*top, to_submit);
+        }
+      }
+      submit(to_submit);
+    }
+
+    //  Visits the tree below root in order, on the calling thread.
+    //  Returns: the first error in that order, if any
+    error_code visit(const path& root, path& error_path)
+    {
+      struct level
+      {
+        node_ptr     node;
+        std::size_t  next;  // index in node->entries
+      };
+
+      node_ptr root_node(new dir_node(root, 0));
+      obtain(*root_node);
+      std::vector<level> stack;
+      level l = {root_node, 0};
+      stack.push_back(l);
+
+      while (!stack.empty())
+      {
+        dir_node& n = *stack.back().node;
+        if (stack.back().next == n.entries.size())
+        {
+          if (n.error)
+          {
+            error_path = n.error_path;
+            return n.error;
+          }
+          release(n);
+          stack.pop_back();
+          continue;
+        }
+
+        std::size_t i = stack.back().next++;
+        const filesystem8::directory_entry& e = n.entries[i];
+        bool descend = !filesystem8::detail::is_type_included(e, options.types)
+          || visitor(e);
+        node_ptr child = n.children[i];
+        if (!child)
+          continue;
+        if (!descend)
+        {
+          discard(child);
+          continue;
+        }
+        obtain(*child);
+        level below = {child, 0};
+        stack.push_back(below);
+      }
+      return error_code();
+    }
+  };
+
+  void ordered_walk(const path& root, const filesystem8::walk_visitor& visitor,
+    const filesystem8::walk_options& options, std::error_code* ec)
+  {
+    ordered_state s(visitor, options);
+    path error_path;
+    error_code result;
+    try { result = s.visit(root, error_path); }
+    catch (...)
+    {
+      s.pool.cancel();
+      s.pool.wait();
+      throw;
+    }
+    s.pool.cancel();  // abandon what was read ahead
+    s.pool.wait();
+
+    if (result)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error("filesystem8::parallel_walk",
+          error_path, result));
+      *ec = result;
+    }
+    else if (ec != 0)
+      ec->clear();
+  }
+}  // unnamed namespace
+
+namespace filesystem8
+{
+namespace detail
+{
+  FILESYSTEM8_EXPORT
+  void parallel_walk(const path& root, const walk_visitor& visitor,
+    const walk_options& options, std::error_code* ec)
+  {
+    if (options.ordered)
+    {
+      ordered_walk(root, visitor, options, ec);
+      return;
+    }
+
+    walk_state s(visitor, options);
+    s.pool.submit([&s, &root]() { walk_directory(s, root, 0); });
+    s.pool.wait();  // rethrows an exception escaping from the visitor
+
+    if (s.error)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error("filesystem8::parallel_walk",
+          s.error_path, s.error));
+      *ec = s.error;
+    }
+    else if (ec != 0)
+      ec->clear();
+  }
+}  // namespace detail
+}  // namespace filesystem8
@@ -0,0 +1,337 @@
+//  rescan.cpp  ------------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/rescan.hpp>
+#include "helpers.hpp"
+#include <cerrno>
+#include <chrono>
+#include <map>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_type;
+using fs::scan_entry;
+using fs::scan_change;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+using fs::detail::error;
+using fs::detail::racy_window_ns;
+#ifdef FILESYSTEM8_POSIX_API
+using fs::detail::type_of;
+using fs::detail::nanoseconds;
+#endif
+
+namespace filesystem8
+{
+  struct scan_result::node
+  {
+    scan_entry   entry;
+    bool         racy;    // read again by the next rescan regardless of timestamps
+    std::size_t  count;   // of entries below this one
+    std::map<path::string_type, std::shared_ptr<const node> >  children;
+  };
+
+  struct scan_result_access
+  {
+    static scan_result make(const path& root, std::shared_ptr<const scan_result::node> top)
+    {
+      scan_result r;
+      r.m_root = root;
+      r.m_size = top->count;
+      r.m_top = std::move(top);
+      return r;
+    }
+    static const std::shared_ptr<const scan_result::node>& top(const scan_result& r)
+      { return r.m_top; }
+  };
+}
+
+namespace
+{
+  typedef fs::scan_result::node node;
+  typedef std::shared_ptr<const node> node_ptr;
+  typedef std::map<path::string_type, node_ptr> children_type;
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  int read_entry(const path& p, scan_entry& e)
+  {
+    struct stat st;
+    if (::lstat(p.c_str(), &st) != 0)
+      return errno;
+    e.type = type_of(st.st_mode);
+    e.permissions = static_cast<fs::perms>(st.st_mode) & fs::perms::mask;
+    e.size = S_ISREG(st.st_mode) ? static_cast<std::uintmax_t>(st.st_size) : 0;
+#   if defined(__APPLE__)
+    e.mtime_ns = nanoseconds(st.st_mtimespec);
+    e.ctime_ns = nanoseconds(st.st_ctimespec);
+#   else
+    e.mtime_ns = nanoseconds(st.st_mtim);
+    e.ctime_ns = nanoseconds(st.st_ctim);
+#   endif
+    return 0;
+  }
+
+# else
+
+  int read_entry(const path& p, scan_entry& e)
+  {
+    error_code ec;
+    fs::file_status st = fs::detail::symlink_status(p, &ec);
+    if (ec)
+      return ec.value();
+    e.type = st.type();
+    e.permissions = st.permissions();
+    e.size = fs::is_regular_file(st) ? fs::detail::file_size(p, &ec) : 0;
+    e.mtime_ns = e.ctime_ns
+      = static_cast<std::int64_t>(fs::detail::last_write_time(p, &ec)) * 1000000000;
+    return ec.value();
+  }
+
+# endif
+
+  //  For a directory, a change of its entries is reported for the entries themselves
+  bool differs(const scan_entry& lhs, const scan_entry& rhs)
+  {
+    if (lhs.permissions != rhs.permissions)
+      return true;
+    return lhs.type != file_type::directory
+      && (lhs.size != rhs.size || lhs.mtime_ns != rhs.mtime_ns
+        || lhs.ctime_ns != rhs.ctime_ns);
+  }
+
+  struct scanner
+  {
+    std::vector<scan_change>*  changes;     // 0 for a first scan
+    std::int64_t               racy_after;  // timestamps from then on are racy
+
+    void emit(scan_change::kind_type kind, const path& rel)
+    {
+      if (changes == 0)
+        return;
+      scan_change c;
+      c.kind = kind;
+      c.relative_path = rel;
+      changes->push_back(c);
+    }
+
+    //  Reports n, at rel, and everything below it as removed
+    void emit_removed(const node& n, const path& rel)
+    {
+      emit(scan_change::removed, rel);
+      for (children_type::const_iterator it = n.children.begin();
+        it != n.children.end(); ++it)
+        emit_removed(*it->second, rel / it->first);
+    }
+
+    node_ptr leaf(const scan_entry& e)
+    {
+      std::shared_ptr<node> n(new node);
+      n->entry = e;
+      n->racy = false;
+      n->count = 0;
+      return n;
+    }
+
+    //  Returns: the node for directory e at abs, rel, given prev, its node in the
+    //  previous scan if any. Reports changes below it, but not of e itself.
+    node_ptr directory(const node_ptr& prev, const path& abs, const path& rel,
+      const scan_entry& e)
+    {
+      std::shared_ptr<node> n(new node);
+      n->entry = e;
+      n->racy = e.mtime_ns >= racy_after || e.ctime_ns >= racy_after;
+
+      bool reused = prev && !prev->racy
+        && prev->entry.mtime_ns == e.mtime_ns && prev->entry.ctime_ns == e.ctime_ns
+        && reuse_entries(*prev, *n, abs, rel);
+      if (!reused)
+        read_entries(prev, *n, abs, rel);
+
+      n->count = 0;
+      bool same = prev && !differs(prev->entry, e) && prev->racy == n->racy;
+      for (children_type::const_iterator it = n->children.begin();
+        it != n->children.end(); ++it)
+      {
+        n->count += 1 + it->second->count;
+        same = same && reused
+          && prev->children.find(it->first)->second == it->second;
+      }
+      return same ? prev : node_ptr(n);
+    }
+
+    //  The entries of unchanged directory prev, for n: only subdirectories are looked
+    //  at. Returns: false, having changed nothing, if a subdirectory turns out to be no
+    //  longer there, so the directory must be read after all.
+    bool reuse_entries(const node& prev, node& n, const path& abs, const path& rel)
+    {
+      std::vector<std::pair<children_type::const_iterator, scan_entry> > subdirs;
+      for (children_type::const_iterator it = prev.children.begin();
+        it != prev.children.end(); ++it)
+      {
+        if (it->second->entry.type != file_type::directory)
+          continue;
+        scan_entry e;
+        if (read_entry(abs / it->first, e) != 0 || e.type != file_type::directory)
+          return false;
+        subdirs.push_back(std::make_pair(it, e));
+      }
+
+      n.children = prev.children;
+      for (std::size_t i = 0; i < subdirs.size(); ++i)
+      {
+        const path::string_type& name = subdirs[i].first->first;
+        const node_ptr& prev_child = subdirs[i].first->second;
+        const scan_entry& e = subdirs[i].second;
+        if (differs(prev_child->entry, e))
+          emit(scan_change::modified, rel / name);
+        n.children[name] = directory(prev_child, abs / name, rel / name, e);
+      }
+      return true;
+    }
+
+    void read_entries(const node_ptr& prev, node& n, const path& abs, const path& rel)
+    {
+      error_code ec;
+      for (fs::directory_iterator it(abs, ec), end; !ec && it != end; it.increment(ec))
+      {
+        path::string_type name(it->filename().native());
+        path child_rel(rel / name);
+        scan_entry e;
+        if (read_entry(it->path(), e) != 0)
+          continue;  // removed meanwhile
+
+        node_ptr prev_child;
+        if (prev)
+        {
+          children_type::const_iterator found = prev->children.find(name);
+          if (found != prev->children.end())
+            prev_child = found->second;
+        }
+        if (prev_child && prev_child->entry.type != e.type)
+        {
+          emit_removed(*prev_child, child_rel);
+          prev_child.reset();
+        }
+
+        if (!prev_child)
+          emit(scan_change::added, child_rel);
+        else if (differs(prev_child->entry, e))
+          emit(scan_change::modified, child_rel);
+
+        if (e.type == file_type::directory)
+          n.children[name] = directory(prev_child, it->path(), child_rel, e);
+        else
+          n.children[name] = prev_child && !differs(prev_child->entry, e)
+            ? prev_child : leaf(e);
+      }
+
+      if (!prev)
+      {
+        if (ec)
+          n.racy = true;
+        return;
+      }
+      for (children_type::const_iterator it = prev->children.begin();
+        it != prev->children.end(); ++it)
+      {
+        if (n.children.find(it->first) != n.children.end())
+          continue;
+        if (ec)  // cannot tell; keep it and try again next time
+          n.children.insert(*it);
+        else
+          emit_removed(*it->second, rel / it->first);
+      }
+      if (ec)
+        n.racy = true;
+    }
+  };
+
+  fs::scan_result run(const path& root, const node_ptr& prev,
+    std::vector<scan_change>* changes, error_code* ec, const char* message)
+  {
+    scanner s;
+    s.changes = changes;
+    s.racy_after = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count() - racy_window_ns;
+
+    scan_entry e;
+    if (error(read_entry(root, e), root, ec, message))
+      return fs::scan_result();
+
+    node_ptr top;
+    if (e.type == file_type::directory)
+      top = s.directory(prev && prev->entry.type == file_type::directory ? prev : node_ptr(),
+        root, path(), e);
+    else
+      top = s.leaf(e);
+    return fs::scan_result_access::make(root, top);
+  }
+
+  void for_each_below(const node& n, const path& rel,
+    const std::function<void(const path&, const scan_entry&)>& f)
+  {
+    for (children_type::const_iterator it = n.children.begin();
+      it != n.children.end(); ++it)
+    {
+      path child_rel(rel.empty() ? path(it->first) : rel / it->first);
+      f(child_rel, it->second->entry);
+      for_each_below(*it->second, child_rel, f);
+    }
+  }
+}  // unnamed namespace
+
+namespace filesystem8
+{
+  const scan_entry* scan_result::find(const path& relative) const
+  {
+    if (!m_top)
+      return 0;
+    const node* n = m_top.get();
+    for (path::iterator it = relative.begin(); it != relative.end(); ++it)
+    {
+      if (*it == ".")
+        continue;
+      children_type::const_iterator child = n->children.find(it->native());
+      if (child == n->children.end())
+        return 0;
+      n = child->second.get();
+    }
+    return &n->entry;
+  }
+
+  void scan_result::for_each(
+    const std::function<void(const path&, const scan_entry&)>& f) const
+  {
+    if (m_top)
+      for_each_below(*m_top, path(), f);
+  }
+
+namespace detail
+{
+  FILESYSTEM8_EXPORT
+  scan_result scan(const path& root, std::error_code* ec)
+  {
+    return run(root, node_ptr(), 0, ec, "filesystem8::scan");
+  }
+
+  FILESYSTEM8_EXPORT
+  scan_result rescan(const scan_result& previous, std::vector<scan_change>* changes,
+    std::error_code* ec)
+  {
+    FILESYSTEM8_ASSERT_MSG(!previous.empty(), "rescan() of an empty scan_result");
+    return run(previous.root(), scan_result_access::top(previous), changes, ec,
+      "filesystem8::rescan");
+  }
+}  // namespace detail
+}  // namespace filesystem8
@@ -0,0 +1,446 @@
+//  sorted_listing.cpp  ----------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/sorted_listing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <stdlib.h>
+#   include <unistd.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_type;
+using fs::file_status;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+
+namespace
+{
+  typedef path::value_type   value_type;
+  typedef path::string_type  string_type;
+
+  struct record
+  {
+    string_type  name;
+    file_type    type;  // of symlink_status(); none if not known
+  };
+
+  bool record_less(const record& lhs, const record& rhs)
+  {
+    return lhs.name.compare(rhs.name) < 0;  // as path::compare orders filenames
+  }
+
+  //  Memory held by a record besides its name, roughly: allocator overhead and capacity
+  //  slack included
+  const std::size_t record_overhead = sizeof(record) + 16;
+
+  //  The least read buffer per run worth merging with; fewer runs are merged at once
+  //  rather than reading each in smaller pieces
+  const std::size_t min_read_buffer = 64 * 1024;
+  const std::size_t max_fan_in = 256;
+
+  //  A spill file of records, written once and then read once from the start
+  class run_file
+  {
+  public:
+    run_file() : m_file(0), m_pos(0), m_end(0) {}
+    ~run_file()
+    {
+      if (m_file != 0)
+        std::fclose(m_file);
+#     ifndef FILESYSTEM8_POSIX_API
+      if (!m_path.empty())
+        std::remove(m_path.string().c_str());
+#     endif
+    }
+
+    int create(const path& dir)
+    {
+#     ifdef FILESYSTEM8_POSIX_API
+      std::string name((dir / "filesystem8-sort-XXXXXX").native());
+      int fd = ::mkstemp(&name[0]);
+      if (fd < 0)
+        return errno;
+      ::unlink(name.c_str());  // the open file stays usable
+      m_file = ::fdopen(fd, "w+b");
+      if (m_file == 0)
+      {
+        int errnum = errno;
+        ::close(fd);
+        return errnum;
+      }
+#     else
+      static std::atomic<unsigned> counter(0);
+      m_path = dir / ("filesystem8-sort-" + std::to_string(
+        std::chrono::steady_clock::now().time_since_epoch().count()) + "-"
+        + std::to_string(counter.fetch_add(1)));
+      m_file = std::fopen(m_path.string().c_str(), "w+b");
+      if (m_file == 0)
+      {
+        m_path.clear();
+        return errno ? errno : EIO;
+      }
+#     endif
+      return 0;
+    }
+
+    int write(const record& r)
+    {
+      std::uint32_t size = static_cast<std::uint32_t>(r.name.size());
+      unsigned char type = static_cast<unsigned char>(r.type);
+      if (std::fwrite(&size, sizeof(size), 1, m_file) != 1
+        || std::fwrite(&type, 1, 1, m_file) != 1
+        || (size != 0
+          && std::fwrite(r.name.data(), sizeof(value_type), size, m_file) != size))
+        return errno ? errno : EIO;
+      return 0;
+    }
+
+    //  Ends writing; reads then come from the start, buffer_size bytes at a time
+    int rewind(std::size_t buffer_size)
+    {
+      if (std::fflush(m_file) != 0 || std::fseek(m_file, 0, SEEK_SET) != 0)
+        return errno ? errno : EIO;
+      m_buffer.resize(buffer_size);
+      m_pos = m_end = 0;
+      return 0;
+    }
+
+    //  Returns: 0 with eof set at the end of the run, else an errno value
+    int read(record& r, bool& eof)
+    {
+      std::uint32_t size;
+      unsigned char type;
+      if (!fill(&size, sizeof(size), eof) && eof)
+        return 0;
+      if (eof || !fill(&type, 1, eof))
+        return EIO;  // a truncated run
+      r.name.resize(size);
+      r.type = static_cast<file_type>(type);
+      if (size != 0 && !fill(&r.name[0], size * sizeof(value_type), eof))
+        return EIO;
+      return 0;
+    }
+
+  private:
+    std::FILE*         m_file;
+    std::vector<char>  m_buffer;
+    std::size_t        m_pos;  // of the next byte in m_buffer
+    std::size_t        m_end;
+#   ifndef FILESYSTEM8_POSIX_API
+    path               m_path;  // removed once closed
+#   endif
+
+    //  Returns: true if n bytes were copied to p; else eof is set if none were left
+    bool fill(void* p, std::size_t n, bool& eof)
+    {
+      char* to = static_cast<char*>(p);
+      eof = false;
+      for (std::size_t done = 0; done != n;)
+      {
+        if (m_pos == m_end)
+        {
+          m_pos = 0;
+          m_end = std::fread(&m_buffer[0], 1, m_buffer.size(), m_file);
+          if (m_end == 0)
+          {
+            eof = done == 0;
+            return false;
+          }
+        }
+        std::size_t k = std::min(n - done, m_end - m_pos);
+        std::memcpy(to + done, &m_buffer[m_pos], k);
+        m_pos += k;
+        done += k;
+      }
+      return true;
+    }
+  };
+
+  typedef std::vector<std::unique_ptr<run_file> > run_list;
+
+  //  k-way merge of runs by a heap of the run whose next record comes first
+  class merger
+  {
+  public:
+    int start(const run_list& runs, std::size_t first, std::size_t last,
+      std::size_t buffer_size)
+    {
+      for (std::size_t i = first; i != last; ++i)
+      {
+        int errnum = runs[i]->rewind(buffer_size);
+        if (errnum != 0)
+          return errnum;
+        m_runs.push_back(runs[i].get());
+        m_heads.push_back(record());
+        bool eof;
+        if ((errnum = m_runs.back()->read(m_heads.back(), eof)) != 0)
+          return errnum;
+        if (!eof)
+          push(m_runs.size() - 1);
+      }
+      return 0;
+    }
+
+    bool empty() const { return m_heap.empty(); }
+
+    //  Moves the first record to r, and reads the one after it from the same run
+    int pop(record& r)
+    {
+      std::pop_heap(m_heap.begin(), m_heap.end(), after(m_heads));
+      std::size_t i = m_heap.back();
+      m_heap.pop_back();
+      r.name.swap(m_heads[i].name);
+      r.type = m_heads[i].type;
+      bool eof;
+      int errnum = m_runs[i]->read(m_heads[i], eof);
+      if (errnum == 0 && !eof)
+        push(i);
+      return errnum;
+    }
+
+  private:
+    struct after
+    {
+      const std::vector<record>& heads;
+      explicit after(const std::vector<record>& h) : heads(h) {}
+      bool operator()(std::size_t lhs, std::size_t rhs) const
+        { return record_less(heads[rhs], heads[lhs]); }
+    };
+
+    std::vector<run_file*>    m_runs;
+    std::vector<record>       m_heads;  // the next record of each run
+    std::vector<std::size_t>  m_heap;   // of runs not yet at end
+
+    void push(std::size_t i)
+    {
+      m_heap.push_back(i);
+      std::push_heap(m_heap.begin(), m_heap.end(), after(m_heads));
+    }
+  };
+
+  file_status symlink_status_of(const record& r)
+  {
+    return r.type == file_type::none ? file_status() : file_status(r.type);
+  }
+
+  file_status status_of(const record& r)
+  {
+    return r.type == file_type::symlink ? file_status() : symlink_status_of(r);
+  }
+}  // unnamed namespace
+
+namespace filesystem8
+{
+  struct sorted_directory_iterator::imp
+  {
+    sorted_listing_options  options;
+    std::shared_ptr<const path>  dir;
+    directory_entry  entry;
+
+    std::vector<record>  memory;  // sorted, if nothing was spilled
+    std::size_t          next;    // in memory
+    std::size_t          spilled;
+    run_list             runs;
+    merger               merge;
+
+    explicit imp(const sorted_listing_options& o) : options(o), next(0), spilled(0) {}
+
+    //  Returns: the number of runs to merge at once, and sets buffer_size to the read
+    //  buffer of each
+    std::size_t fan_in(std::size_t& buffer_size) const
+    {
+      std::size_t n = options.memory_budget / min_read_buffer;
+      n = std::max<std::size_t>(2, std::min(n, max_fan_in));
+      buffer_size = std::max<std::size_t>(4096, options.memory_budget / n);
+      return n;
+    }
+
+    int spill(const path& temp)
+    {
+      std::sort(memory.begin(), memory.end(), record_less);
+      std::unique_ptr<run_file> run(new run_file);
+      int errnum = run->create(temp);
+      for (std::size_t i = 0; i != memory.size() && errnum == 0; ++i)
+        errnum = run->write(memory[i]);
+      if (errnum != 0)
+        return errnum;
+      runs.push_back(std::move(run));
+      ++spilled;
+      memory.clear();
+      return 0;
+    }
+
+    //  Merges the first runs into a longer one until few enough are left to be merged
+    //  at once
+    int reduce(const path& temp)
+    {
+      std::size_t buffer_size;
+      const std::size_t n = fan_in(buffer_size);
+      while (runs.size() > n)
+      {
+        std::unique_ptr<run_file> run(new run_file);
+        int errnum = run->create(temp);
+        merger m;
+        if (errnum == 0)
+          errnum = m.start(runs, 0, n, buffer_size);
+        record r;
+        while (errnum == 0 && !m.empty())
+          if ((errnum = m.pop(r)) == 0)
+            errnum = run->write(r);
+        if (errnum != 0)
+          return errnum;
+        runs.erase(runs.begin(), runs.begin() + n);  // closes, and so deletes, them
+        runs.push_back(std::move(run));
+      }
+      return merge.start(runs, 0, runs.size(), buffer_size);
+    }
+
+    //  Returns: 0 with the next entry in entry, or with at_end set
+    int advance(bool& at_end)
+    {
+      at_end = false;
+      if (runs.empty())
+      {
+        if (next == memory.size())
+        {
+          at_end = true;
+          return 0;
+        }
+        const record& r = memory[next++];
+        entry.assign(dir, path(r.name), status_of(r), symlink_status_of(r));
+        return 0;
+      }
+
+      if (merge.empty())
+      {
+        at_end = true;
+        return 0;
+      }
+      record r;
+      int errnum = merge.pop(r);
+      entry.assign(dir, path(r.name), status_of(r), symlink_status_of(r));
+      return errnum;
+    }
+
+    int read(const path& dir_path, error_code& ec)
+    {
+      path temp;  // found by the first spill; a listing within the budget needs none
+      std::size_t bytes = 0;
+      for (directory_iterator it(dir_path, options.types, directory_order::native, ec);
+        !ec && it != directory_iterator(); it.increment(ec))
+      {
+        record r;
+        r.name = it->filename().native();
+        error_code type_ec;
+        r.type = it->symlink_status(type_ec).type();
+        if (type_ec)
+          r.type = file_type::none;
+        bytes += record_overhead + r.name.size() * sizeof(value_type);
+        memory.push_back(std::move(r));
+        if (bytes >= options.memory_budget)
+        {
+          if (temp.empty())
+          {
+            temp = options.temp_directory.empty()
+              ? fs::temp_directory_path(ec) : options.temp_directory;
+            if (ec)
+              return 0;
+          }
+          int errnum = spill(temp);
+          if (errnum != 0)
+            return errnum;
+          bytes = 0;
+        }
+      }
+      if (ec)
+        return 0;
+
+      if (runs.empty())
+      {
+        std::sort(memory.begin(), memory.end(), record_less);
+        return 0;
+      }
+      int errnum = memory.empty() ? 0 : spill(temp);
+      std::vector<record>().swap(memory);
+      return errnum != 0 ? errnum : reduce(temp);
+    }
+  };
+
+  void sorted_directory_iterator::m_construct(const path& dir_path,
+    const sorted_listing_options& options, std::error_code* ec)
+  {
+    m_imp.reset(new imp(options));
+    m_imp->dir = std::make_shared<const path>(dir_path);
+
+    error_code result;
+    bool at_end = true;
+    int errnum = m_imp->read(dir_path, result);
+    if (errnum != 0)
+      result.assign(errnum, system_category());
+    if (!result)
+      errnum = m_imp->advance(at_end);
+    if (errnum != 0)
+      result.assign(errnum, system_category());
+    if (result || at_end)
+      m_imp.reset();
+
+    if (result)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error("filesystem8::sorted_directory_iterator",
+          dir_path, result));
+      *ec = result;
+    }
+    else if (ec != 0)
+      ec->clear();
+  }
+
+  void sorted_directory_iterator::m_increment(std::error_code* ec)
+  {
+    FILESYSTEM8_ASSERT_MSG(m_imp.get(), "increment of end sorted_directory_iterator");
+
+    bool at_end;
+    int errnum = m_imp->advance(at_end);
+    if (errnum != 0)
+    {
+      std::shared_ptr<const path> dir(m_imp->dir);
+      m_imp.reset();
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error("filesystem8::sorted_directory_iterator",
+          *dir, error_code(errnum, system_category())));
+      ec->assign(errnum, system_category());
+      return;
+    }
+    if (at_end)
+      m_imp.reset();  // done, so make end iterator
+    if (ec != 0)
+      ec->clear();
+  }
+
+  std::size_t sorted_directory_iterator::runs() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp ? m_imp->spilled : 0;
+  }
+
+  sorted_directory_iterator::reference sorted_directory_iterator::dereference() const
+  {
+    FILESYSTEM8_ASSERT_MSG(m_imp.get(), "dereference of end sorted_directory_iterator");
+    return m_imp->entry;
+  }
+}  // namespace filesystem8
@@ -0,0 +1,576 @@
+//  tree_cache.cpp  --------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/tree_cache.hpp>
+#include "helpers.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#   define FILESYSTEM8_TREE_CACHE_INOTIFY
+#   include <sys/inotify.h>
+#   include <poll.h>
+#   include <fcntl.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_status;
+using fs::file_type;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+using fs::detail::error;
+#ifdef FILESYSTEM8_POSIX_API
+using fs::detail::type_of;
+#endif
+
+namespace
+{
+  struct node
+  {
+    file_status        symlink_stat;
+    std::uintmax_t     size;        // regular files only
+    std::time_t        mtime;
+    node*              parent;      // 0 for the root
+    path::string_type  name;
+    int                wd;          // inotify watch of a directory, or -1
+    bool               listed;      // children are known; if not, ask the filesystem
+    std::map<path::string_type, std::unique_ptr<node> >  children;
+
+    node() : size(0), mtime(0), parent(0), wd(-1), listed(false) {}
+  };
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  //  Reads the metadata of p into n with a single lstat()
+  int read_node(const path& p, node& n)
+  {
+    struct stat st;
+    if (::lstat(p.c_str(), &st) != 0)
+      return errno;
+    n.symlink_stat = file_status(type_of(st.st_mode),
+      static_cast<fs::perms>(st.st_mode) & fs::perms::mask);
+    n.size = S_ISREG(st.st_mode) ? static_cast<std::uintmax_t>(st.st_size) : 0;
+    n.mtime = st.st_mtime;
+    return 0;
+  }
+
+# else
+
+  int read_node(const path& p, node& n)
+  {
+    error_code ec;
+    n.symlink_stat = fs::detail::symlink_status(p, &ec);
+    if (ec)
+      return ec.value();
+    n.size = fs::is_regular_file(n.symlink_stat) ? fs::detail::file_size(p, &ec) : 0;
+    n.mtime = fs::detail::last_write_time(p, &ec);
+    return ec.value();
+  }
+
+# endif
+
+  path node_path(const path& root, const node* n)
+  {
+    std::vector<const node*> chain;
+    for (; n->parent != 0; n = n->parent)
+      chain.push_back(n);
+    path p(root);
+    for (std::vector<const node*>::reverse_iterator it = chain.rbegin();
+      it != chain.rend(); ++it)
+      p /= (*it)->name;
+    return p;
+  }
+
+  bool is_dot(const path& p)
+  {
+    return p.native().size() == 1 && p.native()[0] == '.';
+  }
+}  // unnamed namespace
+
+namespace filesystem8
+{
+
+//--------------------------------------------------------------------------------------//
+//                                  tree_cache::imp                                     //
+//--------------------------------------------------------------------------------------//
+
+  struct tree_cache::imp
+  {
+    path                   root;
+    mutable std::mutex     mutex;  // guards the members below
+    std::unique_ptr<node>  top;    // 0 if not read; all queries then go to the filesystem
+    std::unordered_map<int, node*>  watches;
+    int                    inotify_fd;
+    int                    wake_fd[2];  // written to stop the watcher
+    std::thread            watcher;
+
+    explicit imp(const path& p) : root(p), inotify_fd(-1)
+      { wake_fd[0] = wake_fd[1] = -1; }
+
+    //  Also when the constructor of tree_cache throws, which ~tree_cache() then misses
+    ~imp() { stop_watching(); }
+
+    enum lookup_result { found, missing, unknown };
+
+    //  Finds the node for p. unknown means p is not below root, or that a directory on
+    //  the way has not been listed, so only the filesystem can tell.
+    lookup_result lookup(const path& p, const node*& n) const
+    {
+      if (!top)
+        return unknown;
+      path rel(p.lexically_relative(root));
+      if (rel.empty())
+        return unknown;
+
+      n = top.get();
+      for (path::iterator it = rel.begin(); it != rel.end(); ++it)
+      {
+        if (is_dot(*it))
+          continue;
+        if (*it == "..")
+          return unknown;
+        if (!n->listed)
+          return is_directory(n->symlink_stat) ? unknown : missing;
+        std::map<path::string_type, std::unique_ptr<node> >::const_iterator child
+          = n->children.find(it->native());
+        if (child == n->children.end())
+          return missing;
+        n = child->second.get();
+      }
+      return found;
+    }
+
+    //  Reads the tree below dir, whose path is p. Errors other than for root itself
+    //  leave the directory concerned unlisted.
+    void list(node& dir, const path& p)
+    {
+      dir.listed = false;
+      dir.children.clear();
+      if (!watch(dir, p))
+        return;
+
+      error_code ec;
+      for (directory_iterator it(p, ec), end; !ec && it != end; it.increment(ec))
+      {
+        std::unique_ptr<node> child(new node);
+        child->parent = &dir;
+        child->name = it->filename().native();
+        if (read_node(it->path(), *child) != 0)
+          continue;  // removed meanwhile; if replaced, an event follows
+        if (is_directory(child->symlink_stat))
+          list(*child, it->path());
+        dir.children[child->name] = std::move(child);
+      }
+      if (ec)
+        unwatch(dir);
+      else
+        dir.listed = true;
+    }
+
+    //  Returns: false if dir cannot be kept current, so must not be listed
+    bool watch(node& dir, const path& p)
+    {
+#     ifdef FILESYSTEM8_TREE_CACHE_INOTIFY
+      if (inotify_fd < 0)
+        return true;
+      int wd = ::inotify_add_watch(inotify_fd, p.c_str(),
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_MODIFY
+        | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW
+        | IN_EXCL_UNLINK);
+      if (wd < 0)
+        return false;  // typically ENOSPC, out of watches
+      dir.wd = wd;
+      watches[wd] = &dir;
+#     else
+      (void)dir; (void)p;
+#     endif
+      return true;
+    }
+
+    void unwatch(node& dir)
+    {
+#     ifdef FILESYSTEM8_TREE_CACHE_INOTIFY
+      if (dir.wd >= 0)
+      {
+        ::inotify_rm_watch(inotify_fd, dir.wd);
+        watches.erase(dir.wd);
+        dir.wd = -1;
+      }
+#     endif
+    }
+
+    void unwatch_tree(node& n)
+    {
+      unwatch(n);
+      for (std::map<path::string_type, std::unique_ptr<node> >::iterator it
+        = n.children.begin(); it != n.children.end(); ++it)
+        unwatch_tree(*it->second);
+    }
+
+    int read_tree()
+    {
+      if (top)
+        unwatch_tree(*top);
+      top.reset();
+      watches.clear();
+
+      std::unique_ptr<node> n(new node);
+      int err = read_node(root, *n);
+      if (err != 0)
+        return err;
+      top = std::move(n);
+      if (is_directory(top->symlink_stat))
+        list(*top, root);
+      return 0;
+    }
+
+#   ifdef FILESYSTEM8_TREE_CACHE_INOTIFY
+
+    //  (Re)reads entry name of dir, or forgets it if it no longer exists
+    void update_child(node& dir, const path::string_type& name, bool relist)
+    {
+      path p(node_path(root, &dir) / name);
+      std::unique_ptr<node>& slot = dir.children[name];
+      if (slot && relist)
+      {
+        unwatch_tree(*slot);
+        slot.reset();
+      }
+      if (!slot)
+      {
+        slot.reset(new node);
+        slot->parent = &dir;
+        slot->name = name;
+      }
+      if (read_node(p, *slot) != 0)
+      {
+        unwatch_tree(*slot);
+        dir.children.erase(name);
+        return;
+      }
+      if (relist && is_directory(slot->symlink_stat))
+        list(*slot, p);
+    }
+
+    void remove_child(node& dir, const path::string_type& name)
+    {
+      std::map<path::string_type, std::unique_ptr<node> >::iterator it
+        = dir.children.find(name);
+      if (it == dir.children.end())
+        return;
+      unwatch_tree(*it->second);
+      dir.children.erase(it);
+    }
+
+    void apply(const struct inotify_event& ev)
+    {
+      if (ev.mask & IN_Q_OVERFLOW)
+      {
+        read_tree();
+        return;
+      }
+
+      std::unordered_map<int, node*>::iterator w = watches.find(ev.wd);
+      if (w == watches.end())
+        return;
+      node& dir = *w->second;
+
+      if (ev.mask & IN_IGNORED)
+      {
+        dir.wd = -1;
+        dir.listed = false;  // no longer kept current
+        watches.erase(w);
+        return;
+      }
+
+      if (ev.len == 0)  // event on dir itself; its parent reports it for others
+      {
+        if (&dir == top.get())
+        {
+          if (ev.mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+          {
+            unwatch_tree(*top);
+            top.reset();
+          }
+          else
+            read_node(root, *top);
+        }
+        return;
+      }
+
+      path::string_type name(ev.name);
+      if (ev.mask & (IN_DELETE | IN_MOVED_FROM))
+        remove_child(dir, name);
+      else if (ev.mask & (IN_CREATE | IN_MOVED_TO))
+        update_child(dir, name, true);
+      else
+        update_child(dir, name, false);
+
+      if (ev.mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+        read_node(node_path(root, &dir), dir);  // its last write time changed
+    }
+
+    void watch_loop()
+    {
+      union
+      {
+        struct inotify_event  event;
+        char                  bytes[64 * 1024];
+      } buf;
+      struct pollfd fds[2];
+      fds[0].fd = inotify_fd;
+      fds[0].events = POLLIN;
+      fds[1].fd = wake_fd[0];
+      fds[1].events = POLLIN;
+
+      for (;;)
+      {
+        if (::poll(fds, 2, -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return;
+        }
+        if (fds[1].revents != 0)
+          return;
+
+        ssize_t n = ::read(inotify_fd, buf.bytes, sizeof(buf.bytes));
+        if (n <= 0)
+        {
+          if (n < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+          return;
+        }
+
+        std::lock_guard<std::mutex> lk(mutex);
+        for (char* p = buf.bytes; p < buf.bytes + n; )
+        {
+          const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(p);
+          apply(*ev);
+          p += sizeof(struct inotify_event) + ev->len;
+        }
+      }
+    }
+
+    void start_watching()
+    {
+      inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (inotify_fd < 0)
+        return;
+      if (::pipe2(wake_fd, O_CLOEXEC) != 0)
+      {
+        ::close(inotify_fd);
+        inotify_fd = -1;
+      }
+    }
+
+    void stop_watching()
+    {
+      if (watcher.joinable())
+      {
+        char c = 0;
+        while (::write(wake_fd[1], &c, 1) < 0 && errno == EINTR) {}
+        watcher.join();
+      }
+      for (int i = 0; i < 2; ++i)
+        if (wake_fd[i] >= 0)
+        {
+          ::close(wake_fd[i]);
+          wake_fd[i] = -1;
+        }
+      if (inotify_fd >= 0)
+      {
+        ::close(inotify_fd);  // removes all watches
+        inotify_fd = -1;
+      }
+    }
+
+#   else
+
+    void start_watching() {}
+    void stop_watching() {}
+
+#   endif
+  };
+
+//--------------------------------------------------------------------------------------//
+//                                    tree_cache                                        //
+//--------------------------------------------------------------------------------------//
+
+  tree_cache::tree_cache(const path& root)
+    : m_imp(new imp(root))
+  {
+    m_imp->start_watching();
+    error(m_imp->read_tree(), root, 0, "filesystem8::tree_cache");
+#   ifdef FILESYSTEM8_TREE_CACHE_INOTIFY
+    if (m_imp->inotify_fd >= 0)
+      m_imp->watcher = std::thread(&imp::watch_loop, m_imp.get());
+#   endif
+  }
+
+  tree_cache::tree_cache(const path& root, std::error_code& ec)
+    : m_imp(new imp(root))
+  {
+    m_imp->start_watching();
+    if (error(m_imp->read_tree(), root, &ec, "filesystem8::tree_cache"))
+      return;
+#   ifdef FILESYSTEM8_TREE_CACHE_INOTIFY
+    if (m_imp->inotify_fd >= 0)
+      m_imp->watcher = std::thread(&imp::watch_loop, m_imp.get());
+#   endif
+  }
+
+  tree_cache::~tree_cache() {}
+
+  const path& tree_cache::root() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->root;
+  }
+
+  bool tree_cache::is_live() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->watcher.joinable();
+  }
+
+  void tree_cache::m_refresh(std::error_code* ec)
+  {
+    int err;
+    {
+      std::lock_guard<std::mutex> lk(m_imp->mutex);
+      err = m_imp->read_tree();
+    }
+    error(err, m_imp->root, ec, "filesystem8::tree_cache::refresh");
+  }
+
+  file_status tree_cache::m_status(const path& p, bool symlink, std::error_code* ec) const
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_imp->mutex);
+      const node* n = 0;
+      switch (m_imp->lookup(p, n))
+      {
+      case imp::found:
+        if (!symlink && is_symlink(n->symlink_stat))
+          break;
+        if (ec != 0)
+          ec->clear();
+        return n->symlink_stat;
+      case imp::missing:
+        if (ec != 0)  // as detail::status(), report ENOENT although it is no error
+          ec->assign(ENOENT, system_category());
+        return file_status(file_type::not_found, perms::none);
+      case imp::unknown:
+        break;
+      }
+    }
+    return symlink ? detail::symlink_status(p, ec) : detail::status(p, ec);
+  }
+
+  std::uintmax_t tree_cache::m_file_size(const path& p, std::error_code* ec) const
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_imp->mutex);
+      const node* n = 0;
+      switch (m_imp->lookup(p, n))
+      {
+      case imp::found:
+        if (is_symlink(n->symlink_stat))
+          break;
+        if (error(!is_regular_file(n->symlink_stat) ? EPERM : 0,
+            p, ec, "filesystem8::tree_cache::file_size"))
+          return static_cast<std::uintmax_t>(-1);
+        return n->size;
+      case imp::missing:
+        error(ENOENT, p, ec, "filesystem8::tree_cache::file_size");
+        return static_cast<std::uintmax_t>(-1);
+      case imp::unknown:
+        break;
+      }
+    }
+    return detail::file_size(p, ec);
+  }
+
+  std::time_t tree_cache::m_last_write_time(const path& p, std::error_code* ec) const
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_imp->mutex);
+      const node* n = 0;
+      switch (m_imp->lookup(p, n))
+      {
+      case imp::found:
+        if (is_symlink(n->symlink_stat))
+          break;
+        if (ec != 0)
+          ec->clear();
+        return n->mtime;
+      case imp::missing:
+        error(ENOENT, p, ec, "filesystem8::tree_cache::last_write_time");
+        return std::time_t(-1);
+      case imp::unknown:
+        break;
+      }
+    }
+    return detail::last_write_time(p, ec);
+  }
+
+  std::vector<directory_entry> tree_cache::m_list(const path& dir,
+    std::error_code* ec) const
+  {
+    std::vector<directory_entry> result;
+    {
+      std::lock_guard<std::mutex> lk(m_imp->mutex);
+      const node* n = 0;
+      switch (m_imp->lookup(dir, n))
+      {
+      case imp::found:
+        if (is_symlink(n->symlink_stat) || (is_directory(n->symlink_stat) && !n->listed))
+          break;
+        if (error(!is_directory(n->symlink_stat) ? ENOTDIR : 0,
+            dir, ec, "filesystem8::tree_cache::list"))
+          return result;
+        result.reserve(n->children.size());
+        for (std::map<path::string_type, std::unique_ptr<node> >::const_iterator it
+          = n->children.begin(); it != n->children.end(); ++it)
+        {
+          const file_status& st = it->second->symlink_stat;
+          result.push_back(directory_entry(dir / it->first,
+            is_symlink(st) ? file_status() : st, st));
+        }
+        return result;
+      case imp::missing:
+        error(ENOENT, dir, ec, "filesystem8::tree_cache::list");
+        return result;
+      case imp::unknown:
+        break;
+      }
+    }
+
+    std::error_code local_ec;
+    for (directory_iterator it(dir, local_ec), end; !local_ec && it != end;
+      it.increment(local_ec))
+      result.push_back(*it);
+    if (error(local_ec.value(), dir, ec, "filesystem8::tree_cache::list"))
+      return std::vector<directory_entry>();
+    std::sort(result.begin(), result.end(),
+      [](const directory_entry& lhs, const directory_entry& rhs)
+        { return lhs.filename() < rhs.filename(); });
+    return result;
+  }
+
+}  // namespace filesystem8
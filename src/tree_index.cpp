@@ -0,0 +1,507 @@
+//  tree_index.cpp  --------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+#include <filesystem8/tree_index.hpp>
+#include "helpers.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#else
+#   include <fstream>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_type;
+using fs::tree_index_entry;
+using fs::filesystem_error;
+using std::error_code;
+using std::system_category;
+using fs::detail::error;
+#ifdef FILESYSTEM8_POSIX_API
+using fs::detail::type_of;
+#endif
+
+namespace
+{
+  typedef path::value_type     value_type;
+  typedef path::string_type    string_type;
+  typedef std::char_traits<value_type>  traits;
+
+  const char           index_magic[8] = {'F', 'S', '8', 'T', 'I', 'D', 'X', '\0'};
+  const std::uint32_t  index_version = 2;
+  const std::uint32_t  index_byte_order = 0x01020304;
+
+  struct index_header
+  {
+    char           magic[8];
+    std::uint32_t  version;
+    std::uint32_t  byte_order;
+    std::uint32_t  value_size;    // sizeof(path::value_type) of the writer
+    std::uint32_t  entry_size;    // sizeof(tree_index_entry) of the writer
+    std::uint64_t  entry_count;   // including the root
+    std::uint64_t  string_count;  // in path::value_type units
+    std::uint64_t  root_size;     // the root path comes first in the string table
+    std::int64_t   walk_start_ns; // when the walk of root began, since the epoch
+  };
+
+  static_assert(sizeof(index_header) % 8 == 0 && sizeof(tree_index_entry) % 8 == 0,
+    "entries and string table must stay aligned");
+
+  //  The part of a tree_index_entry known before the tree is laid out
+  struct pending_entry
+  {
+    std::uint32_t     parent;  // in walk order
+    string_type       name;
+    tree_index_entry  e;
+  };
+
+# ifdef FILESYSTEM8_POSIX_API
+
+  int read_entry(const path& p, tree_index_entry& e)
+  {
+    struct stat st;
+    if (::lstat(p.c_str(), &st) != 0)
+      return errno;
+    e.kind = static_cast<std::uint8_t>(type_of(st.st_mode));
+    e.mode = static_cast<std::uint16_t>(st.st_mode & static_cast<mode_t>(fs::perms::mask));
+    e.size = S_ISREG(st.st_mode) ? static_cast<std::uint64_t>(st.st_size) : 0;
+#   if defined(__APPLE__)
+    const struct timespec& ts = st.st_mtimespec;
+#   else
+    const struct timespec& ts = st.st_mtim;
+#   endif
+    e.mtime_ns = static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    return 0;
+  }
+
+  int write_file(const path& p, const std::vector<const void*>& data,
+    const std::vector<std::size_t>& sizes)
+  {
+    int fd = ::open(p.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+      return errno;
+    int result = 0;
+    for (std::size_t i = 0; i < data.size() && !result; ++i)
+    {
+      const char* buf = static_cast<const char*>(data[i]);
+      for (std::size_t left = sizes[i]; left != 0;)
+      {
+        ssize_t n = ::write(fd, buf, left);
+        if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          result = errno;
+          break;
+        }
+        buf += n;
+        left -= static_cast<std::size_t>(n);
+      }
+    }
+    if (::close(fd) != 0 && !result)
+      result = errno;
+    return result;
+  }
+
+# else
+
+  int read_entry(const path& p, tree_index_entry& e)
+  {
+    error_code ec;
+    fs::file_status st = fs::detail::symlink_status(p, &ec);
+    if (ec)
+      return ec.value();
+    e.kind = static_cast<std::uint8_t>(st.type());
+    e.mode = static_cast<std::uint16_t>(st.permissions());
+    e.size = fs::is_regular_file(st) ? fs::detail::file_size(p, &ec) : 0;
+    e.mtime_ns = static_cast<std::int64_t>(fs::detail::last_write_time(p, &ec)) * 1000000000;
+    return ec.value();
+  }
+
+  int write_file(const path& p, const std::vector<const void*>& data,
+    const std::vector<std::size_t>& sizes)
+  {
+    std::ofstream f(p.c_str(), std::ios_base::binary | std::ios_base::trunc);
+    for (std::size_t i = 0; i < data.size() && f; ++i)
+      f.write(static_cast<const char*>(data[i]), static_cast<std::streamsize>(sizes[i]));
+    f.close();
+    return f ? 0 : EIO;
+  }
+
+# endif
+
+  bool name_less(const value_type* lhs, std::size_t lhs_size,
+    const value_type* rhs, std::size_t rhs_size)
+  {
+    int cmp = traits::compare(lhs, rhs, std::min(lhs_size, rhs_size));
+    return cmp < 0 || (cmp == 0 && lhs_size < rhs_size);
+  }
+
+  //  Lays out entries, in walk order, breadth first with the entries of each directory
+  //  sorted by name, and fills in the links and the string table
+  void lay_out(const string_type& root, std::vector<pending_entry>& entries,
+    std::vector<tree_index_entry>& out, string_type& strings)
+  {
+    std::vector<std::uint32_t> by_parent(entries.size() - 1);
+    for (std::uint32_t i = 1; i < entries.size(); ++i)
+      by_parent[i - 1] = i;
+    std::sort(by_parent.begin(), by_parent.end(),
+      [&](std::uint32_t lhs, std::uint32_t rhs)
+      {
+        if (entries[lhs].parent != entries[rhs].parent)
+          return entries[lhs].parent < entries[rhs].parent;
+        return entries[lhs].name < entries[rhs].name;
+      });
+
+    // where the entries of each directory start in by_parent
+    std::vector<std::uint32_t> first(entries.size() + 1, 0);
+    for (std::size_t i = 0; i < by_parent.size(); ++i)
+      ++first[entries[by_parent[i]].parent + 1];
+    for (std::size_t i = 1; i < first.size(); ++i)
+      first[i] += first[i - 1];
+
+    strings = root;
+    std::vector<std::uint32_t> order(1, 0);  // walk order number of each output entry
+    order.reserve(entries.size());
+    out.resize(entries.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i)
+    {
+      pending_entry& p = entries[order[i]];
+      tree_index_entry& e = out[i];
+      e = p.e;
+      e.first_child = static_cast<std::uint32_t>(order.size());
+      e.child_count = first[order[i] + 1] - first[order[i]];
+      e.name_offset = strings.size();
+      e.name_size = static_cast<std::uint32_t>(p.name.size());
+      strings += p.name;
+      string_type().swap(p.name);
+      for (std::uint32_t j = first[order[i]]; j != first[order[i] + 1]; ++j)
+      {
+        entries[by_parent[j]].parent = i;  // now in output order
+        order.push_back(by_parent[j]);
+      }
+      e.parent = p.parent;
+    }
+  }
+}  // unnamed namespace
+
+namespace filesystem8
+{
+  struct tree_index::imp
+  {
+    path                     root;
+    const char*              data;
+    std::size_t              length;
+    const tree_index_entry*  entries;
+    std::uint64_t            entry_count;
+    const value_type*        strings;
+    std::uint64_t            string_count;
+    std::int64_t             walk_start_ns;
+#   ifndef FILESYSTEM8_POSIX_API
+    std::vector<std::uint64_t>  buffer;
+#   endif
+
+    imp() : data(0), length(0), entries(0), entry_count(0), strings(0), string_count(0),
+      walk_start_ns(0) {}
+    ~imp()
+    {
+#     ifdef FILESYSTEM8_POSIX_API
+      if (data != 0)
+        ::munmap(const_cast<char*>(data), length);
+#     endif
+    }
+
+    //  The index is not checked as a whole when it is opened, as that would read all of
+    //  it; entries that point outside of it read as empty instead
+
+    bool name(const tree_index_entry& e, const value_type*& s, std::size_t& n) const
+    {
+      if (e.name_offset > string_count || e.name_size > string_count - e.name_offset)
+        return false;
+      s = strings + e.name_offset;
+      n = e.name_size;
+      return true;
+    }
+
+    tree_index::range children(const tree_index_entry& e) const
+    {
+      if (e.type() != file_type::directory || e.first_child > entry_count
+        || e.child_count > entry_count - e.first_child)
+        return tree_index::range(entries, entries);
+      return tree_index::range(entries + e.first_child,
+        entries + e.first_child + e.child_count);
+    }
+  };
+
+  tree_index::tree_index(const path& index_file)
+    : m_imp(new imp)
+  {
+    m_open(index_file, 0);
+  }
+
+  tree_index::tree_index(const path& index_file, std::error_code& ec)
+    : m_imp(new imp)
+  {
+    m_open(index_file, &ec);
+  }
+
+  tree_index::~tree_index() {}
+
+  void tree_index::m_open(const path& index_file, std::error_code* ec)
+  {
+    const char* const message = "filesystem8::tree_index";
+
+#   ifdef FILESYSTEM8_POSIX_API
+    int fd = ::open(index_file.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      error(errno, index_file, ec, message);
+      return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+      int errnum = errno;
+      ::close(fd);
+      error(errnum, index_file, ec, message);
+      return;
+    }
+    if (static_cast<std::uintmax_t>(st.st_size) < sizeof(index_header))
+    {
+      ::close(fd);
+      error(EINVAL, index_file, ec, message);
+      return;
+    }
+    void* mapping = ::mmap(0, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED,
+      fd, 0);
+    int errnum = errno;
+    ::close(fd);  // the mapping stays valid
+    if (mapping == MAP_FAILED)
+    {
+      error(errnum, index_file, ec, message);
+      return;
+    }
+    m_imp->data = static_cast<const char*>(mapping);
+    m_imp->length = static_cast<std::size_t>(st.st_size);
+#   else
+    std::ifstream f(index_file.c_str(), std::ios_base::binary);
+    f.seekg(0, std::ios_base::end);
+    std::streamoff size = f ? static_cast<std::streamoff>(f.tellg()) : 0;
+    if (!f || size < static_cast<std::streamoff>(sizeof(index_header)))
+    {
+      error(f ? EINVAL : ENOENT, index_file, ec, message);
+      return;
+    }
+    m_imp->buffer.resize((static_cast<std::size_t>(size) + 7) / 8);
+    f.seekg(0);
+    f.read(reinterpret_cast<char*>(&m_imp->buffer[0]), size);
+    if (!f)
+    {
+      error(EIO, index_file, ec, message);
+      return;
+    }
+    m_imp->data = reinterpret_cast<const char*>(&m_imp->buffer[0]);
+    m_imp->length = static_cast<std::size_t>(size);
+#   endif
+
+    index_header h;
+    std::memcpy(&h, m_imp->data, sizeof(h));
+    std::uint64_t entries_length = m_imp->length - sizeof(h);
+    if (std::memcmp(h.magic, index_magic, sizeof(index_magic)) != 0
+      || h.version != index_version || h.byte_order != index_byte_order
+      || h.value_size != sizeof(value_type) || h.entry_size != sizeof(tree_index_entry)
+      || h.entry_count == 0
+      || h.entry_count > entries_length / sizeof(tree_index_entry)
+      || h.string_count != (entries_length - h.entry_count * sizeof(tree_index_entry))
+        / sizeof(value_type)
+      || h.root_size > h.string_count)
+    {
+      error(EINVAL, index_file, ec, message);
+      return;
+    }
+
+    m_imp->entries = reinterpret_cast<const tree_index_entry*>(m_imp->data + sizeof(h));
+    m_imp->entry_count = h.entry_count;
+    m_imp->strings = reinterpret_cast<const value_type*>(m_imp->data + sizeof(h)
+      + h.entry_count * sizeof(tree_index_entry));
+    m_imp->string_count = h.string_count;
+    m_imp->walk_start_ns = h.walk_start_ns;
+    m_imp->root = string_type(m_imp->strings, static_cast<std::size_t>(h.root_size));
+    if (ec != 0)
+      ec->clear();
+  }
+
+  const path& tree_index::root() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->root;
+  }
+
+  file_time_type tree_index::walk_start() const FILESYSTEM8_NOEXCEPT
+  {
+    return file_time_type(std::chrono::nanoseconds(m_imp->walk_start_ns));
+  }
+
+  std::size_t tree_index::size() const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->entry_count == 0 ? 0 : static_cast<std::size_t>(m_imp->entry_count - 1);
+  }
+
+  const tree_index_entry* tree_index::find(const path& relative) const
+  {
+    if (m_imp->entry_count == 0)
+      return 0;
+    const tree_index_entry* e = m_imp->entries;
+    for (path::iterator it = relative.begin(); it != relative.end(); ++it)
+    {
+      if (*it == ".")
+        continue;
+      const string_type& name = it->native();
+      range r(m_imp->children(*e));
+      const tree_index_entry* found = std::lower_bound(r.first, r.second, name,
+        [&](const tree_index_entry& lhs, const string_type& rhs)
+        {
+          const value_type* s = 0;
+          std::size_t n = 0;
+          m_imp->name(lhs, s, n);
+          return name_less(s, n, rhs.data(), rhs.size());
+        });
+      const value_type* s = 0;
+      std::size_t n = 0;
+      if (found == r.second || !m_imp->name(*found, s, n)
+        || n != name.size() || traits::compare(s, name.data(), n) != 0)
+        return 0;
+      e = found;
+    }
+    return e;
+  }
+
+  tree_index::range tree_index::list(const tree_index_entry& e) const FILESYSTEM8_NOEXCEPT
+  {
+    return m_imp->children(e);
+  }
+
+  path tree_index::filename(const tree_index_entry& e) const
+  {
+    const value_type* s = 0;
+    std::size_t n = 0;
+    if (&e == m_imp->entries || !m_imp->name(e, s, n))
+      return path();
+    return path(string_type(s, n));
+  }
+
+  path tree_index::relative_path(const tree_index_entry& e) const
+  {
+    std::vector<const tree_index_entry*> chain;
+    for (const tree_index_entry* p = &e; p != m_imp->entries
+      && chain.size() < m_imp->entry_count && p->parent < m_imp->entry_count;
+      p = m_imp->entries + p->parent)
+      chain.push_back(p);
+
+    path result;
+    for (std::size_t i = chain.size(); i != 0; --i)
+      result /= filename(*chain[i - 1]);
+    return result;
+  }
+
+namespace detail
+{
+  FILESYSTEM8_EXPORT
+  void write_tree_index(const path& root, const path& index_file, std::error_code* ec)
+  {
+    const char* const message = "filesystem8::write_tree_index";
+    const std::int64_t walk_start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::vector<pending_entry> entries(1);
+    std::memset(&entries[0].e, 0, sizeof(tree_index_entry));
+    if (error(read_entry(root, entries[0].e), root, ec, message))
+      return;
+    entries[0].parent = 0;
+
+    error_code walk_ec;
+    if (entries[0].e.type() == file_type::directory)
+    {
+      std::vector<std::uint32_t> parents(1, 0);  // the directory at each depth
+      for (recursive_directory_iterator it(root, walk_ec), end;
+        !walk_ec && it != end; it.increment(walk_ec))
+      {
+        if (entries.size() == std::numeric_limits<std::uint32_t>::max())
+        {
+          walk_ec.assign(EOVERFLOW, system_category());
+          break;
+        }
+        pending_entry p;
+        std::memset(&p.e, 0, sizeof(tree_index_entry));
+        if (read_entry(it->path(), p.e) != 0)
+          continue;  // removed meanwhile
+        parents.resize(it.level() + 1);
+        p.parent = parents.back();
+        p.name = it->filename().native();
+        entries.push_back(std::move(p));
+        if (entries.back().e.type() == file_type::directory)
+          parents.push_back(static_cast<std::uint32_t>(entries.size() - 1));
+      }
+    }
+    if (walk_ec)
+    {
+      if (ec == 0)
+        FILESYSTEM8_THROW(filesystem_error(message, root, walk_ec));
+      *ec = walk_ec;
+      return;
+    }
+
+    std::vector<tree_index_entry> out;
+    string_type strings;
+    lay_out(root.native(), entries, out, strings);
+    std::vector<pending_entry>().swap(entries);
+
+    index_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, index_magic, sizeof(index_magic));
+    h.version = index_version;
+    h.byte_order = index_byte_order;
+    h.value_size = sizeof(value_type);
+    h.entry_size = sizeof(tree_index_entry);
+    h.entry_count = out.size();
+    h.string_count = strings.size();
+    h.root_size = root.native().size();
+    h.walk_start_ns = walk_start_ns;
+
+    std::vector<const void*> data;
+    std::vector<std::size_t> sizes;
+    data.push_back(&h);
+    sizes.push_back(sizeof(h));
+    data.push_back(out.data());
+    sizes.push_back(out.size() * sizeof(tree_index_entry));
+    data.push_back(strings.data());
+    sizes.push_back(strings.size() * sizeof(value_type));
+
+    path temp(index_file.native() + path(".tmp").native());
+    int errnum = write_file(temp, data, sizes);
+    if (errnum)
+    {
+      error_code ignored;
+      detail::remove(temp, &ignored);
+      error(errnum, index_file, ec, message);
+      return;
+    }
+    detail::rename(temp, index_file, ec);
+  }
+}  // namespace detail
+}  // namespace filesystem8
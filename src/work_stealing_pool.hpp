@@ -0,0 +1,237 @@
+//  work_stealing_pool.hpp  ------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//--------------------------------------------------------------------------------------//
+
+//  Private to the library implementation; not installed.
+//
+//  A small fixed-size thread pool for the tree walkers. Each worker owns a deque of
+//  tasks; tasks submitted from a worker go to the back of that worker's own deque and
+//  are popped LIFO, so a worker keeps descending into the subtree it is already in.
+//  An idle worker steals from the front of another worker's deque, i.e. it takes the
+//  oldest, and therefore usually the largest, pending subtree.
+
+#ifndef FILESYSTEM8_WORK_STEALING_POOL_HPP
+#define FILESYSTEM8_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace filesystem8
+{
+namespace detail
+{
+  class work_stealing_pool
+  {
+  public:
+    typedef std::function<void()> task;
+
+    //  threads == 0 means std::thread::hardware_concurrency()
+    explicit work_stealing_pool(unsigned threads)
+      : m_pending(0), m_queued(0), m_next(0), m_stop(false), m_cancelled(false)
+    {
+      if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+      if (threads == 0)
+        threads = 1;
+      m_queues.reserve(threads);
+      for (unsigned i = 0; i < threads; ++i)
+        m_queues.push_back(std::unique_ptr<queue>(new queue));
+      m_threads.reserve(threads);
+      try
+      {
+        for (unsigned i = 0; i < threads; ++i)
+          m_threads.push_back(std::thread(&work_stealing_pool::run, this, i));
+      }
+      catch (...)
+      {
+        // e.g. EAGAIN from std::thread; the workers started must not be left joinable
+        stop();
+        throw;
+      }
+    }
+
+    ~work_stealing_pool() { stop(); }
+
+    std::size_t size() const { return m_threads.size(); }
+
+    //  Returns: index of the calling worker thread in [0, size()), or -1 if the caller
+    //  is not one of this pool's workers.
+    int worker_index() const
+    {
+      return tls_pool() == this ? tls_index() : -1;
+    }
+
+    void submit(task t)
+    {
+      int self = worker_index();
+      std::size_t i = self >= 0
+        ? static_cast<std::size_t>(self)
+        : m_next.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+
+      m_pending.fetch_add(1);
+      {
+        std::lock_guard<std::mutex> lk(m_queues[i]->mutex);
+        m_queues[i]->tasks.push_back(std::move(t));
+      }
+      {
+        std::lock_guard<std::mutex> lk(m_sleep_mutex);
+        ++m_queued;
+      }
+      m_wake.notify_one();
+    }
+
+    //  Tasks that have not started yet are discarded; running tasks run to completion.
+    void cancel() { m_cancelled.store(true); }
+    bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+    //  Blocks until every submitted task has finished or been discarded, then rethrows
+    //  the first exception thrown by a task, if any.
+    void wait()
+    {
+      {
+        std::unique_lock<std::mutex> lk(m_done_mutex);
+        while (m_pending.load() != 0)
+          m_done.wait(lk);
+      }
+      if (m_exception)
+      {
+        std::exception_ptr ex = m_exception;
+        m_exception = std::exception_ptr();
+        std::rethrow_exception(ex);
+      }
+    }
+
+  private:
+    //  Wakes every worker to exit, and joins them
+    void stop()
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_sleep_mutex);
+        m_stop = true;
+      }
+      m_wake.notify_all();
+      for (std::size_t i = 0; i < m_threads.size(); ++i)
+        m_threads[i].join();
+    }
+
+    struct queue
+    {
+      std::mutex        mutex;
+      std::deque<task>  tasks;
+    };
+
+    std::vector<std::unique_ptr<queue> > m_queues;
+    std::vector<std::thread>  m_threads;
+    std::atomic<std::size_t>  m_pending;  // submitted but not yet finished
+    std::size_t               m_queued;   // sitting in a deque; guarded by m_sleep_mutex
+    std::atomic<std::size_t>  m_next;     // round robin for submissions from outside
+    bool                      m_stop;     // guarded by m_sleep_mutex
+    std::atomic<bool>         m_cancelled;
+    std::mutex                m_sleep_mutex;
+    std::condition_variable   m_wake;
+    std::mutex                m_done_mutex;
+    std::condition_variable   m_done;
+    std::mutex                m_exception_mutex;
+    std::exception_ptr        m_exception;
+
+    static const work_stealing_pool*& tls_pool()
+    {
+      static thread_local const work_stealing_pool* pool = 0;
+      return pool;
+    }
+    static int& tls_index()
+    {
+      static thread_local int index = -1;
+      return index;
+    }
+
+    bool try_pop(std::size_t self, task& t)
+    {
+      {
+        queue& q = *m_queues[self];
+        std::lock_guard<std::mutex> lk(q.mutex);
+        if (!q.tasks.empty())
+        {
+          t = std::move(q.tasks.back());
+          q.tasks.pop_back();
+          return true;
+        }
+      }
+      for (std::size_t n = 1; n < m_queues.size(); ++n)
+      {
+        queue& victim = *m_queues[(self + n) % m_queues.size()];
+        std::lock_guard<std::mutex> lk(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+          t = std::move(victim.tasks.front());
+          victim.tasks.pop_front();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void run(unsigned index)
+    {
+      tls_pool() = this;
+      tls_index() = static_cast<int>(index);
+
+      for (;;)
+      {
+        task t;
+        if (try_pop(index, t))
+        {
+          {
+            std::lock_guard<std::mutex> lk(m_sleep_mutex);
+            --m_queued;
+          }
+          execute(t);
+          continue;
+        }
+
+        std::unique_lock<std::mutex> lk(m_sleep_mutex);
+        while (!m_stop && m_queued == 0)
+          m_wake.wait(lk);
+        if (m_stop && m_queued == 0)
+          return;
+      }
+    }
+
+    void execute(task& t)
+    {
+      if (!m_cancelled.load(std::memory_order_relaxed))
+      {
+        try { t(); }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lk(m_exception_mutex);
+          if (!m_exception)
+            m_exception = std::current_exception();
+          m_cancelled.store(true);
+        }
+      }
+      t = task();  // release captured state before reporting completion
+
+      if (m_pending.fetch_sub(1) == 1)
+      {
+        std::lock_guard<std::mutex> lk(m_done_mutex);
+        m_done.notify_all();
+      }
+    }
+  };
+
+}  // namespace detail
+}  // namespace filesystem8
+
+#endif  // FILESYSTEM8_WORK_STEALING_POOL_HPP
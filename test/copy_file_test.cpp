@@ -0,0 +1,216 @@
+//  copy_file_test.cpp  ----------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <cstdlib>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::copy_option;
+using fs::copy_method;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-copy-file-test");
+
+  std::string contents(const path& p)
+  {
+    std::ifstream f(p.c_str(), std::ios_base::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  }
+
+  void create_file(const path& p, const std::string& s)
+  {
+    std::ofstream f(p.c_str(), std::ios_base::binary);
+    f << s;
+  }
+
+  //  A few MB that differ throughout, so that a copy out of place shows
+  std::string pattern(std::size_t n)
+  {
+    std::string s(n, '\0');
+    std::uint32_t x = 12345;
+    for (std::size_t i = 0; i != n; ++i)
+    {
+      x = x * 1103515245u + 12345u;
+      s[i] = static_cast<char>(x >> 24);
+    }
+    return s;
+  }
+
+  //  Returns: true if a page can be written to a file in dir with O_DIRECT, so that
+  //  copy_tuning::direct is not just ignored there
+  bool direct_supported(const path& dir)
+  {
+#   if defined(FILESYSTEM8_POSIX_API) && defined(O_DIRECT)
+    const path probe(dir / "direct-probe");
+    int fd = ::open(probe.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+    bool ok = false;
+    void* page = 0;
+    if (fd != -1 && ::posix_memalign(&page, 4096, 4096) == 0)
+    {
+      ok = ::write(fd, page, 4096) == 4096;
+      std::free(page);
+    }
+    if (fd != -1)
+      ::close(fd);
+    fs::remove(probe);
+    return ok;
+#   else
+    (void)dir;
+    return false;
+#   endif
+  }
+
+  //  method_test  ---------------------------------------------------------------------//
+
+  void method_test()
+  {
+    cout << "method_test..." << endl;
+
+    const std::string data(pattern(3 * 1024 * 1024 + 17));
+    const path from(root / "from");
+    create_file(from, data);
+
+    // whichever way is used first, the copy is the same
+    copy_method m = fs::copy_file(from, root / "default");
+    BOOST_TEST(m != copy_method::none);
+    BOOST_TEST(contents(root / "default") == data);
+
+    BOOST_TEST(fs::copy_file(from, root / "buffered", copy_option::buffered)
+      == copy_method::buffered);
+    BOOST_TEST(contents(root / "buffered") == data);
+
+    m = fs::copy_file(from, root / "no-clone", copy_option::no_clone);
+    BOOST_TEST(m != copy_method::clone && m != copy_method::none);
+    BOOST_TEST(contents(root / "no-clone") == data);
+
+    m = fs::copy_file(from, root / "sendfile",
+      copy_option::no_clone | copy_option::no_copy_file_range);
+    BOOST_TEST(m == copy_method::sendfile || m == copy_method::buffered);
+    BOOST_TEST(contents(root / "sendfile") == data);
+
+    // an empty file, and one whose size is not known until it is read
+    create_file(root / "empty", "");
+    BOOST_TEST(fs::copy_file(root / "empty", root / "empty-copy") != copy_method::none);
+    BOOST_TEST_EQ(fs::file_size(root / "empty-copy"), 0u);
+    if (fs::exists("/proc/self/status"))
+    {
+      fs::copy_file("/proc/self/status", root / "status");
+      BOOST_TEST(fs::file_size(root / "status") > 0u);
+    }
+  }
+
+  //  tuning_test  ---------------------------------------------------------------------//
+
+  void tuning_test()
+  {
+    cout << "tuning_test..." << endl;
+
+    // a size that is not a whole number of pages or buffers
+    const std::string data(pattern(5 * 1024 * 1024 + 4097));
+    const path from(root / "large");
+    create_file(from, data);
+
+    fs::copy_tuning tuning;
+    tuning.max_buffer = 64 * 1024;
+    tuning.sync_interval = 1024 * 1024;
+    BOOST_TEST(fs::copy_file(from, root / "synced", copy_option::buffered, tuning)
+      == copy_method::buffered);
+    BOOST_TEST(contents(root / "synced") == data);
+
+    // O_DIRECT up to the partial page at the end, and for a file shorter than a page
+    tuning.direct = true;
+    tuning.preallocate = false;
+    if (direct_supported(root))
+    {
+      std::error_code ec;
+      BOOST_TEST(fs::copy_file(from, root / "direct", copy_option::buffered, tuning, ec)
+        == copy_method::buffered);
+      BOOST_TEST(!ec);
+      BOOST_TEST(contents(root / "direct") == data);
+
+      create_file(root / "short", data.substr(0, 4097));
+      BOOST_TEST(fs::copy_file(root / "short", root / "short-direct",
+        copy_option::buffered, tuning, ec) == copy_method::buffered);
+      BOOST_TEST(!ec);
+      BOOST_TEST(contents(root / "short-direct") == data.substr(0, 4097));
+    }
+    else
+      cout << "  O_DIRECT not supported here; direct copy skipped" << endl;
+
+    // the buffer stays within its bounds, however they are given
+    tuning.min_buffer = 1;
+    tuning.max_buffer = 0;
+    BOOST_TEST(fs::copy_file(from, root / "small-buffer", copy_option::buffered, tuning)
+      == copy_method::buffered);
+    BOOST_TEST(contents(root / "small-buffer") == data);
+    create_file(root / "tiny", "x");
+    fs::copy_file(root / "tiny", root / "tiny-copy", copy_option::buffered, tuning);
+    BOOST_TEST(contents(root / "tiny-copy") == "x");
+    BOOST_TEST_EQ(fs::file_size(root / "tiny-copy"), 1u);
+  }
+
+  //  exists_test  ---------------------------------------------------------------------//
+
+  void exists_test()
+  {
+    cout << "exists_test..." << endl;
+
+    const path from(root / "small");
+    const path to(root / "small-copy");
+    create_file(from, "new contents");
+    create_file(to, "old");
+
+    std::error_code ec;
+    BOOST_TEST(fs::copy_file(from, to, ec) == copy_method::none);
+    BOOST_TEST(ec);
+    BOOST_TEST(contents(to) == "old");
+
+    BOOST_TEST(fs::copy_file(from, to, copy_option::overwrite_if_exists, ec)
+      != copy_method::none);
+    BOOST_TEST(!ec);
+    BOOST_TEST(contents(to) == "new contents");
+
+    BOOST_TEST(fs::copy_file(root / "missing", root / "missing-copy", ec)
+      == copy_method::none);
+    BOOST_TEST(ec);
+    BOOST_TEST(!fs::exists(root / "missing-copy"));
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  fs::remove_all(root);
+  fs::create_directories(root);
+
+  method_test();
+  tuning_test();
+  exists_test();
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}
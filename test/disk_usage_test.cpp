@@ -0,0 +1,166 @@
+//  disk_usage_test.cpp  ---------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/disk_usage.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-disk-usage-test");
+
+  void create_file(const path& p, const std::string& contents)
+  {
+    std::ofstream f(p.c_str());
+    f << contents;
+  }
+
+  //  totals_test  ---------------------------------------------------------------------//
+
+  void totals_test(unsigned threads)
+  {
+    cout << "totals_test, " << threads << " thread(s)..." << endl;
+
+    fs::disk_usage_options options;
+    options.threads = threads;
+    fs::disk_usage_info info(fs::disk_usage(root, options));
+
+    BOOST_TEST_EQ(info.total.directories, 5u);  // root, a, a/b, a/b/c, d
+#   ifdef FILESYSTEM8_POSIX_API
+    BOOST_TEST_EQ(info.total.files, 7u);  // f1 and its hard link count once
+#   else
+    BOOST_TEST_EQ(info.total.files, 8u);
+#   endif
+    BOOST_TEST(info.total.allocated >= 4096u || info.total.allocated == 0u);
+
+    BOOST_TEST_EQ(info.directories.size(), 5u);
+    const fs::usage_totals& a = info.directories[root / "a"];
+    const fs::usage_totals& c = info.directories[root / "a" / "b" / "c"];
+    BOOST_TEST_EQ(a.directories, 3u);
+    BOOST_TEST_EQ(c.directories, 1u);
+    BOOST_TEST_EQ(c.files, 2u);
+    BOOST_TEST(c.apparent_size >= 6u);
+    BOOST_TEST(info.directories[root].files == info.total.files);
+
+    // empty, 1 byte, 2-3 bytes, ..., 512-1023 bytes
+    BOOST_TEST_EQ(info.size_classes.size(), 11u);
+    if (info.size_classes.size() == 11u)
+    {
+      BOOST_TEST_EQ(info.size_classes[0].files, 1u);
+      BOOST_TEST_EQ(info.size_classes[2].files, 2u);  // f5, f6
+      BOOST_TEST_EQ(info.size_classes[3].files, 3u);  // f1, f3.txt, f4.txt
+      BOOST_TEST_EQ(info.size_classes[10].files, 1u);
+      BOOST_TEST_EQ(info.size_classes[10].apparent_size, 1000u);
+    }
+
+    BOOST_TEST_EQ(info.extensions[".txt"].files, 3u);
+    BOOST_TEST_EQ(info.extensions[".txt"].apparent_size, 1000u + 12u);
+    BOOST_TEST(info.extensions.count("") == 1);
+  }
+
+  //  options_test  --------------------------------------------------------------------//
+
+  void options_test()
+  {
+    cout << "options_test..." << endl;
+
+    fs::disk_usage_options options;
+    options.per_directory = false;
+    fs::disk_usage_info info(fs::disk_usage(root, options));
+    BOOST_TEST(info.directories.empty());
+    BOOST_TEST_EQ(info.total.directories, 5u);
+
+    info = fs::disk_usage(root / "a" / "big.txt");
+    BOOST_TEST_EQ(info.total.files, 1u);
+    BOOST_TEST_EQ(info.total.apparent_size, 1000u);
+    BOOST_TEST_EQ(info.directories.size(), 1u);
+
+    std::error_code ec;
+    fs::disk_usage(root / "nonexistent", ec);
+    BOOST_TEST(ec);
+  }
+
+  //  symlink_test  --------------------------------------------------------------------//
+
+  void symlink_test(unsigned threads)
+  {
+    cout << "symlink_test, " << threads << " thread(s)..." << endl;
+
+    //  links/{s/{x, y, up -> ..}, to-s -> s, loop -> .}
+    const path links(root / "links");
+    fs::create_directories(links / "s");
+    create_file(links / "s" / "x", "123");
+    create_file(links / "s" / "y", "1234");
+    std::error_code ec;
+    fs::create_directory_symlink("..", links / "s" / "up", ec);
+    if (ec)
+    {
+      cout << "  symlinks not supported here; skipped" << endl;
+      fs::remove_all(links);
+      return;
+    }
+    fs::create_directory_symlink("s", links / "to-s");
+    fs::create_directory_symlink(".", links / "loop");
+
+    // the symlinks are entries of their own
+    fs::disk_usage_options options;
+    options.threads = threads;
+    fs::disk_usage_info info(fs::disk_usage(links, options));
+    BOOST_TEST_EQ(info.total.directories, 2u);
+    BOOST_TEST_EQ(info.total.files, 5u);
+
+    // followed, each directory is counted and descended into once, and the walk ends
+    options.symlinks = fs::symlink_option::recurse;
+    info = fs::disk_usage(links, options);
+    BOOST_TEST_EQ(info.total.directories, 2u);
+    BOOST_TEST_EQ(info.total.files, 2u);
+    BOOST_TEST_EQ(info.directories.size(), 2u);  // links, and s by whichever path
+    BOOST_TEST_EQ(info.directories[links].files, 2u);
+    BOOST_TEST_EQ(info.extensions[""].apparent_size, 7u);  // x and y, once each
+
+    fs::remove_all(links);
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/a/{f1, big.txt, b/{f3.txt, c/{f4.txt, empty}}}, root/d/{f5, f6, f1-link to a/f1}
+  fs::remove_all(root);
+  fs::create_directories(root / "a" / "b" / "c");
+  fs::create_directories(root / "d");
+  create_file(root / "a" / "f1", "12345");
+  create_file(root / "a" / "big.txt", std::string(1000, 'x'));
+  create_file(root / "a" / "b" / "f3.txt", "123456");
+  create_file(root / "a" / "b" / "c" / "f4.txt", "123456");
+  create_file(root / "a" / "b" / "c" / "empty", "");
+  create_file(root / "d" / "f5", "f5");
+  create_file(root / "d" / "f6", "f6");
+  fs::create_hard_link(root / "a" / "f1", root / "d" / "f1-link");
+
+  totals_test(1);
+  totals_test(4);
+  options_test();
+  symlink_test(1);
+  symlink_test(4);
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}
@@ -0,0 +1,201 @@
+//  expected_test.cpp  -----------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/expected.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+//  Counts the allocations made while counting is on
+namespace
+{
+  bool counting = false;
+  std::size_t allocations = 0;
+}
+
+void* operator new(std::size_t n)
+{
+  if (counting)
+    ++allocations;
+  if (void* p = std::malloc(n == 0 ? 1 : n))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) FILESYSTEM8_NOEXCEPT { std::free(p); }
+void operator delete(void* p, std::size_t) FILESYSTEM8_NOEXCEPT { std::free(p); }
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-expected-test");
+
+  //  value_test  ----------------------------------------------------------------------//
+
+  void value_test()
+  {
+    cout << "value_test..." << endl;
+
+    BOOST_TEST(std::is_trivially_copyable<fs::fs_error>::value);
+    BOOST_TEST(sizeof(fs::fs_error) <= 2 * sizeof(int));
+
+    fs::expected<std::uintmax_t> size(fs::try_file_size(root / "f"));
+    BOOST_TEST(size.has_value());
+    BOOST_TEST_EQ(*size, 5u);
+    BOOST_TEST_EQ(size.value(), 5u);
+    BOOST_TEST(fs::try_status(root / "d")->type() == fs::file_type::directory);
+    BOOST_TEST(fs::try_status(root / "f").value() == fs::status(root / "f"));
+    BOOST_TEST(fs::try_is_directory(root / "d").value());
+    BOOST_TEST(fs::try_is_regular_file(root / "f").value());
+    BOOST_TEST(fs::try_exists(root / "f").value());
+    BOOST_TEST(fs::try_last_write_time(root / "f").value()
+      == fs::last_write_time_ns(root / "f"));
+    BOOST_TEST_EQ(fs::try_hard_link_count(root / "f").value(), 1u);
+    BOOST_TEST(fs::try_file_id_of(root / "f").value() == fs::file_id_of(root / "f"));
+  }
+
+  //  error_test  ----------------------------------------------------------------------//
+
+  void error_test()
+  {
+    cout << "error_test..." << endl;
+
+    // not found is an answer, not an error, as for status()
+    fs::expected<fs::file_status> st(fs::try_status(root / "missing"));
+    BOOST_TEST(st.has_value());
+    BOOST_TEST(st->type() == fs::file_type::not_found);
+    BOOST_TEST(fs::try_exists(root / "missing").has_value());
+    BOOST_TEST(!fs::try_exists(root / "missing").value());
+
+    // but it is for file_size(), whose error carries what failed and not where
+    fs::expected<std::uintmax_t> size(fs::try_file_size(root / "missing"));
+    BOOST_TEST(!size);
+    BOOST_TEST(size.error().op() == fs::fs_op::file_size);
+    BOOST_TEST(size.error().code());
+    BOOST_TEST_EQ(size.value_or(7u), 7u);
+
+    std::error_code ec;
+    fs::file_size(root / "missing", ec);
+    BOOST_TEST(size.error().code() == ec);
+
+    fs::filesystem_error e(size.error().exception(root / "missing"));
+    BOOST_TEST(e.path1() == root / "missing");
+    BOOST_TEST(e.code() == ec);
+    BOOST_TEST(std::string(e.what()).find("filesystem8::file_size") != std::string::npos);
+
+    bool threw = false;
+    try { size.value(); }
+    catch (const fs::filesystem_error& ex) { threw = ex.path1().empty(); }
+    BOOST_TEST(threw);
+
+    // a directory has no file size
+    BOOST_TEST(!fs::try_file_size(root / "d"));
+  }
+
+  //  policy_test  ---------------------------------------------------------------------//
+
+  //  Returns: the sum of the sizes of paths, with an error reported as Policy does
+  template <class Policy>
+  typename Policy::template result<std::uintmax_t>::type total_size(
+    const std::vector<path>& paths)
+  {
+    std::uintmax_t total = 0;
+    for (std::size_t i = 0; i != paths.size(); ++i)
+    {
+      fs::expected<std::uintmax_t> size(fs::try_file_size(paths[i]));
+      if (!size)
+        return Policy::done(total, size.error(), paths[i]);
+      total += *size;
+    }
+    return Policy::done(total, fs::fs_error(), path());
+  }
+
+  void policy_test()
+  {
+    cout << "policy_test..." << endl;
+
+    BOOST_TEST_EQ(fs::basic_file_size<fs::throw_policy>(root / "f"), 5u);
+    BOOST_TEST(fs::basic_exists<fs::throw_policy>(root / "f"));
+    BOOST_TEST(!fs::basic_exists<fs::throw_policy>(root / "missing"));
+
+    bool threw = false;
+    try { fs::basic_file_size<fs::throw_policy>(root / "missing"); }
+    catch (const fs::filesystem_error& ex) { threw = ex.path1() == root / "missing"; }
+    BOOST_TEST(threw);
+
+    std::vector<path> paths(3, root / "f");
+    BOOST_TEST_EQ(total_size<fs::nothrow_policy>(paths).value(), 15u);
+    BOOST_TEST_EQ(total_size<fs::throw_policy>(paths), 15u);
+    paths.push_back(root / "missing");
+    BOOST_TEST(!total_size<fs::nothrow_policy>(paths));
+    threw = false;
+    try { total_size<fs::throw_policy>(paths); }
+    catch (const fs::filesystem_error& ex) { threw = ex.path1() == root / "missing"; }
+    BOOST_TEST(threw);
+  }
+
+  //  allocation_test  -----------------------------------------------------------------//
+
+  void allocation_test()
+  {
+    cout << "allocation_test..." << endl;
+
+    std::vector<path> paths;
+    for (int i = 0; i != 100; ++i)
+      paths.push_back(root / ("missing" + std::to_string(i)));
+
+    allocations = 0;
+    counting = true;
+    std::size_t found = 0, errors = 0;
+    for (std::size_t i = 0; i != paths.size(); ++i)
+    {
+      if (fs::try_exists(paths[i]).value_or(false))
+        ++found;
+      if (!fs::try_file_size(paths[i]))
+        ++errors;
+    }
+    counting = false;
+    BOOST_TEST_EQ(found, 0u);
+    BOOST_TEST_EQ(errors, 100u);
+    BOOST_TEST_EQ(allocations, 0u);
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/{d/, f}
+  fs::remove_all(root);
+  fs::create_directories(root / "d");
+  {
+    std::ofstream f((root / "f").c_str());
+    f << "hello";
+  }
+
+  value_test();
+  error_test();
+  policy_test();
+  allocation_test();
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}
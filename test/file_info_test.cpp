@@ -0,0 +1,339 @@
+//  file_info_test.cpp  ----------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/file_info.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using fs::file_info;
+using fs::file_info_fields;
+using fs::query_option;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-file-info-test");
+
+  //  all_test  ------------------------------------------------------------------------//
+
+  void all_test()
+  {
+    cout << "all_test..." << endl;
+
+    const path f(root / "f");
+    file_info info(fs::query(f));
+    BOOST_TEST(info.has(file_info_fields::type | file_info_fields::perms
+      | file_info_fields::size | file_info_fields::nlink | file_info_fields::id
+      | file_info_fields::mtime));
+    BOOST_TEST(info.type == fs::file_type::regular);
+    BOOST_TEST(info.status() == fs::status(f));
+    BOOST_TEST_EQ(info.size, 5u);
+    BOOST_TEST_EQ(info.size, fs::file_size(f));
+    BOOST_TEST_EQ(info.nlink, 2u);
+    BOOST_TEST_EQ(info.mtime_ns / 1000000000, fs::last_write_time(f));
+
+    file_info link(fs::query(root / "hard"));
+    BOOST_TEST_EQ(link.dev, info.dev);
+    BOOST_TEST_EQ(link.ino, info.ino);
+    BOOST_TEST(fs::query(root / "d").ino != info.ino);
+
+    info = fs::query(root / "d");
+    BOOST_TEST(info.type == fs::file_type::directory);
+    BOOST_TEST(info.status() == fs::status(root / "d"));
+  }
+
+  //  fields_test  ---------------------------------------------------------------------//
+
+  void fields_test()
+  {
+    cout << "fields_test..." << endl;
+
+    //  only what is asked for is reported valid
+    file_info info(fs::query(root / "f", file_info_fields::size));
+    BOOST_TEST(info.fields == file_info_fields::size);
+    BOOST_TEST_EQ(info.size, 5u);
+
+    info = fs::query(root / "f", file_info_fields::type | file_info_fields::mtime,
+      query_option::dont_sync);
+    BOOST_TEST(info.fields == (file_info_fields::type | file_info_fields::mtime));
+    BOOST_TEST(info.type == fs::file_type::regular);
+    BOOST_TEST_EQ(info.mtime_ns / 1000000000, fs::last_write_time(root / "f"));
+  }
+
+  //  symlink_test  --------------------------------------------------------------------//
+
+  void symlink_test()
+  {
+    cout << "symlink_test..." << endl;
+
+    std::error_code ec;
+    fs::create_symlink("f", root / "sym", ec);
+    if (ec)
+    {
+      cout << "  symlinks not supported; skipped" << endl;
+      return;
+    }
+    BOOST_TEST(fs::query(root / "sym", file_info_fields::type).type
+      == fs::file_type::regular);
+    BOOST_TEST(fs::query(root / "sym", file_info_fields::type,
+      query_option::no_follow).type == fs::file_type::symlink);
+    BOOST_TEST(fs::query(root / "sym", file_info_fields::id).ino
+      == fs::query(root / "f", file_info_fields::id).ino);
+  }
+
+  //  not_found_test  ------------------------------------------------------------------//
+
+  void not_found_test()
+  {
+    cout << "not_found_test..." << endl;
+
+    file_info info(fs::query(root / "no-such-file"));
+    BOOST_TEST(info.type == fs::file_type::not_found);
+    BOOST_TEST(info.fields == file_info_fields::type);
+    BOOST_TEST(!fs::exists(info.status()));
+
+    std::error_code ec;
+    info = fs::query(root / "f" / "x", file_info_fields::all, ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(info.type == fs::file_type::not_found);
+  }
+
+  //  many_test  -----------------------------------------------------------------------//
+
+  void many_test()
+  {
+    cout << "many_test..." << endl;
+
+    //  root/many/d0 .. d3, each with files f0 .. f99, queried with some that are missing
+    std::vector<path> paths;
+    for (int d = 0; d != 4; ++d)
+    {
+      path dir(root / "many" / ("d" + std::to_string(d)));
+      fs::create_directories(dir);
+      for (int i = 0; i != 100; ++i)
+      {
+        path f(dir / ("f" + std::to_string(i)));
+        if (i % 10 != 9)
+          std::ofstream(f.c_str()) << i;
+        paths.push_back(f);
+      }
+      paths.push_back(dir);
+      paths.push_back(dir / "");
+    }
+    paths.push_back(root / "no-such-dir" / "f");
+    paths.push_back(root / "f" / "x");
+    paths.push_back(root.root_path());
+    paths.push_back(root / "sym");
+    paths.push_back(root / "many" / "d0" / "f0");  // twice
+    std::reverse(paths.begin(), paths.end());  // out of directory order
+
+    for (unsigned run = 0; run != 4; ++run)
+    {
+      fs::batch_options batch;
+      batch.threads = run % 2 == 0 ? 1 : 4;
+      batch.order = run < 2 ? fs::directory_order::native : fs::directory_order::inode;
+
+      std::vector<fs::file_status> st(paths.size());
+      fs::status_many(paths.data(), paths.size(), st.data(), batch);
+      std::vector<fs::file_status> lst(paths.size());
+      fs::symlink_status_many(paths.data(), paths.size(), lst.data(), batch);
+      std::vector<file_info> info(paths.size());
+      std::error_code ec;
+      fs::query_many(paths.data(), paths.size(), info.data(),
+        file_info_fields::type | file_info_fields::size, query_option::none, batch, ec);
+      BOOST_TEST(!ec);
+
+      for (std::size_t i = 0; i != paths.size(); ++i)
+      {
+        BOOST_TEST(st[i] == fs::status(paths[i]));
+        BOOST_TEST(lst[i] == fs::symlink_status(paths[i]));
+        BOOST_TEST(info[i].type == st[i].type());
+        if (fs::is_regular_file(st[i]))
+          BOOST_TEST_EQ(info[i].size, fs::file_size(paths[i]));
+      }
+    }
+
+    //  an error other than not found is reported, and the others are still queried
+    paths.push_back(root / std::string(1000, 'x'));  // ENAMETOOLONG
+    std::vector<fs::file_status> st(paths.size());
+    std::error_code ec;
+    fs::status_many(paths.data(), paths.size(), st.data(), fs::batch_options(), ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(st.back().type() == fs::file_type::none);
+    BOOST_TEST(st.front() == fs::status(paths.front()));
+
+    bool threw = false;
+    try { fs::status_many(paths.data(), paths.size(), st.data()); }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+  }
+
+  //  time_test  -----------------------------------------------------------------------//
+
+  void time_test()
+  {
+    cout << "time_test..." << endl;
+
+    const path f(root / "f");
+    const fs::file_time_type t(std::chrono::seconds(1500000000)
+      + std::chrono::nanoseconds(123456789));
+    const std::int64_t atime_ns = fs::query(f, file_info_fields::atime).atime_ns;
+
+    fs::last_write_time(f, t);
+    file_info info(fs::query(f, file_info_fields::mtime | file_info_fields::atime));
+    BOOST_TEST_EQ(fs::last_write_time(f), 1500000000);
+    // to the nanosecond, or as near as the filesystem keeps, and atime left alone
+    BOOST_TEST(fs::last_write_time_ns(f) <= t);
+    BOOST_TEST(t - fs::last_write_time_ns(f) < std::chrono::seconds(1));
+    BOOST_TEST_EQ(info.mtime_ns, fs::last_write_time_ns(f).time_since_epoch().count());
+    BOOST_TEST_EQ(info.atime_ns, atime_ns);
+
+    // before the epoch, where nanoseconds are still counted up
+    const fs::file_time_type before(std::chrono::nanoseconds(-1500000000));
+    fs::last_write_time(f, before);
+    BOOST_TEST(fs::last_write_time_ns(f) <= before);
+    BOOST_TEST_EQ(fs::last_write_time(f), -2);
+
+    // the time_t setter as before
+    fs::last_write_time(f, std::time_t(1400000000));
+    BOOST_TEST(fs::last_write_time_ns(f)
+      == fs::file_time_type(std::chrono::seconds(1400000000)));
+
+    std::error_code ec;
+    fs::last_write_time(root / "no-such-file", t, ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(fs::last_write_time_ns(root / "no-such-file", ec)
+      == fs::file_time_type::min());
+    BOOST_TEST(ec);
+  }
+
+  //  touch_test  ----------------------------------------------------------------------//
+
+  void touch_test()
+  {
+    cout << "touch_test..." << endl;
+
+    std::vector<path> paths;
+    for (int d = 0; d != 4; ++d)
+      for (int i = 0; i != 100; ++i)
+      {
+        path f(root / "many" / ("d" + std::to_string(d)) / ("f" + std::to_string(i)));
+        if (fs::exists(f))
+          paths.push_back(f);
+      }
+    BOOST_TEST_EQ(paths.size(), 360u);
+
+    const fs::file_time_type t(std::chrono::seconds(1600000000)
+      + std::chrono::nanoseconds(500000000));
+    fs::touch_many(paths.data(), paths.size(), t);
+    for (std::size_t i = 0; i != paths.size(); ++i)
+      BOOST_TEST_EQ(fs::last_write_time(paths[i]), 1600000000);
+
+    // a missing path is an error, and the others are still touched
+    paths.push_back(root / "many" / "d0" / "f9");
+    std::error_code ec;
+    fs::touch_many(paths.data(), paths.size(), fs::file_time_type(), fs::batch_options(), ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(!fs::exists(paths.back()));
+    BOOST_TEST_EQ(fs::last_write_time(paths.front()), 0);
+  }
+
+  //  id_test  -------------------------------------------------------------------------//
+
+  void id_test()
+  {
+    cout << "id_test..." << endl;
+
+    const fs::file_id f(fs::file_id_of(root / "f"));
+    BOOST_TEST(f == fs::file_id_of(root / "hard"));
+    BOOST_TEST(f != fs::file_id_of(root / "d"));
+    BOOST_TEST(f == fs::query(root / "f", file_info_fields::id).id());
+    BOOST_TEST(fs::equivalent(root / "f", root / "hard"));
+    BOOST_TEST(!fs::equivalent(root / "f", root / "d"));
+
+    std::error_code ec;
+    BOOST_TEST(fs::file_id_of(root / "no-such-file", ec) == fs::file_id());
+    BOOST_TEST(ec);
+
+    // f and hard are two entries but one file, whether hashed or ordered
+    std::unordered_set<fs::file_id, fs::file_id_hash> hashed;
+    std::set<fs::file_id> ordered;
+    std::size_t files = 0;
+    for (fs::directory_iterator it(root), end; it != end; ++it)
+    {
+      if (!fs::is_regular_file(it->symlink_status()))
+        continue;
+      ++files;
+      hashed.insert(it->symlink_id());
+      ordered.insert(it->id());
+    }
+    BOOST_TEST_EQ(files, 2u);
+    BOOST_TEST_EQ(hashed.size(), 1u);
+    BOOST_TEST_EQ(ordered.size(), 1u);
+
+    // an entry caches its ids, and the status read with them
+    fs::directory_entry e(root / "sym");
+    if (fs::is_symlink(fs::symlink_status(e.path())))
+    {
+      BOOST_TEST(e.id() == f);
+      BOOST_TEST(e.symlink_id() != f);
+      BOOST_TEST(fs::status_known(e.status()) && fs::status_known(e.symlink_status()));
+      fs::remove(e.path());
+      BOOST_TEST(e.id() == f);
+      BOOST_TEST(fs::is_symlink(e.symlink_status()));
+    }
+
+    fs::directory_entry missing(root / "no-such-file");
+    BOOST_TEST(missing.id(ec) == fs::file_id());
+    BOOST_TEST(ec);
+    bool threw = false;
+    try { missing.symlink_id(); }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/{d/, f, hard (a hard link to f)}
+  fs::remove_all(root);
+  fs::create_directories(root / "d");
+  {
+    std::ofstream f((root / "f").c_str());
+    f << "hello";
+  }
+  fs::create_hard_link(root / "f", root / "hard");
+
+  all_test();
+  fields_test();
+  symlink_test();
+  not_found_test();
+  many_test();
+  time_test();
+  touch_test();
+  id_test();
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}
@@ -0,0 +1,233 @@
+//  metadata_cache_test.cpp  -----------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/metadata_cache.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-metadata-cache-test");
+
+  void create_file(const path& p, const std::string& contents)
+  {
+    std::ofstream f(p.c_str());
+    f << contents;
+  }
+
+  //  hit_test  ------------------------------------------------------------------------//
+
+  void hit_test()
+  {
+    cout << "hit_test..." << endl;
+
+    fs::metadata_cache cache;
+    const path f(root / "f");
+
+    BOOST_TEST(cache.status(f) == fs::status(f));
+    BOOST_TEST_EQ(cache.file_size(f), 5u);
+    BOOST_TEST_EQ(cache.last_write_time(f), fs::last_write_time(f));
+    BOOST_TEST(cache.exists(f));
+    BOOST_TEST(cache.is_regular_file(f));
+    BOOST_TEST(!cache.is_directory(f));
+
+    // one miss answers all of them; symlink_status() is cached apart
+    fs::metadata_cache_stats st = cache.stats();
+    BOOST_TEST_EQ(st.misses, 1u);
+    BOOST_TEST_EQ(st.hits, 5u);
+    BOOST_TEST_EQ(st.entries, 1u);
+    BOOST_TEST(cache.symlink_status(f) == fs::symlink_status(f));
+    BOOST_TEST_EQ(cache.stats().misses, 2u);
+
+    // the cached answer is used until invalidated
+    create_file(f, "longer contents");
+    BOOST_TEST_EQ(cache.file_size(f), 5u);
+    cache.invalidate(f);
+    BOOST_TEST_EQ(cache.file_size(f), 15u);
+    BOOST_TEST_EQ(cache.stats().misses, 3u);
+
+    std::error_code ec;
+    BOOST_TEST_EQ(cache.file_size(root / "d", ec), static_cast<std::uintmax_t>(-1));
+    BOOST_TEST(ec);
+    BOOST_TEST(cache.is_directory(root / "d"));
+  }
+
+  //  not_found_test  ------------------------------------------------------------------//
+
+  void not_found_test()
+  {
+    cout << "not_found_test..." << endl;
+
+    fs::metadata_cache cache;
+    const path p(root / "new");
+
+    BOOST_TEST(!cache.exists(p));
+    std::error_code ec;
+    BOOST_TEST(cache.status(p, ec) == fs::status(p));
+    BOOST_TEST(ec);
+    BOOST_TEST_EQ(cache.stats().hits, 1u);
+
+    bool threw = false;
+    try { cache.file_size(p); }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+
+    // not found is cached too, until the entry expires
+    create_file(p, "x");
+    BOOST_TEST(!cache.exists(p));
+    fs::metadata_cache_options options;
+    options.ttl = std::chrono::milliseconds(0);
+    fs::metadata_cache uncached(options);
+    BOOST_TEST(!uncached.exists(root / "new2"));
+    create_file(root / "new2", "x");
+    BOOST_TEST(uncached.exists(root / "new2"));
+    BOOST_TEST_EQ(uncached.stats().hits, 0u);
+  }
+
+  //  subtree_test  --------------------------------------------------------------------//
+
+  void subtree_test()
+  {
+    cout << "subtree_test..." << endl;
+
+    fs::metadata_cache cache;
+    cache.status(root / "d");
+    cache.status(root / "d" / "a");
+    cache.status(root / "d" / "a" / "b");
+    cache.status(root / "dd");
+    cache.status(root / "f");
+    BOOST_TEST_EQ(cache.stats().entries, 5u);
+
+    cache.invalidate_subtree(root / "d" / "");
+    BOOST_TEST_EQ(cache.stats().entries, 2u);  // not dd, which only starts alike
+
+    cache.clear();
+    BOOST_TEST_EQ(cache.stats().entries, 0u);
+
+    // a full cache makes room
+    fs::metadata_cache_options options;
+    options.shards = 1;
+    options.max_entries = 4;
+    fs::metadata_cache small(options);
+    for (int i = 0; i != 10; ++i)
+      small.status(root / ("missing" + std::to_string(i)));
+    BOOST_TEST(small.stats().entries <= 4u);
+  }
+
+  //  race_test  -----------------------------------------------------------------------//
+
+  //  A cache whose next miss has the file it asked about created, and then invalidated,
+  //  after its query and before what it found is stored, as another thread might
+  class racing_cache : public fs::metadata_cache
+  {
+  public:
+    explicit racing_cache(const fs::metadata_cache_options& o)
+      : fs::metadata_cache(o), subtree(false), armed(true) {}
+
+    bool  subtree;  // invalidate_subtree() of the parent, rather than invalidate()
+
+  protected:
+    fs::file_info miss(const path& p, bool follow, std::error_code& ec)
+    {
+      fs::file_info info(fs::metadata_cache::miss(p, follow, ec));
+      if (armed)
+      {
+        armed = false;
+        create_file(p, "x");
+        if (subtree)
+          invalidate_subtree(p.parent_path());
+        else
+          invalidate(p);
+      }
+      return info;
+    }
+
+  private:
+    bool  armed;
+  };
+
+  void race_test()
+  {
+    cout << "race_test..." << endl;
+
+    fs::metadata_cache_options options;
+    options.ttl = std::chrono::hours(1);
+    for (int subtree = 0; subtree != 2; ++subtree)
+    {
+      const path p(root / ("raced" + std::to_string(subtree)));
+      racing_cache cache(options);
+      cache.subtree = subtree != 0;
+
+      // the miss answers with what it found, but does not keep it past the invalidation
+      BOOST_TEST(!cache.exists(p));
+      BOOST_TEST_EQ(cache.stats().entries, 0u);
+      BOOST_TEST(cache.exists(p));
+      BOOST_TEST(cache.exists(p));
+      BOOST_TEST_EQ(cache.stats().hits, 1u);
+    }
+  }
+
+  //  concurrency_test  ----------------------------------------------------------------//
+
+  void concurrency_test()
+  {
+    cout << "concurrency_test..." << endl;
+
+    fs::metadata_cache cache;
+    std::vector<std::thread> threads;
+    for (int t = 0; t != 4; ++t)
+      threads.push_back(std::thread([&cache, t]()
+      {
+        for (int i = 0; i != 1000; ++i)
+        {
+          cache.exists(root / ("p" + std::to_string(i % 50)));
+          if (i % 100 == t)
+            cache.invalidate_subtree(root);
+        }
+      }));
+    for (std::size_t i = 0; i != threads.size(); ++i)
+      threads[i].join();
+
+    fs::metadata_cache_stats st = cache.stats();
+    BOOST_TEST_EQ(st.hits + st.misses, 4000u);
+    BOOST_TEST(st.entries <= 50u);
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/{d/a/, dd/, f}
+  fs::remove_all(root);
+  fs::create_directories(root / "d" / "a");
+  fs::create_directories(root / "dd");
+  create_file(root / "f", "hello");
+
+  hit_test();
+  not_found_test();
+  subtree_test();
+  race_test();
+  concurrency_test();
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}
@@ -0,0 +1,143 @@
+//  rescan_test.cpp  -------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/rescan.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-rescan-test");
+
+  void create_file(const path& p, const std::string& contents)
+  {
+    std::ofstream f(p.c_str());
+    f << contents;
+  }
+
+  //  "+a/f1", "-a/f2", "*a/f3" for added, removed, modified
+  std::set<std::string> summary(const std::vector<fs::scan_change>& changes)
+  {
+    std::set<std::string> result;
+    for (std::size_t i = 0; i < changes.size(); ++i)
+    {
+      const char kind = changes[i].kind == fs::scan_change::added ? '+'
+        : changes[i].kind == fs::scan_change::removed ? '-' : '*';
+      result.insert(kind + changes[i].relative_path.generic_string());
+    }
+    return result;
+  }
+
+  std::set<std::string> rescan(fs::scan_result& result)
+  {
+    std::vector<fs::scan_change> changes;
+    result = fs::rescan(result, changes);
+    return summary(changes);
+  }
+
+  //  scan_test  -----------------------------------------------------------------------//
+
+  void scan_test()
+  {
+    cout << "scan_test..." << endl;
+
+    fs::scan_result result(fs::scan(root));
+    BOOST_TEST(result.root() == root);
+    BOOST_TEST_EQ(result.size(), 9u);
+
+    const fs::scan_entry* e = result.find("a/f1");
+    BOOST_TEST(e != 0 && e->type == fs::file_type::regular && e->size == 5u);
+    e = result.find("a/b/c");
+    BOOST_TEST(e != 0 && e->type == fs::file_type::directory);
+    BOOST_TEST(result.find(".") != 0);
+    BOOST_TEST(result.find("a/none") == 0);
+
+    std::vector<std::string> order;
+    result.for_each([&](const path& p, const fs::scan_entry&)
+      { order.push_back(p.generic_string()); });
+    const char* const expected[] = {"a", "a/b", "a/b/c", "a/b/c/f4", "a/b/f3",
+      "a/f1", "a/f2", "d", "d/f5"};
+    BOOST_TEST(order == std::vector<std::string>(expected, expected + 9));
+
+    std::error_code ec;
+    fs::scan(root / "nonexistent", ec);
+    BOOST_TEST(ec);
+  }
+
+  //  rescan_test  ---------------------------------------------------------------------//
+
+  void rescan_test()
+  {
+    cout << "rescan_test..." << endl;
+
+    fs::scan_result result(fs::scan(root));
+    BOOST_TEST(rescan(result).empty());
+
+    create_file(root / "a" / "b" / "c" / "f6", "f6");
+    fs::remove(root / "a" / "f2");
+    create_file(root / "a" / "f1", "123456789");
+    std::set<std::string> changes(rescan(result));
+    BOOST_TEST(changes.count("+a/b/c/f6") == 1);
+    BOOST_TEST(changes.count("-a/f2") == 1);
+    BOOST_TEST(changes.count("*a/f1") == 1);
+    BOOST_TEST_EQ(changes.size(), 3u);
+    BOOST_TEST_EQ(result.size(), 9u);
+    BOOST_TEST(rescan(result).empty());
+
+    // a subtree is reported entry by entry
+    fs::rename(root / "a" / "b", root / "d" / "b");
+    changes = rescan(result);
+    const char* const moved[] = {"+d/b", "+d/b/c", "+d/b/c/f4", "+d/b/c/f6", "+d/b/f3",
+      "-a/b", "-a/b/c", "-a/b/c/f4", "-a/b/c/f6", "-a/b/f3"};
+    BOOST_TEST(changes == std::set<std::string>(moved, moved + 10));
+    BOOST_TEST(result.find("d/b/c/f6") != 0);
+    BOOST_TEST(result.find("a/b") == 0);
+
+    // a file replaced by a directory of the same name
+    fs::remove(root / "d" / "f5");
+    fs::create_directories(root / "d" / "f5");
+    changes = rescan(result);
+    BOOST_TEST(changes.count("-d/f5") == 1 && changes.count("+d/f5") == 1);
+    BOOST_TEST(result.find("d/f5") != 0
+      && result.find("d/f5")->type == fs::file_type::directory);
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/a/{f1, f2, b/{f3, c/f4}}, root/d/f5
+  fs::remove_all(root);
+  fs::create_directories(root / "a" / "b" / "c");
+  fs::create_directories(root / "d");
+  create_file(root / "a" / "f1", "12345");
+  create_file(root / "a" / "f2", "f2");
+  create_file(root / "a" / "b" / "f3", "f3");
+  create_file(root / "a" / "b" / "c" / "f4", "f4");
+  create_file(root / "d" / "f5", "f5");
+
+  scan_test();
+  rescan_test();
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}
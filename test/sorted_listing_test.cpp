@@ -0,0 +1,181 @@
+//  sorted_listing_test.cpp  -----------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/sorted_listing.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-sorted-listing-test");
+  const path spill(fs::temp_directory_path() / "filesystem8-sorted-listing-spill");
+  const int file_count = 3000;
+
+  void create_file(const path& p)
+  {
+    std::ofstream f(p.c_str());
+    f << p.string();
+  }
+
+  std::vector<path> expected_listing()
+  {
+    std::vector<path> result;
+    for (fs::directory_iterator it(root), end; it != end; ++it)
+      result.push_back(it->path());
+    std::sort(result.begin(), result.end(),
+      [](const path& lhs, const path& rhs) { return lhs.compare(rhs) < 0; });
+    return result;
+  }
+
+  std::vector<path> listing(const fs::sorted_listing_options& options,
+    std::size_t* runs = 0)
+  {
+    std::vector<path> result;
+    fs::sorted_directory_iterator it(root, options);
+    if (runs != 0)
+      *runs = it.runs();
+    for (; it != fs::sorted_directory_iterator(); ++it)
+      result.push_back(it->path());
+    return result;
+  }
+
+  //  in_memory_test  ------------------------------------------------------------------//
+
+  void in_memory_test()
+  {
+    cout << "in_memory_test..." << endl;
+
+    std::size_t runs = 1;
+    BOOST_TEST(listing(fs::sorted_listing_options(), &runs) == expected_listing());
+    BOOST_TEST_EQ(runs, 0u);
+
+    fs::sorted_listing_options options;
+    options.types = fs::entry_type_mask::directory;
+    std::vector<path> dirs(listing(options));
+    BOOST_TEST_EQ(dirs.size(), 2u);
+    BOOST_TEST(dirs.size() == 2u && dirs[0] == root / "dir1" && dirs[1] == root / "dir2");
+
+    fs::sorted_directory_iterator it(root, options);
+    BOOST_TEST(fs::is_directory(it->status()));
+    BOOST_TEST(fs::is_directory(it->symlink_status()));
+    BOOST_TEST(it->filename() == "dir1");
+  }
+
+  //  spill_test  ----------------------------------------------------------------------//
+
+  void spill_test()
+  {
+    cout << "spill_test..." << endl;
+
+    const std::vector<path> expected(expected_listing());
+    BOOST_TEST_EQ(expected.size(), static_cast<std::size_t>(file_count + 2));
+
+    fs::sorted_listing_options options;
+    options.temp_directory = spill;
+
+    // a single merge
+    options.memory_budget = 64 * 1024;
+    std::size_t runs = 0;
+    BOOST_TEST(listing(options, &runs) == expected);
+    BOOST_TEST(runs > 1u);
+
+    // runs first merged into longer ones
+    options.memory_budget = 1024;
+    BOOST_TEST(listing(options, &runs) == expected);
+    BOOST_TEST(runs > 100u);
+
+    // nothing left behind
+    BOOST_TEST(fs::is_empty(spill));
+
+    fs::sorted_directory_iterator it(root, options);
+    BOOST_TEST(fs::is_directory(it->symlink_status()));  // dir1
+    ++it;
+    BOOST_TEST(fs::is_directory(it->status()));  // dir2
+    ++it;
+    BOOST_TEST(fs::is_regular_file(it->status()));
+  }
+
+  //  error_test  ----------------------------------------------------------------------//
+
+  void error_test()
+  {
+    cout << "error_test..." << endl;
+
+    std::error_code ec;
+    fs::sorted_directory_iterator it(root / "no-such-directory", ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(it == fs::sorted_directory_iterator());
+
+    fs::sorted_listing_options options;
+    options.memory_budget = 1024;
+    options.temp_directory = root / "no-such-directory";
+    fs::sorted_directory_iterator it2(root, options, ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(it2 == fs::sorted_directory_iterator());
+
+    bool threw = false;
+    try { fs::sorted_directory_iterator it3(root, options); }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+
+#   ifdef FILESYSTEM8_POSIX_API
+    // an unusable TMPDIR matters only to a listing that spills
+    const char* tmpdir = std::getenv("TMPDIR");
+    const std::string saved(tmpdir != 0 ? tmpdir : "");
+    ::setenv("TMPDIR", (root / "no-such-directory").c_str(), 1);
+    fs::sorted_listing_options defaults;
+    fs::sorted_directory_iterator in_memory(root, defaults, ec);
+    BOOST_TEST(!ec);
+    BOOST_TEST(in_memory != fs::sorted_directory_iterator());
+    defaults.memory_budget = 1024;
+    fs::sorted_directory_iterator it4(root, defaults, ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(it4 == fs::sorted_directory_iterator());
+    if (tmpdir != 0)
+      ::setenv("TMPDIR", saved.c_str(), 1);
+    else
+      ::unsetenv("TMPDIR");
+#   endif
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/{dir1, dir2, f0 .. f2999}, created out of order
+  fs::remove_all(root);
+  fs::remove_all(spill);
+  fs::create_directories(root / "dir2");
+  fs::create_directories(root / "dir1");
+  fs::create_directories(spill);
+  for (int i = 0; i != file_count; ++i)
+    create_file(root / ("f" + std::to_string((i * 7919) % file_count)));
+
+  in_memory_test();
+  spill_test();
+  error_test();
+
+  fs::remove_all(root);
+  fs::remove_all(spill);
+  return ::boost::report_errors();
+}
@@ -0,0 +1,183 @@
+//  tree_cache_test.cpp  ---------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/tree_cache.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-tree-cache-test");
+
+  //  Returns: the number of descriptors the process has open, or 0 if unknown
+  std::size_t open_fds()
+  {
+    std::error_code ec;
+    std::size_t n = 0;
+    for (fs::directory_iterator it("/proc/self/fd", ec), end; !ec && it != end;
+      it.increment(ec))
+      ++n;
+    return n;
+  }
+
+  void create_file(const path& p, const std::string& contents)
+  {
+    std::ofstream f(p.c_str());
+    f << contents;
+  }
+
+  //  A live cache sees a change once its event is delivered; a snapshot after refresh()
+  bool eventually(fs::tree_cache& cache, const std::function<bool()>& pred)
+  {
+    if (!cache.is_live())
+      cache.refresh();
+    for (int i = 0; i < 500; ++i)
+    {
+      if (pred())
+        return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pred();
+  }
+
+  std::vector<std::string> names(const std::vector<fs::directory_entry>& entries)
+  {
+    std::vector<std::string> result;
+    for (std::size_t i = 0; i < entries.size(); ++i)
+      result.push_back(entries[i].path().filename().string());
+    return result;
+  }
+
+  //  query_test  ----------------------------------------------------------------------//
+
+  void query_test(fs::tree_cache& cache)
+  {
+    cout << "query_test..." << endl;
+
+    BOOST_TEST(cache.root() == root);
+    BOOST_TEST(fs::is_directory(cache.status(root)));
+    BOOST_TEST(fs::is_directory(cache.status(root / "a")));
+    BOOST_TEST(fs::is_regular_file(cache.status(root / "a" / "f1")));
+    BOOST_TEST(cache.exists(root / "a" / "b" / "f3"));
+    BOOST_TEST(!cache.exists(root / "a" / "nonexistent"));
+    BOOST_TEST(!cache.exists(root / "nonexistent" / "f1"));
+    BOOST_TEST_EQ(cache.file_size(root / "a" / "f1"), 5u);
+    BOOST_TEST_EQ(cache.last_write_time(root / "a" / "f1"),
+      fs::last_write_time(root / "a" / "f1"));
+
+    std::error_code ec;
+    cache.file_size(root / "a", ec);
+    BOOST_TEST(ec);
+    cache.file_size(root / "nonexistent", ec);
+    BOOST_TEST(ec);
+    bool threw = false;
+    try { cache.list(root / "nonexistent"); }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+
+    std::vector<std::string> expected;
+    expected.push_back("b");
+    expected.push_back("f1");
+    expected.push_back("f2");
+    std::vector<fs::directory_entry> entries(cache.list(root / "a"));
+    BOOST_TEST(names(entries) == expected);
+    BOOST_TEST(entries.size() == 3u && fs::is_directory(entries[0].status()));
+    BOOST_TEST(cache.list(root / "e").empty());
+
+    // paths outside the tree are answered by the filesystem
+    BOOST_TEST(cache.exists(fs::temp_directory_path()));
+    BOOST_TEST(!cache.exists(root.parent_path() / "filesystem8-tree-cache-nonexistent"));
+  }
+
+  //  update_test  ---------------------------------------------------------------------//
+
+  void update_test(fs::tree_cache& cache)
+  {
+    cout << "update_test... (" << (cache.is_live() ? "live" : "snapshot") << ")" << endl;
+
+    create_file(root / "a" / "new", "1234567");
+    BOOST_TEST(eventually(cache, [&]()
+      { return cache.exists(root / "a" / "new"); }));
+    std::error_code ec;
+    BOOST_TEST(eventually(cache, [&]()
+      { return cache.file_size(root / "a" / "new", ec) == 7u; }));
+
+    fs::remove(root / "a" / "f2");
+    BOOST_TEST(eventually(cache, [&]()
+      { return !cache.exists(root / "a" / "f2"); }));
+
+    // a new directory, and a file created in it right away
+    fs::create_directories(root / "g" / "h");
+    create_file(root / "g" / "h" / "f7", "f7");
+    BOOST_TEST(eventually(cache, [&]()
+      { return cache.exists(root / "g" / "h" / "f7"); }));
+
+    // moving a subtree
+    fs::rename(root / "a" / "b", root / "d" / "b2");
+    BOOST_TEST(eventually(cache, [&]()
+      { return cache.exists(root / "d" / "b2" / "c" / "f4")
+          && !cache.exists(root / "a" / "b"); }));
+    BOOST_TEST(eventually(cache, [&]()
+      { return names(cache.list(root / "d")).size() == 2u; }));
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/a/{f1, f2, b/{f3, c/f4}}, root/d/f5, root/e (empty)
+  fs::remove_all(root);
+  fs::create_directories(root / "a" / "b" / "c");
+  fs::create_directories(root / "d");
+  fs::create_directories(root / "e");
+  create_file(root / "a" / "f1", "12345");
+  create_file(root / "a" / "f2", "f2");
+  create_file(root / "a" / "b" / "f3", "f3");
+  create_file(root / "a" / "b" / "c" / "f4", "f4");
+  create_file(root / "d" / "f5", "f5");
+
+  {
+    fs::tree_cache cache(root);
+    query_test(cache);
+    update_test(cache);
+  }
+
+  std::error_code ec;
+  fs::tree_cache missing(root / "nonexistent", ec);
+  BOOST_TEST(ec);
+
+  // a constructor that throws leaves no descriptor open
+  const std::size_t fds_before = open_fds();
+  for (int i = 0; i != 3; ++i)
+  {
+    bool threw = false;
+    try { fs::tree_cache thrown(root / "nonexistent"); }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+  }
+  BOOST_TEST_EQ(open_fds(), fds_before);
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}
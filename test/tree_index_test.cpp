@@ -0,0 +1,139 @@
+//  tree_index_test.cpp  ---------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/tree_index.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-tree-index-test");
+  const path index_file(fs::temp_directory_path() / "filesystem8-tree-index-test.idx");
+
+  void create_file(const path& p, const std::string& contents)
+  {
+    std::ofstream f(p.c_str());
+    f << contents;
+  }
+
+  std::vector<std::string> names(const fs::tree_index& index, const path& dir)
+  {
+    std::vector<std::string> result;
+    const fs::tree_index_entry* e = index.find(dir);
+    if (e == 0)
+      return result;
+    fs::tree_index::range r(index.list(*e));
+    for (; r.first != r.second; ++r.first)
+      result.push_back(index.filename(*r.first).string());
+    return result;
+  }
+
+  //  query_test  ----------------------------------------------------------------------//
+
+  void query_test()
+  {
+    cout << "query_test..." << endl;
+
+    fs::write_tree_index(root, index_file);
+    fs::tree_index index(index_file);
+    BOOST_TEST(index.root() == root);
+    BOOST_TEST_EQ(index.size(), 11u);
+
+    const fs::tree_index_entry* e = index.find("a/f1");
+    BOOST_TEST(e != 0);
+    if (e != 0)
+    {
+      BOOST_TEST(e->type() == fs::file_type::regular);
+      BOOST_TEST_EQ(e->size, 5u);
+      BOOST_TEST(e->permissions() == fs::status(root / "a" / "f1").permissions());
+      BOOST_TEST_EQ(e->mtime_ns / 1000000000, fs::last_write_time(root / "a" / "f1"));
+      BOOST_TEST(index.relative_path(*e) == path("a") / "f1");
+    }
+    e = index.find("a/b/c/f4");
+    BOOST_TEST(e != 0 && index.relative_path(*e) == path("a") / "b" / "c" / "f4");
+    BOOST_TEST(index.find(".") != 0 && index.find(".")->type() == fs::file_type::directory);
+    BOOST_TEST(index.find("a/none") == 0);
+    BOOST_TEST(index.find("a/f1/none") == 0);
+    BOOST_TEST(index.find("e") != 0 && index.list(*index.find("e")).first
+      == index.list(*index.find("e")).second);
+
+    const char* const top[] = {"a", "d", "e", "z"};
+    BOOST_TEST(names(index, ".") == std::vector<std::string>(top, top + 4));
+    const char* const in_a[] = {"b", "f1", "f2"};
+    BOOST_TEST(names(index, "a") == std::vector<std::string>(in_a, in_a + 3));
+    BOOST_TEST(names(index, "a/f1").empty());
+
+    // rewriting an index that is mapped leaves the mapping intact
+    fs::remove(root / "a" / "f2");
+    fs::write_tree_index(root, index_file);
+    BOOST_TEST(index.find("a/f2") != 0);
+    fs::tree_index updated(index_file);
+    BOOST_TEST(updated.find("a/f2") == 0);
+    BOOST_TEST_EQ(updated.size(), 10u);
+  }
+
+  //  error_test  ----------------------------------------------------------------------//
+
+  void error_test()
+  {
+    cout << "error_test..." << endl;
+
+    std::error_code ec;
+    fs::write_tree_index(root / "nonexistent", index_file, ec);
+    BOOST_TEST(ec);
+
+    fs::tree_index missing(root / "nonexistent.idx", ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(missing.find(".") == 0);
+
+    create_file(root / "bad.idx", "not an index, but long enough to hold a header....");
+    fs::tree_index bad(root / "bad.idx", ec);
+    BOOST_TEST(ec);
+
+    bool threw = false;
+    try { fs::tree_index index(root / "bad.idx"); }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+  }
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  //  root/a/{f1, f2, b/{f3, c/f4}}, root/d/f5, root/e (empty), root/z
+  fs::remove_all(root);
+  fs::create_directories(root / "a" / "b" / "c");
+  fs::create_directories(root / "d");
+  fs::create_directories(root / "e");
+  create_file(root / "a" / "f1", "12345");
+  create_file(root / "a" / "f2", "f2");
+  create_file(root / "a" / "b" / "f3", "f3");
+  create_file(root / "a" / "b" / "c" / "f4", "f4");
+  create_file(root / "d" / "f5", "f5");
+  create_file(root / "z", "z");
+
+  query_test();
+  error_test();
+
+  fs::remove_all(root);
+  fs::remove(index_file);
+  return ::boost::report_errors();
+}
@@ -0,0 +1,866 @@
+//  walk_test.cpp  ---------------------------------------------------------------------//
+
+//  Distributed under the Boost Software License, Version 1.0.
+//  See http://www.boost.org/LICENSE_1_0.txt
+
+//  ------------------------------------------------------------------------------------//
+//
+//  Tests for the tree walkers, checked against recursive_directory_iterator.
+//
+//  ------------------------------------------------------------------------------------//
+
+#include <filesystem8/operations.hpp>
+#include <filesystem8/parallel_walk.hpp>
+#include <filesystem8/generator.hpp>
+#include <filesystem8/breadth_first.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/detail/lightweight_main.hpp>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef FILESYSTEM8_POSIX_API
+#   include <sys/stat.h>
+#endif
+
+namespace fs = filesystem8;
+using fs::path;
+using std::cout;
+using std::endl;
+
+namespace
+{
+  const path root(fs::temp_directory_path() / "filesystem8-walk-test");
+
+  void create_file(const path& p)
+  {
+    std::ofstream f(p.c_str());
+    f << p.string();
+  }
+
+  //  root/a/{f1, f2, b/{f3, c/f4}}, root/d/f5, root/e (empty), root/f6
+  void create_tree()
+  {
+    fs::remove_all(root);
+    fs::create_directories(root / "a" / "b" / "c");
+    fs::create_directories(root / "d");
+    fs::create_directories(root / "e");
+    create_file(root / "a" / "f1");
+    create_file(root / "a" / "f2");
+    create_file(root / "a" / "b" / "f3");
+    create_file(root / "a" / "b" / "c" / "f4");
+    create_file(root / "d" / "f5");
+    create_file(root / "f6");
+  }
+
+  std::set<std::string> sequential_walk(const path& p)
+  {
+    std::set<std::string> result;
+    for (fs::recursive_directory_iterator it(p), end; it != end; ++it)
+      result.insert(it->path().string());
+    return result;
+  }
+
+  std::set<std::string> filtered_walk(const path& p, const fs::recursion_options& options)
+  {
+    std::set<std::string> result;
+    for (fs::recursive_directory_iterator it(p, options), end; it != end; ++it)
+      result.insert(it->path().lexically_relative(p).generic_string());
+    return result;
+  }
+
+  std::set<std::string> names(const char* const* first, const char* const* last)
+  {
+    return std::set<std::string>(first, last);
+  }
+
+  //  recursion_options_test  ----------------------------------------------------------//
+
+  void recursion_options_test()
+  {
+    cout << "recursion_options_test..." << endl;
+
+    fs::recursion_options options;
+    BOOST_TEST(filtered_walk(root, options).size() == 11u);
+
+    options.max_depth = 0;
+    const char* const depth0[] = {"a", "d", "e", "f6"};
+    BOOST_TEST(filtered_walk(root, options) == names(depth0, depth0 + 4));
+
+    options.max_depth = 1;
+    const char* const depth1[] = {"a", "a/b", "a/f1", "a/f2", "d", "d/f5", "e", "f6"};
+    BOOST_TEST(filtered_walk(root, options) == names(depth1, depth1 + 8));
+
+    // a pruned directory is visited, but not descended into
+    options.max_depth = -1;
+    options.prune = [](const fs::directory_entry& e) { return e.path().filename() == "a"; };
+    const char* const pruned[] = {"a", "d", "d/f5", "e", "f6"};
+    BOOST_TEST(filtered_walk(root, options) == names(pruned, pruned + 5));
+
+    // directories excluded by the type mask are still descended into
+    options.prune = nullptr;
+    options.types = fs::entry_type_mask::regular;
+    const char* const files[] = {"a/b/c/f4", "a/b/f3", "a/f1", "a/f2", "d/f5", "f6"};
+    BOOST_TEST(filtered_walk(root, options) == names(files, files + 6));
+
+    options.types = fs::entry_type_mask::directory;
+    const char* const dirs[] = {"a", "a/b", "a/b/c", "d", "e"};
+    BOOST_TEST(filtered_walk(root, options) == names(dirs, dirs + 5));
+
+    // a directory holding nothing of the wanted types
+    options.types = fs::entry_type_mask::symlink;
+    BOOST_TEST(filtered_walk(root, options).empty());
+    std::error_code ec;
+    BOOST_TEST(fs::recursive_directory_iterator(root, options, ec)
+      == fs::recursive_directory_iterator());
+    BOOST_TEST(!ec);
+
+    options.types = fs::entry_type_mask::regular;
+    options.prune = [](const fs::directory_entry& e) { return e.path().filename() == "b"; };
+    const char* const combined[] = {"a/f1", "a/f2", "d/f5", "f6"};
+    BOOST_TEST(filtered_walk(root, options) == names(combined, combined + 4));
+
+    // the first entry of a directory descended into is filtered too: nested/d holds
+    // only s, which holds only f, so no readdir order puts a wanted entry first
+    const path nested(root.parent_path() / "filesystem8-walk-test-nested");
+    fs::remove_all(nested);
+    fs::create_directories(nested / "d" / "s");
+    create_file(nested / "d" / "s" / "f");
+    fs::recursion_options only;
+    only.types = fs::entry_type_mask::regular;
+    const char* const nested_files[] = {"d/s/f"};
+    BOOST_TEST(filtered_walk(nested, only) == names(nested_files, nested_files + 1));
+    only.types = fs::entry_type_mask::directory;
+    const char* const nested_dirs[] = {"d", "d/s"};
+    BOOST_TEST(filtered_walk(nested, only) == names(nested_dirs, nested_dirs + 2));
+
+    // a visited symlink is descended into, and nothing it leads to is of the wanted type
+    std::error_code link_ec;
+    fs::create_directory_symlink(nested / "d", nested / "l", link_ec);
+    if (!link_ec)
+    {
+      only.types = fs::entry_type_mask::symlink;
+      only.symlinks = fs::symlink_option::recurse;
+      const char* const nested_links[] = {"l"};
+      BOOST_TEST(filtered_walk(nested, only) == names(nested_links, nested_links + 1));
+    }
+    fs::remove_all(nested);
+
+    // the same options in parallel_walk
+    std::mutex m;
+    std::set<std::string> seen;
+    fs::walk_options walk;
+    walk.types = fs::entry_type_mask::regular;
+    walk.prune = options.prune;
+    fs::parallel_walk(root,
+      [&](const fs::directory_entry& e)
+      {
+        std::lock_guard<std::mutex> lk(m);
+        seen.insert(e.path().lexically_relative(root).generic_string());
+        return true;
+      }, walk);
+    BOOST_TEST(seen == names(combined, combined + 4));
+
+    // inode order visits the same entries, those of each directory by inode number
+    fs::recursion_options by_inode;
+    by_inode.order = fs::directory_order::inode;
+    BOOST_TEST(filtered_walk(root, by_inode) == filtered_walk(root, fs::recursion_options()));
+#   ifdef FILESYSTEM8_POSIX_API
+    std::vector<ino_t> inodes;
+    for (fs::directory_iterator it(root / "a", fs::entry_type_mask::all,
+      fs::directory_order::inode), end; it != end; ++it)
+    {
+      struct stat st;
+      BOOST_TEST(::lstat(it->path().c_str(), &st) == 0);
+      inodes.push_back(st.st_ino);
+    }
+    BOOST_TEST_EQ(inodes.size(), 3u);
+    BOOST_TEST(std::is_sorted(inodes.begin(), inodes.end()));
+#   endif
+
+    // leaf_option::nlink changes nothing on a filesystem keeping the st_nlink convention
+    fs::recursion_options leaf;
+    leaf.leaf = fs::leaf_option::nlink;
+    BOOST_TEST(filtered_walk(root, leaf) == filtered_walk(root, fs::recursion_options()));
+    leaf.max_depth = 1;
+    BOOST_TEST(filtered_walk(root, leaf) == names(depth1, depth1 + 8));
+    walk.types = fs::entry_type_mask::all;
+    walk.prune = nullptr;
+    walk.leaf = fs::leaf_option::nlink;
+    seen.clear();
+    fs::parallel_walk(root,
+      [&](const fs::directory_entry& e)
+      {
+        std::lock_guard<std::mutex> lk(m);
+        seen.insert(e.path().string());
+        return true;
+      }, walk);
+    BOOST_TEST(seen == sequential_walk(root));
+
+    BOOST_TEST(!fs::is_empty(root / "a", fs::leaf_option::nlink));
+    BOOST_TEST(!fs::is_empty(root / "d", fs::leaf_option::nlink));
+    BOOST_TEST(fs::is_empty(root / "e", fs::leaf_option::nlink));
+
+    // directory_iterator type mask
+    std::vector<std::string> entries;
+    for (fs::directory_iterator it(root, fs::entry_type_mask::regular), end; it != end; ++it)
+      entries.push_back(it->path().filename().string());
+    BOOST_TEST_EQ(entries.size(), 1u);
+    BOOST_TEST(entries.size() == 1u && entries[0] == "f6");
+  }
+
+  //  open_limit_test  -----------------------------------------------------------------//
+
+  std::vector<std::string> ordered_walk(const path& p, const fs::recursion_options& options,
+    std::size_t* most_open = 0)
+  {
+    std::vector<std::string> result;
+    std::size_t baseline = 0;
+    for (fs::recursive_directory_iterator it(p, options), end; it != end; ++it)
+    {
+      result.push_back(it->path().lexically_relative(p).generic_string());
+#     ifdef __linux__
+      if (most_open != 0)
+      {
+        std::size_t n = std::distance(fs::directory_iterator("/proc/self/fd"),
+          fs::directory_iterator());
+        if (baseline == 0)
+          baseline = n - 1;  // the root is open
+        *most_open = std::max(*most_open, n - baseline);
+      }
+#     endif
+    }
+    return result;
+  }
+
+  void open_limit_test()
+  {
+    cout << "open_limit_test..." << endl;
+
+    // 40 levels, each with a file and a directory
+    const path deep(root / "deep");
+    path dir(deep);
+    for (int i = 0; i < 40; ++i)
+    {
+      dir /= "d";
+      fs::create_directories(dir);
+      create_file(dir / "f");
+      create_file(dir / "g");
+    }
+
+    fs::recursion_options options;
+    std::size_t most_open = 0;
+    const std::vector<std::string> expected(ordered_walk(deep, options, &most_open));
+    BOOST_TEST_EQ(expected.size(), 120u);
+#   ifdef __linux__
+    BOOST_TEST(most_open >= 40u);
+#   endif
+
+    for (std::size_t limit = 1; limit <= 3; ++limit)
+    {
+      options.open_limit = limit;
+      most_open = 0;
+      BOOST_TEST(ordered_walk(deep, options, &most_open) == expected);
+#     ifdef __linux__
+      BOOST_TEST(most_open <= limit);
+#     endif
+    }
+
+    options.order = fs::directory_order::inode;
+    std::vector<std::string> by_inode(ordered_walk(deep, options));
+    BOOST_TEST_EQ(by_inode.size(), 120u);
+    options.open_limit = 0;
+    BOOST_TEST(by_inode == ordered_walk(deep, options));
+
+    // and with the other options
+    options.open_limit = 2;
+    options.types = fs::entry_type_mask::regular;
+    options.max_depth = 9;
+    BOOST_TEST_EQ(ordered_walk(deep, options).size(), 18u);
+
+    fs::remove_all(deep);
+  }
+
+  //  breadth_first_test  --------------------------------------------------------------//
+
+  //  Returns: the entries visited, relative to root, with their depths
+  std::vector<std::pair<std::string, int> > frontier_walk(
+    const fs::frontier_options& options)
+  {
+    std::vector<std::pair<std::string, int> > result;
+    for (fs::breadth_first_directory_iterator it(root, options), end; it != end; ++it)
+    {
+      result.push_back(std::make_pair(
+        it->path().lexically_relative(root).generic_string(), it.depth()));
+      if (options.max_frontier != 0)
+        BOOST_TEST(it.frontier_size() <= options.max_frontier);
+    }
+    return result;
+  }
+
+  std::set<std::string> names_of(const std::vector<std::pair<std::string, int> >& v)
+  {
+    std::set<std::string> result;
+    for (std::size_t i = 0; i < v.size(); ++i)
+      result.insert(v[i].first);
+    return result;
+  }
+
+  bool by_depth(const std::vector<std::pair<std::string, int> >& v)
+  {
+    for (std::size_t i = 1; i < v.size(); ++i)
+      if (v[i].second < v[i - 1].second)
+        return false;
+    return true;
+  }
+
+  void breadth_first_test()
+  {
+    cout << "breadth_first_test..." << endl;
+
+    fs::frontier_options options;
+    std::vector<std::pair<std::string, int> > visited(frontier_walk(options));
+    BOOST_TEST(names_of(visited) == filtered_walk(root, fs::recursion_options()));
+    BOOST_TEST_EQ(visited.size(), 11u);
+    BOOST_TEST(by_depth(visited));
+    BOOST_TEST(visited.size() == 11u && visited[10].first == "a/b/c/f4"
+      && visited[10].second == 3);
+
+    // best first: the directory with the greatest name first
+    options.before = [](const fs::queued_directory& lhs, const fs::queued_directory& rhs)
+      { return rhs.dir < lhs.dir; };
+    visited = frontier_walk(options);
+    BOOST_TEST(names_of(visited) == filtered_walk(root, fs::recursion_options()));
+    std::vector<std::string> d_then_a;
+    for (std::size_t i = 4; i < visited.size(); ++i)
+      d_then_a.push_back(visited[i].first);
+    BOOST_TEST(!d_then_a.empty() && d_then_a[0] == "d/f5");
+
+    // a full frontier falls back to depth first; the same entries are visited
+    options.before = nullptr;
+    options.max_frontier = 1;
+    visited = frontier_walk(options);
+    BOOST_TEST(names_of(visited) == filtered_walk(root, fs::recursion_options()));
+    BOOST_TEST_EQ(visited.size(), 11u);
+
+    // recursion_options apply
+    options.max_frontier = 0;
+    options.types = fs::entry_type_mask::regular;
+    options.prune = [](const fs::directory_entry& e) { return e.path().filename() == "b"; };
+    const char* const combined[] = {"a/f1", "a/f2", "d/f5", "f6"};
+    BOOST_TEST(names_of(frontier_walk(options)) == names(combined, combined + 4));
+
+    // shallowest match, and disable_recursion_pending()
+    std::size_t n = 0;
+    for (fs::breadth_first_directory_iterator it(root), end; it != end; ++it, ++n)
+    {
+      if (it->path().filename() == "a")
+        it.disable_recursion_pending();
+      BOOST_TEST(it->path().filename() != "f1");
+    }
+    BOOST_TEST_EQ(n, 5u);  // a, d, e, f6, d/f5
+
+    std::error_code ec;
+    fs::breadth_first_directory_iterator it(root / "no-such-directory", ec);
+    BOOST_TEST(ec);
+    BOOST_TEST(it == fs::breadth_first_directory_iterator());
+  }
+
+  //  directory_entry_test  ------------------------------------------------------------//
+
+  //  The entries of an iterator form their paths from the directory's and their own
+  //  filename only when asked for them; check that they behave as if formed up front
+  void directory_entry_test()
+  {
+    cout << "directory_entry_test..." << endl;
+
+    std::vector<fs::directory_entry> v;
+    for (fs::recursive_directory_iterator it(root), end; it != end; ++it)
+    {
+      BOOST_TEST(it->filename() == it->path().filename());
+      v.push_back(*it);
+    }
+    BOOST_TEST_EQ(v.size(), 11u);
+
+    std::set<std::string> from_copies;
+    for (std::size_t i = 0; i < v.size(); ++i)
+      from_copies.insert(v[i].path().string());
+    BOOST_TEST(from_copies == sequential_walk(root));
+
+    fs::directory_iterator it(root / "a");
+    fs::directory_entry unformed(*it);  // copied before its path is formed
+    fs::directory_entry moved(std::move(fs::directory_entry(*it)));
+    BOOST_TEST(unformed.path() == it->path());
+    BOOST_TEST(moved.path() == it->path());
+    BOOST_TEST(unformed == *it);
+    BOOST_TEST(!(unformed < *it) && !(*it < unformed));
+    BOOST_TEST(unformed.path().parent_path() == root / "a");
+
+    unformed.replace_filename("x");
+    BOOST_TEST(unformed.filename() == "x");
+    BOOST_TEST(unformed.path() == root / "a" / "x");
+    unformed.replace_filename("y");
+    BOOST_TEST(unformed.path() == root / "a" / "y");
+
+    fs::directory_entry formed(root / "a" / "f1");
+    BOOST_TEST(formed.filename() == "f1");
+    formed.replace_filename("f2");
+    BOOST_TEST(formed.path() == root / "a" / "f2");
+    BOOST_TEST(formed.filename() == "f2");
+    BOOST_TEST(fs::is_regular_file(formed.status()));
+
+    formed = unformed;
+    BOOST_TEST(formed.path() == root / "a" / "y");
+    formed.assign(root / "f6");
+    BOOST_TEST(formed.filename() == "f6");
+    BOOST_TEST(formed.path() == root / "f6");
+  }
+
+  //  parallel_walk_test  --------------------------------------------------------------//
+
+  void parallel_walk_test()
+  {
+    cout << "parallel_walk_test..." << endl;
+
+    std::mutex m;
+    std::set<std::string> seen;
+    fs::walk_options options;
+    options.threads = 4;
+    fs::parallel_walk(root,
+      [&](const fs::directory_entry& e)
+      {
+        std::lock_guard<std::mutex> lk(m);
+        BOOST_TEST(seen.insert(e.path().string()).second);  // each entry exactly once
+        return true;
+      }, options);
+    BOOST_TEST(seen == sequential_walk(root));
+    BOOST_TEST_EQ(seen.size(), 11u);
+
+    // returning false from the visitor prunes that directory
+    seen.clear();
+    fs::parallel_walk(root,
+      [&](const fs::directory_entry& e)
+      {
+        std::lock_guard<std::mutex> lk(m);
+        seen.insert(e.path().string());
+        return e.path().filename() != "a";
+      }, options);
+    BOOST_TEST(seen.count((root / "a").string()) == 1);
+    BOOST_TEST(seen.count((root / "a" / "f1").string()) == 0);
+    BOOST_TEST_EQ(seen.size(), 5u);
+
+    // errors are reported via ec or thrown
+    std::error_code ec;
+    fs::parallel_walk(root / "no-such-directory",
+      [](const fs::directory_entry&) { return true; }, ec);
+    BOOST_TEST(ec);
+
+    bool threw = false;
+    try
+    {
+      fs::parallel_walk(root / "no-such-directory",
+        [](const fs::directory_entry&) { return true; });
+    }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+
+    // an exception from the visitor stops the walk and reaches the caller
+    threw = false;
+    try
+    {
+      fs::parallel_walk(root,
+        [](const fs::directory_entry&) -> bool { throw std::runtime_error("visitor"); });
+    }
+    catch (const std::runtime_error&) { threw = true; }
+    BOOST_TEST(threw);
+  }
+
+  //  ordered_walk_test  ---------------------------------------------------------------//
+
+  std::vector<path> ordered_parallel_walk(const path& p, fs::walk_options options)
+  {
+    std::vector<path> result;
+    const std::thread::id caller = std::this_thread::get_id();
+    options.ordered = true;
+    fs::parallel_walk(p,
+      [&](const fs::directory_entry& e)
+      {
+        BOOST_TEST(std::this_thread::get_id() == caller);
+        result.push_back(e.path());
+        return true;
+      }, options);
+    return result;
+  }
+
+  void ordered_walk_test()
+  {
+    cout << "ordered_walk_test..." << endl;
+
+    // wide enough for the workers to read well ahead of the visitor
+    const path wide(root / "wide");
+    for (int i = 0; i != 20; ++i)
+    {
+      const path dir(wide / ("d" + std::to_string(i * 7 % 20)));
+      fs::create_directories(dir / "sub");
+      create_file(dir / "f");
+      create_file(dir / "sub" / "g");
+      create_file(dir / "sub.txt");
+    }
+
+    std::vector<path> expected;
+    for (fs::recursive_directory_iterator it(root), end; it != end; ++it)
+      expected.push_back(it->path());
+    std::sort(expected.begin(), expected.end(),
+      [](const path& lhs, const path& rhs) { return lhs.compare(rhs) < 0; });
+    BOOST_TEST_EQ(expected.size(), 11u + 1u + 20u * 5u);
+
+    const unsigned threads[] = {1, 4};
+    const std::size_t read_ahead[] = {0, 1, 3};
+    for (unsigned t = 0; t != 2; ++t)
+      for (unsigned r = 0; r != 3; ++r)
+      {
+        fs::walk_options options;
+        options.threads = threads[t];
+        options.read_ahead = read_ahead[r];
+        BOOST_TEST(ordered_parallel_walk(root, options) == expected);
+      }
+
+    // every directory comes right before the entries below it
+    std::vector<path> v(ordered_parallel_walk(root, fs::walk_options()));
+    BOOST_TEST(v.size() > 3u && v[0] == root / "a" && v[1] == root / "a" / "b"
+      && v[2] == root / "a" / "b" / "c" && v[3] == root / "a" / "b" / "c" / "f4");
+
+    // the recursion_options apply, and returning false skips what was read ahead
+    fs::walk_options options;
+    options.ordered = true;
+    options.read_ahead = 2;
+    options.types = fs::entry_type_mask::regular;
+    options.prune = [](const fs::directory_entry& e) { return e.filename() == "sub"; };
+    v.clear();
+    fs::parallel_walk(wide,
+      [&](const fs::directory_entry& e)
+      {
+        v.push_back(e.path().lexically_relative(wide));
+        return true;
+      }, options);
+    BOOST_TEST_EQ(v.size(), 40u);
+    BOOST_TEST(v.size() == 40u && v[0] == path("d0") / "f"
+      && v[1] == path("d0") / "sub.txt" && v[39] == path("d9") / "sub.txt");
+
+    options.types = fs::entry_type_mask::all;
+    options.prune = nullptr;
+    v.clear();
+    fs::parallel_walk(wide,
+      [&](const fs::directory_entry& e)
+      {
+        v.push_back(e.path().lexically_relative(wide));
+        return e.path().filename().string()[0] != 'd';
+      }, options);
+    BOOST_TEST_EQ(v.size(), 20u);
+
+    // an error is reported where the walk gets to it
+    std::error_code ec;
+    options.read_ahead = 0;
+    fs::parallel_walk(root / "no-such-directory",
+      [](const fs::directory_entry&) { return true; }, options, ec);
+    BOOST_TEST(ec);
+
+    bool threw = false;
+    try
+    {
+      fs::parallel_walk(root,
+        [](const fs::directory_entry&) -> bool { throw std::runtime_error("visitor"); },
+        options);
+    }
+    catch (const std::runtime_error&) { threw = true; }
+    BOOST_TEST(threw);
+
+    threw = false;
+    options.prune = [](const fs::directory_entry& e) -> bool
+      {
+        if (e.filename() == "b")
+          throw std::runtime_error("prune");
+        return false;
+      };
+    v.clear();
+    try
+    {
+      fs::parallel_walk(root,
+        [&](const fs::directory_entry& e) { v.push_back(e.path()); return true; },
+        options);
+    }
+    catch (const std::runtime_error&) { threw = true; }
+    BOOST_TEST(threw);
+    BOOST_TEST(v.size() == 1u && v[0] == root / "a");  // then b was to be read
+
+    fs::remove_all(wide);
+  }
+
+  //  visited_test  --------------------------------------------------------------------//
+
+  void visited_test()
+  {
+    cout << "visited_test..." << endl;
+
+    //  links/{x/{f, back -> links}, y -> x}: a loop, and a second path to x
+    const path links(root.parent_path() / "filesystem8-walk-test-links");
+    fs::remove_all(links);
+    fs::create_directories(links / "x");
+    create_file(links / "x" / "f");
+    std::error_code ec;
+    fs::create_directory_symlink(links, links / "x" / "back", ec);
+    if (!ec)
+      fs::create_directory_symlink(links / "x", links / "y", ec);
+    if (ec)
+    {
+      cout << "  symlinks not supported here; skipped" << endl;
+      fs::remove_all(links);
+      return;
+    }
+
+    const char* const once[] = {"x", "x/back", "x/f", "y"};
+    for (int prefilter = 0; prefilter <= 1024; prefilter += 1024)
+    {
+      fs::walk_options options;
+      options.symlinks = fs::symlink_option::recurse | fs::symlink_option::skip_visited;
+      options.visited_prefilter = static_cast<std::size_t>(prefilter);
+      BOOST_TEST(filtered_walk(links, options) == names(once, once + 4));
+
+      std::set<std::string> seen;
+      fs::frontier_options frontier;
+      frontier.symlinks = options.symlinks;
+      frontier.visited_prefilter = options.visited_prefilter;
+      for (fs::breadth_first_directory_iterator it(links, frontier), end; it != end; ++it)
+        seen.insert(it->path().lexically_relative(links).generic_string());
+      BOOST_TEST(seen == names(once, once + 4));
+
+      for (int ordered = 0; ordered != 2; ++ordered)
+      {
+        std::mutex m;
+        seen.clear();
+        options.threads = 4;
+        options.ordered = ordered != 0;
+        fs::parallel_walk(links,
+          [&](const fs::directory_entry& e)
+          {
+            std::lock_guard<std::mutex> lk(m);
+            seen.insert(e.path().lexically_relative(links).generic_string());
+            return true;
+          }, options);
+        // x may be descended into as y, if a thread opens y first
+        const char* const as_y[] = {"x", "y", "y/back", "y/f"};
+        BOOST_TEST(seen == names(once, once + 4) || seen == names(as_y, as_y + 4));
+      }
+    }
+
+    // the legacy constructor takes it too; the loop is not followed
+    std::size_t n = 0;
+    for (fs::recursive_directory_iterator it(links,
+      fs::symlink_option::recurse | fs::symlink_option::skip_visited), end; it != end; ++it)
+      ++n;
+    BOOST_TEST_EQ(n, 4u);
+
+    fs::remove_all(links);
+  }
+
+  //  mounts_test  ---------------------------------------------------------------------//
+
+#ifdef __linux__
+
+  void mounts_test()
+  {
+    cout << "mounts_test..." << endl;
+
+    //  links/{x/f, same -> x, proc -> /proc}; /proc is another, pseudo, filesystem
+    const path links(root.parent_path() / "filesystem8-walk-test-mounts");
+    fs::remove_all(links);
+    fs::create_directories(links / "x");
+    create_file(links / "x" / "f");
+    std::error_code ec;
+    fs::create_directory_symlink(links / "x", links / "same", ec);
+    if (!ec)
+      fs::create_directory_symlink("/proc", links / "proc", ec);
+    if (ec || !fs::exists("/proc/self"))
+    {
+      cout << "  no symlinks or no /proc here; skipped" << endl;
+      fs::remove_all(links);
+      return;
+    }
+
+    const char* const expected[] = {"proc", "same", "same/f", "x", "x/f"};
+    const fs::mount_option mounts[] =
+      {fs::mount_option::one_file_system, fs::mount_option::skip_pseudo};
+    for (int i = 0; i != 2; ++i)
+    {
+      fs::walk_options options;
+      options.symlinks = fs::symlink_option::recurse;
+      options.mounts = mounts[i];
+      BOOST_TEST(filtered_walk(links, options) == names(expected, expected + 5));
+
+      fs::frontier_options frontier;
+      frontier.symlinks = options.symlinks;
+      frontier.mounts = options.mounts;
+      std::set<std::string> seen;
+      for (fs::breadth_first_directory_iterator it(links, frontier), end; it != end; ++it)
+        seen.insert(it->path().lexically_relative(links).generic_string());
+      BOOST_TEST(seen == names(expected, expected + 5));
+
+      for (int ordered = 0; ordered != 2; ++ordered)
+      {
+        std::mutex m;
+        seen.clear();
+        options.ordered = ordered != 0;
+        fs::parallel_walk(links,
+          [&](const fs::directory_entry& e)
+          {
+            std::lock_guard<std::mutex> lk(m);
+            seen.insert(e.path().lexically_relative(links).generic_string());
+            return true;
+          }, options);
+        BOOST_TEST(seen == names(expected, expected + 5));
+      }
+    }
+
+    // the root itself is always traversed
+    fs::recursion_options options;
+    options.mounts = fs::mount_option::one_file_system | fs::mount_option::skip_pseudo;
+    options.max_depth = 0;
+    fs::recursive_directory_iterator it("/proc/self", options);
+    BOOST_TEST(it != fs::recursive_directory_iterator());
+
+    fs::remove_all(links);
+  }
+
+#endif
+
+#ifdef FILESYSTEM8_HAS_COROUTINES
+
+  //  generator_test  ------------------------------------------------------------------//
+
+  void generator_test()
+  {
+    cout << "generator_test..." << endl;
+
+    // same entries in the same order as the iterators
+    std::vector<std::string> expected, actual;
+    for (fs::directory_iterator it(root), end; it != end; ++it)
+      expected.push_back(it->path().string());
+    for (const fs::directory_entry& e : fs::directory_entries(root))
+      actual.push_back(e.path().string());
+    BOOST_TEST(actual == expected);
+    BOOST_TEST_EQ(actual.size(), 4u);
+
+    expected.clear();
+    actual.clear();
+    for (fs::recursive_directory_iterator it(root), end; it != end; ++it)
+      expected.push_back(it->path().string());
+    for (const fs::directory_entry& e : fs::recursive_directory_entries(root))
+      actual.push_back(e.path().string());
+    BOOST_TEST(actual == expected);
+    BOOST_TEST_EQ(actual.size(), 11u);
+
+    // errors are reported via ec or thrown
+    std::error_code ec;
+    std::size_t n = 0;
+    for (const fs::directory_entry& e
+      : fs::recursive_directory_entries(root / "no-such-directory", fs::symlink_option::none, ec))
+      { (void)e; ++n; }
+    BOOST_TEST(ec);
+    BOOST_TEST_EQ(n, 0u);
+
+    //  links/{x/{f, back -> links}, y -> x}: skip_visited ends the loop, as it does for
+    //  the iterator
+    const path links(root.parent_path() / "filesystem8-walk-test-generator-links");
+    fs::remove_all(links);
+    fs::create_directories(links / "x");
+    create_file(links / "x" / "f");
+    fs::create_directory_symlink(links, links / "x" / "back", ec);
+    if (!ec)
+      fs::create_directory_symlink(links / "x", links / "y", ec);
+    if (!ec)
+    {
+      const fs::symlink_option once = fs::symlink_option::recurse
+        | fs::symlink_option::skip_visited;
+      std::vector<std::string> iterated, generated;
+      for (fs::recursive_directory_iterator it(links, once), end; it != end; ++it)
+        iterated.push_back(it->path().string());
+      for (const fs::directory_entry& e : fs::recursive_directory_entries(links, once, ec))
+        generated.push_back(e.path().string());
+      BOOST_TEST(!ec);
+      BOOST_TEST(generated == iterated);
+      BOOST_TEST_EQ(generated.size(), 4u);
+    }
+    else
+      cout << "  symlinks not supported here; cycle skipped" << endl;
+    fs::remove_all(links);
+    ec.clear();
+
+    bool threw = false;
+    try
+    {
+      for (const fs::directory_entry& e : fs::directory_entries(root / "no-such-directory"))
+        (void)e;
+    }
+    catch (const fs::filesystem_error&) { threw = true; }
+    BOOST_TEST(threw);
+
+    // async_walk on a trivial event loop, two entries per turn of the loop
+    std::vector<std::function<void()> > loop;
+    std::size_t turns = 0;
+    bool done = false;
+    actual.clear();
+    fs::async_walk(
+      [&](std::function<void()> f) { loop.push_back(std::move(f)); },
+      fs::recursive_directory_entries(root),
+      [&](const fs::directory_entry& e) { actual.push_back(e.path().string()); },
+      [&](std::exception_ptr ep) { BOOST_TEST(!ep); done = true; },
+      2);
+    while (!loop.empty())
+    {
+      std::function<void()> f(std::move(loop.back()));
+      loop.pop_back();
+      ++turns;
+      f();
+    }
+    BOOST_TEST(done);
+    BOOST_TEST(actual == expected);
+    BOOST_TEST(turns >= 6u);
+  }
+
+#endif  // FILESYSTEM8_HAS_COROUTINES
+
+}  // unnamed namespace
+
+//--------------------------------------------------------------------------------------//
+//                                                                                      //
+//                                     main                                             //
+//                                                                                      //
+//--------------------------------------------------------------------------------------//
+
+int cpp_main(int, char*[])
+{
+  create_tree();
+
+  recursion_options_test();
+  open_limit_test();
+  breadth_first_test();
+  directory_entry_test();
+  parallel_walk_test();
+  ordered_walk_test();
+  visited_test();
+#ifdef __linux__
+  mounts_test();
+#endif
+#ifdef FILESYSTEM8_HAS_COROUTINES
+  generator_test();
+#endif
+
+  fs::remove_all(root);
+  return ::boost::report_errors();
+}